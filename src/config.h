@@ -3,20 +3,39 @@
 
 // driver layer
 // 1. motor and sensor
-#define MOTOR_PINS {2,3,6,13}
+// motor pins are driven by one PIO state machine, they must fit in a 12 GPIO window
+#define MOTOR_PINS 2, 3, 6, 13
 #define OPTO_SENSOR_PIN 28
 #define PIEZO_SENSOR_PIN 27
 
+// wheels, one row per wheel. every wheel has its own motor (one PIO state machine each, max 4)
+// and opto fork. the state machines share pio0, each one writes only the GPIOs from its lowest
+// to its highest motor pin, so no other wheel's motor pin may lie in that window (motor.c checks).
+// wheels with their own piezo pin are dispensed at the same time.
+#define WHEEL_COUNT 1
+#define COMPARTMENTS_PER_WHEEL 8 // including the calibration compartment over the opening
+#define WHEEL0_MOTOR_PINS MOTOR_PINS // WHEEL1_MOTOR_PINS and on for more wheels, 4 pins each
+#define WHEEL_OPTO_PINS { OPTO_SENSOR_PIN }
+#define WHEEL_PIEZO_PINS { PIEZO_SENSOR_PIN }
+
 // 2. EEPROM and I2C0
 #define I2C_PORT i2c0
+#define EEPROM_I2C_BUS 0 // I2C_PORT as the bus number i2c_hal.h takes
 #define EEPROM_SDA_GPIO 16
 #define EEPROM_SCL_GPIO 17
+// 100, 400 or 1000 kHz. 1 MHz needs the AT24C256C and external pull-ups, the internal ones are too weak
+#define EEPROM_I2C_BAUDRATE (400 * 1000)
 
 // 3.OLED and I2C1
 #define OLED_I2C_PORT i2c1
+#define OLED_I2C_BUS 1
+#define OLED_I2C_BAUDRATE (400 * 1000) // the SSD1306's rated maximum, a full 1 KB frame is about 25 ms
 #define OLED_SDA_GPIO 14
 #define OLED_SCL_GPIO 15
 #define OLED_ADDR 0x3C
+#ifndef OLED_FONT_PACKED
+#define OLED_FONT_PACKED 0 // 1: fonts from font_packed.c, about a quarter less flash for a decode per glyph
+#endif
 
 // 4. buttons and leds
 #define SW0_GPIO 9 //control LED0
@@ -45,9 +64,19 @@
 // logic layer
 // at least 80ms for a pill to fall through
 #define PILL_FALL_TIMEOUT_MS 150
-// user could define how long the period between 1-7 days
-#define MAX_PERIOD 7
-#define DEFAULT_PERIOD 7
+// piezo edges count from this many half-steps before the compartment aligns with the opening
+#define PILL_DROP_WINDOW_LEAD_STEPS 32
+// piezo waveform on the ADC (GP26-29 only) confirms that an edge was a pill and not a bump
+#define PIEZO_CAPTURE_SAMPLE_HZ 8000 // per piezo
+#define PIEZO_CAPTURE_PRETRIGGER_MS 8 // kept from before the edge, the classifier baseline
+#define PIEZO_CAPTURE_TAIL_MS 60 // keep sampling after the edge to see a second pill land
+#define PIEZO_TRACE_DUMP_ALL 0 // 1: print every trace for offline tuning, 0: only the drops not classed single
+// 1: a drop the classifier calls noise is not counted. 0: every edge counts, the class is only logged
+#define PILL_CLASSIFIER_VETO 0
+#define DEFAULT_STEP_PER_REVOLUTION 4096u // half-steps, until the wheel is calibrated
+// user could define how long the period between 1 and the pill compartments of a wheel
+#define MAX_PERIOD (COMPARTMENTS_PER_WHEEL - 1)
+#define DEFAULT_PERIOD MAX_PERIOD
 #define PAGE_TIMEOUT 2000
 
 #define PILL_DISPENSE_INTERVAL 10000 // if success, change to 30s when demo it.
@@ -0,0 +1,13 @@
+//
+// CRC-16/CCITT (0x1021, init 0xFFFF) shared by the EEPROM records and the host tools.
+//
+
+#ifndef PILLDISPENSER_CRC16_H
+#define PILLDISPENSER_CRC16_H
+#include <stddef.h>
+#include <stdint.h>
+
+uint16_t crc16(const uint8_t *data_p, size_t length);
+size_t crc16_verify_many(const uint8_t *region, size_t record_size, size_t count, uint32_t *valid_mask);
+
+#endif //PILLDISPENSER_CRC16_H
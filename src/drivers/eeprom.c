@@ -2,85 +2,126 @@
 #include "eeprom.h"
 #include <stdio.h>
 #include "../config.h"
-#include "hardware/gpio.h"
-#include "hardware/i2c.h"
+#include "crc16.h"
+#include "eeprom_writer.h"
+#include "i2c_hal.h"
 
 //1.Private helpers
-static uint16_t crc16(const uint8_t *data_p, size_t length) {
-    uint8_t x;
-    uint16_t crc = 0xFFFF; // Initial value
-    while (length--) {
-        x = crc >>8 ^ *data_p++;
-        x ^= x >>4;
-        crc = (crc <<8) ^ (uint16_t)(x <<12) ^ (uint16_t)(x <<5) ^ (uint16_t)x;
-    }
-    return crc;
-}
-static void eeprom_write_bytes(uint16_t addr, uint8_t *data_p, size_t length) {
-    uint8_t buf[2 + length];
-    buf[0] = (uint8_t)(addr >> 8);
-    buf[1] = (uint8_t)(addr & 0xFF);
-    memcpy(&buf[2], data_p, length);
-    i2c_write_blocking(I2C_PORT, EEPROM_ADDR, buf, length + 2, false);
-    sleep_ms(10);
-}
 static void eeprom_read_bytes(uint16_t addr, uint8_t *data_p, size_t length) {
+    eeprom_writer_flush(); // a read sees every queued write
     uint8_t addr_buf[2];
     addr_buf[0] = (uint8_t)(addr >> 8);
     addr_buf[1] = (uint8_t)(addr & 0xFF);
-    i2c_write_blocking(I2C_PORT, EEPROM_ADDR, addr_buf, 2, true);
-    i2c_read_blocking(I2C_PORT, EEPROM_ADDR, data_p, length, false);
+    i2c_hal_write(EEPROM_I2C_BUS, EEPROM_ADDR, addr_buf, 2, true);
+    i2c_hal_read(EEPROM_I2C_BUS, EEPROM_ADDR, data_p, length, false);
+}
+static uint16_t log_record_address(uint16_t index) {
+    return LOG_BASE_ADDRESS + (index / LOG_RECORDS_PER_PAGE) * EEPROM_PAGE_SIZE
+                            + (index % LOG_RECORDS_PER_PAGE) * LOG_RECORD_SIZE;
 }
-static bool log_entry_is_valid(const uint8_t *buffer) {
-    //The string must contain at least one character.
-    if (buffer[0]==0) return false;
 
-    //a terminating null character "\0"
-    //define an unused number in the buffer entry.
-    uint8_t null_position=-1;
-    int i = 0;
-    while (i<MAX_MESSAGE_LENGTH && buffer[i]!='\0') {
-        i++;
-    }
-    if (i == MAX_MESSAGE_LENGTH) return false; //no null found in first 62 bytes
-    null_position=i;
+// the log region is a ring. next record to write, its sequence number and whether the ring
+// has wrapped (the head then holds the oldest record), found once at boot and kept in RAM.
+static bool is_log_head_known = false;
+static uint16_t log_head = 0;
+static uint16_t log_next_sequence = 1;
+static bool is_log_wrapped = false;
+static uint32_t log_last_time_s = 0; // since boot, for the time delta of the next record
+
+// the log also journals the dispenser state between checkpoints
+static void state_journal_record(const LogRecord *record);
+static void state_write_checkpoint();
+static void state_write_full_checkpoint();
+
+static bool log_read_record(uint16_t index, LogRecord *record) {
+    uint8_t buffer[LOG_RECORD_SIZE];
+    eeprom_read_bytes(log_record_address(index), buffer, LOG_RECORD_SIZE);
+    return log_record_decode(buffer, record);
+}
 
-    int crc_position = null_position+1;
-    if (crc_position+1>=LOG_ENTRY_SIZE) return false; //no space for crc
+// sequential readers take the log a page at a time, the crcs of a page are checked in one go
+typedef struct {
+    int page; // -1 before the first read
+    uint32_t valid_mask;
+    uint8_t bytes[LOG_RECORDS_PER_PAGE * LOG_RECORD_SIZE];
+} LogPageCache;
 
-    // crc validation
-    // string+'\0'+crc
-    size_t total_length = null_position + 3;
-    uint16_t crc16_result = crc16(buffer, total_length);
-    if (crc16_result!=0) {
-        return false;
+static bool log_read_cached(LogPageCache *cache, uint16_t index, LogRecord *record) {
+    int page = index / LOG_RECORDS_PER_PAGE;
+    if (cache->page != page) {
+        eeprom_read_bytes(LOG_BASE_ADDRESS + page * EEPROM_PAGE_SIZE, cache->bytes, sizeof(cache->bytes));
+        crc16_verify_many(cache->bytes, LOG_RECORD_SIZE, LOG_RECORDS_PER_PAGE, &cache->valid_mask);
+        cache->page = page;
     }
-    return true;
+    uint16_t slot = index % LOG_RECORDS_PER_PAGE;
+    if (!(cache->valid_mask & (1u << slot))) return false;
+    return log_record_unpack(&cache->bytes[slot * LOG_RECORD_SIZE], record);
+}
+
+// records before the head carry consecutive sequence numbers counted from record 0,
+// the head itself is empty or older. a binary search finds it in log2(LOG_MAX_ENTRIES) reads.
+static void log_find_head() {
+    LogRecord first;
+    LogRecord record;
+    uint16_t low = 0;
+    uint16_t high = LOG_MAX_ENTRIES;
+    if (log_read_record(0, &first)) {
+        low = 1;
+        while (low < high) {
+            uint16_t mid = (low + high) / 2;
+            if (log_read_record(mid, &record) && record.sequence == (uint16_t)(first.sequence + mid)) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        log_next_sequence = (uint16_t)(first.sequence + low);
+    } else if (log_read_record(LOG_MAX_ENTRIES - 1, &record)) {
+        // record 0 torn while wrapping, the newest record is the last one
+        log_next_sequence = (uint16_t)(record.sequence + 1);
+    }
+    log_head = low % LOG_MAX_ENTRIES;
+    // once wrapped the head holds the oldest record, or a torn one with the oldest after it
+    is_log_wrapped = log_read_record(log_head, &record)
+                     || log_read_record((log_head + 1) % LOG_MAX_ENTRIES, &record);
+    is_log_head_known = true;
+    printf("[EEPROM] Log head at record %u, next sequence %u%s\n", log_head,
+           log_next_sequence, is_log_wrapped ? ", wrapped" : "");
 }
 
 
+// not needed to make room, the ring overwrites the oldest record. only for a clean start.
 void log_erase_all() {
     printf("Erasing all logs...\n");
-    uint8_t zero_at_first_byte = 0; // setting first byte to zero marks the entry as invalid
-    for (uint16_t i = 0; i < LOG_MAX_ENTRIES; i++) {
-        uint16_t address = LOG_BASE_ADDRESS + i* LOG_ENTRY_SIZE;
-        eeprom_write_bytes(address, &zero_at_first_byte, sizeof(zero_at_first_byte));
+    // the records since the last checkpoint go with the log, so they go into a new checkpoint first
+    state_write_full_checkpoint();
+    uint8_t zero_page[EEPROM_PAGE_SIZE] = {0}; // zero bytes never pass the record crc
+    for (uint16_t address = LOG_BASE_ADDRESS; address < LOG_BASE_ADDRESS + LOG_SIZE; address += EEPROM_PAGE_SIZE) {
+        eeprom_writer_write(address, zero_page, sizeof(zero_page));
     }
+    // sequence numbers carry on, so records never repeat one. after a reboot the empty log
+    // takes them up from the checkpoint again.
+    log_head = 0;
+    is_log_wrapped = false;
     printf("All logs erased.\n");
 }
 
+// oldest to newest: from the head round the ring once the log has wrapped, else from record 0
 void log_read_all() {
+    if (!is_log_head_known) log_find_head();
     printf("Reading all logs...\n");
-    uint8_t buffer[LOG_ENTRY_SIZE];
     bool log_is_empty = true;
-    for (uint16_t i=0; i<LOG_MAX_ENTRIES; i++) {
-        uint16_t address = LOG_BASE_ADDRESS +(i* LOG_ENTRY_SIZE);
-        eeprom_read_bytes(address, buffer, LOG_ENTRY_SIZE);
-
-
-        if (log_entry_is_valid(buffer)) {
+    uint16_t first = is_log_wrapped ? log_head : 0;
+    uint16_t count = is_log_wrapped ? LOG_MAX_ENTRIES : log_head;
+    LogPageCache cache = { .page = -1 };
+    for (uint16_t n=0; n<count; n++) {
+        uint16_t i = (first + n) % LOG_MAX_ENTRIES;
+        LogRecord record;
+        if (log_read_cached(&cache, i, &record)) {
             log_is_empty = false;
-            printf("Log Entry %d: %s\n", i, buffer);
+            char text[MAX_MESSAGE_LENGTH];
+            log_record_format(&record, text, sizeof(text));
+            printf("Log Entry %d (#%u, +%lus): %s\n", i, record.sequence, (unsigned long)record.time_delta_s, text);
         }
     }
     if (log_is_empty) {
@@ -89,71 +130,359 @@ void log_read_all() {
     printf("----------Reading Finished.-----------\n");
 }
 
-void log_write_message(const char *message) {
-    int target_entry_index = -1;
-    uint8_t buffer[LOG_ENTRY_SIZE];
+static void export_frame(uint8_t type, uint16_t offset, const uint8_t *payload, uint8_t length) {
+    uint8_t frame[6 + EEPROM_EXPORT_FRAME_SIZE + 2];
+    frame[0] = EEPROM_EXPORT_SYNC0;
+    frame[1] = EEPROM_EXPORT_SYNC1;
+    frame[2] = type;
+    frame[3] = (uint8_t)(offset & 0xFF);
+    frame[4] = (uint8_t)(offset >> 8);
+    frame[5] = length;
+    memcpy(&frame[6], payload, length);
+    uint16_t crc = crc16(&frame[2], 4 + length);
+    frame[6 + length] = (uint8_t)(crc & 0xFF);
+    frame[7 + length] = (uint8_t)(crc >> 8);
+    // raw, printf would turn every 0x0A into 0x0D 0x0A
+    for (int i = 0; i < 8 + length; i++) {
+        putchar_raw(frame[i]);
+    }
+}
 
-    for (int i = 0;i < LOG_MAX_ENTRIES;i++) {
-        uint16_t address = LOG_BASE_ADDRESS + i* LOG_ENTRY_SIZE;
-        eeprom_read_bytes(address, &buffer[0], LOG_ENTRY_SIZE);
-        if (!log_entry_is_valid(buffer)) {
-            target_entry_index = i;
-            break;
+// the whole part to the stdio uart, bulk reads and raw bytes so it runs at the uart's speed
+void eeprom_export() {
+    static uint8_t buffer[EEPROM_EXPORT_READ_SIZE];
+    printf("[EEPROM] Export of %d bytes follows\n", MAX_EEPROM_ADDR);
+    stdio_flush();
+    for (uint32_t address = 0; address < MAX_EEPROM_ADDR; address += EEPROM_EXPORT_READ_SIZE) {
+        eeprom_read_bytes((uint16_t)address, buffer, EEPROM_EXPORT_READ_SIZE);
+        for (uint32_t offset = 0; offset < EEPROM_EXPORT_READ_SIZE; offset += EEPROM_EXPORT_FRAME_SIZE) {
+            export_frame(EEPROM_EXPORT_DATA, (uint16_t)(address + offset), &buffer[offset], EEPROM_EXPORT_FRAME_SIZE);
         }
     }
-    // entry_index remains -1, means I go through all position for entries,and every one is valid.
-    if (target_entry_index == -1) {
-        printf("Log full, erasing all logs...\n");
-        log_erase_all();
-        target_entry_index = 0;
-    }
+    uint8_t size[2] = { (uint8_t)(MAX_EEPROM_ADDR & 0xFF), (uint8_t)(MAX_EEPROM_ADDR >> 8) };
+    export_frame(EEPROM_EXPORT_END, 0, size, sizeof(size));
+    stdio_flush();
+}
+
+// one 12 byte write per event, the head comes from RAM and overwrites the oldest record
+void log_write_event(uint8_t event, uint8_t wheel, uint16_t arg0, uint16_t arg1) {
+    if (!is_log_head_known) log_find_head();
+    uint16_t target_entry_index = log_head;
+    uint32_t now_s = to_ms_since_boot(get_absolute_time()) / 1000;
 
-    //use uint8_t because crc16 arguments need uint8_t
-    uint8_t entry[LOG_ENTRY_SIZE]={0};
-    size_t msg_length = strlen(message);
-    if (msg_length > MAX_MESSAGE_LENGTH) {
-        msg_length = MAX_MESSAGE_LENGTH;
+    LogRecord record = {
+        .sequence = log_next_sequence,
+        .event = event,
+        .wheel = wheel,
+        .time_delta_s = now_s - log_last_time_s,
+        .arg0 = arg0,
+        .arg1 = arg1,
+    };
+    uint8_t buffer[LOG_RECORD_SIZE];
+    log_record_encode(&record, buffer);
+    eeprom_writer_write(log_record_address(target_entry_index), buffer, LOG_RECORD_SIZE);
+    log_last_time_s = now_s;
+    log_next_sequence++;
+    if (++log_head >= LOG_MAX_ENTRIES) {
+        log_head = 0;
+        is_log_wrapped = true;
     }
-    memcpy(entry,message, msg_length);
-    entry[msg_length] = '\0';
+    state_journal_record(&record);
 
-    uint16_t crc = crc16(entry, msg_length+1);
-    entry[msg_length+1] = (uint8_t)(crc >> 8);
-    entry[msg_length+2] = (uint8_t)(crc & 0xFF);
-    uint16_t write_address = LOG_BASE_ADDRESS + (target_entry_index * LOG_ENTRY_SIZE);
-    eeprom_write_bytes(write_address, entry, LOG_ENTRY_SIZE);
-    printf("[Log %d]: %s\n", target_entry_index, message);
+    char text[MAX_MESSAGE_LENGTH];
+    log_record_format(&record, text, sizeof(text));
+    printf("[Log %d]: %s\n", target_entry_index, text);
 }
 
 void eeprom_init() {
-    i2c_init(I2C_PORT, 100 * 1000); //100kHz
-    gpio_set_function(EEPROM_SDA_GPIO, GPIO_FUNC_I2C);
-    gpio_set_function(EEPROM_SCL_GPIO, GPIO_FUNC_I2C);
-    gpio_pull_up(EEPROM_SDA_GPIO);
-    gpio_pull_up(EEPROM_SCL_GPIO);
+    i2c_hal_init(EEPROM_I2C_BUS, EEPROM_I2C_BAUDRATE, EEPROM_SDA_GPIO, EEPROM_SCL_GPIO);
+    eeprom_writer_init();
+    log_find_head();
 }
 
-void save_dispenser_state_to_eeprom(DispenserState *state) {
+// layout written before the fixed-point change, only read for migration
+typedef struct {
+    float step_per_revolution;
+    uint8_t pill_treatment_period;
+    uint8_t pill_dispensed_count;
+    bool is_calibrated;
+    uint8_t motor_status;
+    uint16_t crc16;
+} LegacyDispenserState;
+
+static void wheel_state_defaults(WheelState *wheel) {
+    memset(wheel, 0, sizeof(*wheel));
+    wheel->step_per_revolution_q8 = DEFAULT_STEP_PER_REVOLUTION << SPR_Q8_SHIFT;
+    wheel->pill_treatment_period = DEFAULT_PERIOD;
+}
+
+static void state_defaults(DispenserState *state) {
+    memset(state, 0, sizeof(*state));
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+        wheel_state_defaults(&state->wheels[i]);
+    }
+}
+
+// the old record becomes wheel 0, other wheels start uncalibrated
+static void migrate_wheel0(DispenserState *state, uint32_t spr_q8, uint8_t period, uint8_t count,
+                           bool is_calibrated, uint8_t motor_status) {
+    state_defaults(state);
+    state->wheels[0].step_per_revolution_q8 = spr_q8;
+    state->wheels[0].pill_treatment_period = period;
+    state->wheels[0].pill_dispensed_count = count;
+    state->wheels[0].flags = (is_calibrated ? WHEEL_STATE_CALIBRATED : 0) |
+                             (motor_status ? WHEEL_STATE_MOTOR_RUNNING : 0);
+}
+
+static bool migrate_legacy_state(const uint8_t *raw, DispenserState *state) {
+    LegacyDispenserState legacy;
+    memcpy(&legacy, raw, sizeof(legacy));
+    size_t data_length = offsetof(LegacyDispenserState, crc16);
+    if (crc16((const uint8_t *)&legacy, data_length) != legacy.crc16) return false;
+
+    // the only float left, once per boot until the state is saved again
+    migrate_wheel0(state, (uint32_t)(legacy.step_per_revolution * (1 << SPR_Q8_SHIFT) + 0.5f),
+                   legacy.pill_treatment_period, legacy.pill_dispensed_count,
+                   legacy.is_calibrated, legacy.motor_status);
+    printf("[EEPROM] Migrated float state record.\n");
+    return true;
+}
+
+static bool state_record_is_valid(const uint8_t *raw) {
+    uint8_t stored_wheels = raw[offsetof(DispenserState, wheel_count)];
+    if (raw[0] != DISPENSER_STATE_VERSION) return false;
+    if (stored_wheels < 1 || stored_wheels > MAX_STORED_WHEELS) return false;
+    size_t data_length = offsetof(DispenserState, wheels) + stored_wheels * sizeof(WheelState);
+    uint16_t stored_crc;
+    memcpy(&stored_crc, &raw[data_length], sizeof(stored_crc));
+    return crc16(raw, data_length) == stored_crc;
+}
+
+static uint16_t state_record_sequence(const uint8_t *raw) {
+    uint16_t sequence;
+    memcpy(&sequence, &raw[offsetof(DispenserState, sequence)], sizeof(sequence));
+    return sequence;
+}
+
+// newest slot and the next sequence number, found once at boot and kept in RAM.
+// journal_state is the last checkpoint with the records logged since applied, what a boot
+// would rebuild. a save that matches it writes nothing.
+static bool is_state_slot_known = false;
+static int state_newest_slot = -1; // -1 while no slot was written
+static uint16_t state_next_sequence = 1;
+static DispenserState journal_state;
+static bool has_journal_state = false;
+static uint16_t records_since_checkpoint = 0;
+
+static bool state_read_slot(int index, uint8_t *raw) {
+    eeprom_read_bytes(STATE_SLOTS_ADDR + index * STATE_SLOT_SIZE, raw, STATE_SLOT_SIZE);
+    return state_record_is_valid(raw);
+}
+
+// slots are written in turn like the log, slots before the next one carry consecutive
+// sequence numbers from slot 0 on. a binary search needs log2(STATE_SLOT_COUNT) + 2 reads.
+// leaves the newest record in raw, false if no slot is valid.
+static bool state_find_newest(uint8_t *raw) {
+    is_state_slot_known = true;
+    state_newest_slot = -1;
+    if (!state_read_slot(0, raw)) {
+        // slot 0 torn while wrapping, then the newest is the last slot
+        if (!state_read_slot(STATE_SLOT_COUNT - 1, raw)) return false;
+        state_newest_slot = STATE_SLOT_COUNT - 1;
+    } else {
+        uint16_t first_sequence = state_record_sequence(raw);
+        int low = 1;
+        int high = STATE_SLOT_COUNT;
+        uint8_t candidate[STATE_SLOT_SIZE];
+        while (low < high) {
+            int mid = (low + high) / 2;
+            if (state_read_slot(mid, candidate) && state_record_sequence(candidate) == (uint16_t)(first_sequence + mid)) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        state_newest_slot = low - 1;
+        if (state_newest_slot > 0) state_read_slot(state_newest_slot, raw);
+    }
+    state_next_sequence = (uint16_t)(state_record_sequence(raw) + 1);
+    return true;
+}
+
+static void state_write_checkpoint() {
+    if (!has_journal_state) return;
+    if (!is_state_slot_known) {
+        uint8_t raw[STATE_SLOT_SIZE];
+        state_find_newest(raw);
+    }
+    if (!is_log_head_known) log_find_head();
+    DispenserState *state = &journal_state;
+    state->version = DISPENSER_STATE_VERSION;
+    state->wheel_count = WHEEL_COUNT;
+    state->sequence = state_next_sequence++;
+    state->log_sequence = log_next_sequence;
     size_t data_length = offsetof(DispenserState, crc16);
     state->crc16 = crc16((uint8_t *)state, data_length);
-    eeprom_write_bytes(STORE_DISPENSER_ADDR, (uint8_t *)state, sizeof(DispenserState));
+    state_newest_slot = (state_newest_slot + 1) % STATE_SLOT_COUNT;
+    eeprom_writer_write(STATE_SLOTS_ADDR + state_newest_slot * STATE_SLOT_SIZE, (uint8_t *)state, sizeof(DispenserState));
+    records_since_checkpoint = 0;
 }
 
-bool load_dispenser_state_from_eeprom(DispenserState *state) {
-    eeprom_read_bytes(STORE_DISPENSER_ADDR, (uint8_t *)state, sizeof(DispenserState));
-    size_t data_length = offsetof(DispenserState, crc16);
-    uint16_t computed_crc = crc16((uint8_t *)state, data_length);
+// a checkpoint with every record logged so far in it, also before the state was loaded this boot
+static void state_write_full_checkpoint() {
+    if (!has_journal_state) {
+        DispenserState state;
+        load_dispenser_state_from_eeprom(&state);
+    }
+    state_write_checkpoint();
+}
+
+// what a dispense record changes in the state, the same when it is logged and when it is replayed
+static void state_apply_record(DispenserState *state, const LogRecord *record) {
+    if (record->event == LOG_EVENT_EMPTY) {
+        for (int i = 0; i < WHEEL_COUNT; i++) {
+            state->wheels[i].flags &= ~WHEEL_STATE_CALIBRATED;
+            state->wheels[i].pill_dispensed_count = 0;
+        }
+        return;
+    }
+    // a single wheel dispenser logs without a wheel number
+    uint wheel = record->wheel == LOG_NO_WHEEL ? 0 : record->wheel;
+    if (wheel >= WHEEL_COUNT) return;
+    WheelState *w = &state->wheels[wheel];
+    switch (record->event) {
+        case LOG_EVENT_DISPENSE_INTENT:
+            w->pill_dispensed_count = (uint8_t)record->arg0;
+            w->intent_slot = (uint8_t)record->arg1;
+            w->flags |= WHEEL_STATE_MOTOR_RUNNING;
+            break;
+        case LOG_EVENT_PILL_OK:
+            w->pill_dispensed_count = (uint8_t)record->arg0;
+            w->pill_treatment_period = (uint8_t)record->arg1;
+            w->flags &= ~WHEEL_STATE_MOTOR_RUNNING;
+            w->intent_slot = 0;
+            break;
+        case LOG_EVENT_PILL_MISSING:
+        case LOG_EVENT_PILL_NOISE:
+            w->flags &= ~WHEEL_STATE_MOTOR_RUNNING;
+            w->intent_slot = 0;
+            break;
+        default:
+            break;
+    }
+}
+
+static void state_journal_record(const LogRecord *record) {
+    if (!has_journal_state) return;
+    state_apply_record(&journal_state, record);
+    if (++records_since_checkpoint >= STATE_CHECKPOINT_INTERVAL) state_write_checkpoint();
+}
+
+// records from the checkpoint on, skipping torn ones. the order of the log is kept.
+static void state_replay_log(DispenserState *state, uint16_t from_sequence) {
+    // the log was erased after the checkpoint, new records carry on from the checkpoint's number
+    // or the next replay would take them for records from before it
+    if ((int16_t)(log_next_sequence - from_sequence) < 0) {
+        printf("[EEPROM] Log behind the checkpoint, sequence continues at %u\n", from_sequence);
+        log_next_sequence = from_sequence;
+        records_since_checkpoint = 0;
+        return;
+    }
+    uint16_t distance = log_next_sequence - from_sequence;
+    uint16_t available = is_log_wrapped ? LOG_MAX_ENTRIES : log_head;
+    if (distance > LOG_MAX_ENTRIES) {
+        printf("[EEPROM] Checkpoint does not match the log, nothing replayed\n");
+        return;
+    }
+    if (distance > available) {
+        printf("[EEPROM] %u records after the checkpoint are gone\n", distance - available);
+        distance = available;
+    }
+    uint16_t replayed = 0;
+    LogPageCache cache = { .page = -1 };
+    for (uint16_t n = distance; n > 0; n--) {
+        LogRecord record;
+        uint16_t index = (log_head + LOG_MAX_ENTRIES - n) % LOG_MAX_ENTRIES;
+        if (!log_read_cached(&cache, index, &record) || record.sequence != (uint16_t)(log_next_sequence - n)) continue;
+        state_apply_record(state, &record);
+        replayed++;
+    }
+    records_since_checkpoint = distance;
+    printf("[EEPROM] Replayed %u log records after the checkpoint\n", replayed);
+}
 
-    if (computed_crc != state->crc16) {
-        printf("[EEPROM] CRC mismatch: stored=0x%04X, computed=0x%04X\n",
-               state->crc16, computed_crc);
-        return false;
+void save_dispenser_state_to_eeprom(DispenserState *state) {
+    if (has_journal_state && memcmp(state->wheels, journal_state.wheels, sizeof(state->wheels)) == 0) {
+        return; // the checkpoint and the log already say this
+    }
+    memcpy(journal_state.wheels, state->wheels, sizeof(state->wheels));
+    has_journal_state = true;
+    state_write_checkpoint();
+}
+
+// a record saved with a different WHEEL_COUNT still loads, missing wheels get defaults
+bool load_dispenser_state_from_eeprom(DispenserState *state) {
+    if (!is_log_head_known) log_find_head();
+    uint8_t raw[STORE_DISPENSER_SIZE];
+    if (state_find_newest(raw)) {
+        printf("[EEPROM] State slot %d, seq=%u\n", state_newest_slot, state_record_sequence(raw));
+    } else {
+        // no slot written yet, the state page of older firmware
+        eeprom_read_bytes(STORE_DISPENSER_ADDR, raw, sizeof(raw));
+        if (!state_record_is_valid(raw)) {
+            if (migrate_legacy_state(raw, state)) return true;
+            printf("[EEPROM] No valid state record.\n");
+            return false;
+        }
     }
 
-    printf("[EEPROM] State OK: step=%.2f, count=%d/%d, calibrated=%d\n",
-           state->step_per_revolution,
-           state->pill_dispensed_count,
-           state->pill_treatment_period,
-           state->is_calibrated);
+    uint8_t stored_wheels = raw[offsetof(DispenserState, wheel_count)];
+    state_defaults(state);
+    uint8_t wheels = stored_wheels < WHEEL_COUNT ? stored_wheels : WHEEL_COUNT;
+    memcpy(state->wheels, &raw[offsetof(DispenserState, wheels)], wheels * sizeof(WheelState));
+    uint16_t log_sequence;
+    memcpy(&log_sequence, &raw[offsetof(DispenserState, log_sequence)], sizeof(log_sequence));
+    state_replay_log(state, log_sequence);
+    for (int i = 0; i < wheels; i++) {
+        printf("[EEPROM] Wheel %d state OK: step=%lu/256, count=%d/%d, flags=0x%02X\n", i,
+               (unsigned long)state->wheels[i].step_per_revolution_q8,
+               state->wheels[i].pill_dispensed_count,
+               state->wheels[i].pill_treatment_period,
+               state->wheels[i].flags);
+    }
+    // what a boot rebuilds, a record of another wheel count is rewritten on the next save
+    journal_state = *state;
+    has_journal_state = stored_wheels == WHEEL_COUNT;
     return true;
+}
+
+static uint16_t wheel_journal_sequence[WHEEL_COUNT];
+
+// slots are written in turn, so a torn write only loses the record being written
+void save_wheel_journal(uint8_t wheel, WheelJournal *journal) {
+    journal->sequence = ++wheel_journal_sequence[wheel];
+    size_t data_length = offsetof(WheelJournal, crc16);
+    journal->crc16 = crc16((uint8_t *)journal, data_length);
+    uint16_t address = WHEEL_JOURNAL_ADDR(wheel) + (journal->sequence % WHEEL_JOURNAL_SLOTS) * WHEEL_JOURNAL_SLOT_SIZE;
+    eeprom_writer_write(address, (uint8_t *)journal, sizeof(WheelJournal));
+}
+
+bool load_wheel_journal(uint8_t wheel, WheelJournal *journal) {
+    bool found = false;
+    for (int i = 0; i < WHEEL_JOURNAL_SLOTS; i++) {
+        WheelJournal candidate;
+        eeprom_read_bytes(WHEEL_JOURNAL_ADDR(wheel) + i * WHEEL_JOURNAL_SLOT_SIZE, (uint8_t *)&candidate, sizeof(candidate));
+        size_t data_length = offsetof(WheelJournal, crc16);
+        if (crc16((uint8_t *)&candidate, data_length) != candidate.crc16) continue;
+        if (!found || (int16_t)(candidate.sequence - journal->sequence) > 0) {
+            *journal = candidate;
+            found = true;
+        }
+    }
+    if (found) {
+        wheel_journal_sequence[wheel] = journal->sequence;
+        printf("[EEPROM] Wheel %d journal OK: seq=%u, slot=%d, offset=%ld, flags=0x%02X\n", wheel,
+               journal->sequence, journal->wheel_slot, (long)journal->offset_from_home, journal->flags);
+    }
+    return found;
 }
\ No newline at end of file
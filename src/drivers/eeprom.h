@@ -7,35 +7,101 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdbool.h>
+#include "../config.h"
+#include "log_record.h"
 
 #define EEPROM_ADDR 0x50 //because A0,A1 are grounded
 #define MAX_EEPROM_ADDR (32*1024) //32768 bytes
 
+// single state page of older firmware, only read while no state slot is valid
 #define STORE_DISPENSER_ADDR (MAX_EEPROM_ADDR - 64)
+#define STORE_DISPENSER_SIZE 64
+// two 64 byte slots per wheel, written alternately, wheel 0 highest
+#define WHEEL_JOURNAL_SLOTS 2
+#define WHEEL_JOURNAL_SLOT_SIZE 64
+#define WHEEL_JOURNAL_ADDR(wheel) (MAX_EEPROM_ADDR - 192 - (wheel) * WHEEL_JOURNAL_SLOTS * WHEEL_JOURNAL_SLOT_SIZE)
 #define LOG_BASE_ADDRESS 0
 #define LOG_SIZE (4096*4) //bytes
-#define LOG_ENTRY_SIZE 64 //bytes
-#define LOG_MAX_ENTRIES (LOG_SIZE / LOG_ENTRY_SIZE)
+#define EEPROM_PAGE_SIZE 64
+// the state goes to the next of these pages on every save, so no page takes all the wear
+#define STATE_SLOTS_ADDR (LOG_BASE_ADDRESS + LOG_SIZE)
+#define STATE_SLOT_COUNT 32
+#define STATE_SLOT_SIZE STORE_DISPENSER_SIZE
+#define EEPROM_WRITE_TIMEOUT_US 10000 // tWR is 5 ms on the AT24C256C, 10 ms on older parts
+// binary records (log_record.h), a record never spans two pages
+#define LOG_RECORDS_PER_PAGE (EEPROM_PAGE_SIZE / LOG_RECORD_SIZE)
+#define LOG_MAX_ENTRIES (LOG_SIZE / EEPROM_PAGE_SIZE * LOG_RECORDS_PER_PAGE) // 1280 events
 //#define INPUT_BUFFER_SIZE 64 //bytes
-#define MAX_MESSAGE_LENGTH 61
+#define MAX_MESSAGE_LENGTH 61 // text buffers, LoRa messages
+
+// eeprom_export() frames on the stdio uart, tools/log_decode.c receives them:
+// 0xA5 0x5A, type, offset (2), length, payload, crc16 (2) over type to payload, little endian
+#define EEPROM_EXPORT_SYNC0 0xA5
+#define EEPROM_EXPORT_SYNC1 0x5A
+#define EEPROM_EXPORT_DATA 1 // payload is the image from offset on
+#define EEPROM_EXPORT_END 2 // payload is the image size (2)
+#define EEPROM_EXPORT_FRAME_SIZE 128
+#define EEPROM_EXPORT_READ_SIZE 1024 // bytes per sequential read, the address counter runs over the pages
+
+#define SPR_Q8_SHIFT 8 // step_per_revolution_q8 is 24.8 fixed point, no soft-float on the RP2040
+// the float record of the older firmware has no version byte, it is only read for migration
+#define DISPENSER_STATE_VERSION 4
+// the state is a checkpoint, the dispense records logged after it are replayed at boot.
+// a checkpoint at least this often keeps the replay well inside the records the log keeps.
+#define STATE_CHECKPOINT_INTERVAL 128
+
+#define WHEEL_STATE_CALIBRATED 0x01
+#define WHEEL_STATE_MOTOR_RUNNING 0x02 // for power-off protection, set while the wheel turns
+
+typedef struct {
+    uint32_t step_per_revolution_q8; // 4bytes
+    uint8_t pill_treatment_period;
+    uint8_t pill_dispensed_count;
+    uint8_t flags;
+    uint8_t intent_slot; // slot of the open dispense intent, valid with MOTOR_RUNNING
+} WheelState; // 8 bytes per wheel
+
+// all wheels in one page write, the crc follows the last wheel
+typedef struct {
+    uint8_t version;
+    uint8_t wheel_count;
+    uint16_t sequence; // newest valid slot wins, 0 in the old state page
+    uint16_t log_sequence; // first log record not in this checkpoint
+    uint8_t reserved[2];
+    WheelState wheels[WHEEL_COUNT];
+    uint16_t crc16;
+} DispenserState; // 8 + 8 per wheel + crc, keep 64 bytes for these structure
+
+#define MAX_STORED_WHEELS ((STORE_DISPENSER_SIZE - 10) / sizeof(WheelState))
+_Static_assert(sizeof(DispenserState) <= STORE_DISPENSER_SIZE, "too many wheels for the state page");
+_Static_assert(STATE_SLOTS_ADDR + STATE_SLOT_COUNT * STATE_SLOT_SIZE <= WHEEL_JOURNAL_ADDR(WHEEL_COUNT - 1),
+               "state slots run into the wheel journals");
+
+#define WHEEL_JOURNAL_MOVING 0x01 // written before a move, the wheel is somewhere up to the target
+#define WHEEL_JOURNAL_TRACKED 0x02 // position observer trusted the position
 
 typedef struct {
-    float step_per_revolution; // 4bytes
-    uint8_t pill_treatment_period; // 4 bytes
-    uint8_t pill_dispensed_count; // 4 bytes
-    bool is_calibrated;
-    uint8_t motor_status; // for power-off protection, 0 for stable, 1 for turning.
+    uint16_t sequence; // newest valid slot wins
+    uint8_t coil_phase; // motor half-step phase 0-7
+    uint8_t flags;
+    int32_t offset_from_home; // half-steps from the home centre
+    int32_t target_from_home; // same as offset when at rest
+    int16_t wheel_slot;
+    uint16_t gap_width;
     uint16_t crc16;
-} DispenserState; //total around 16 bytes, keep 64 bytes for these structure
+} WheelJournal;
 
 
 void log_erase_all();
 void log_read_all();
-void log_write_message(const char *message);
+void log_write_event(uint8_t event, uint8_t wheel, uint16_t arg0, uint16_t arg1);
+void eeprom_export();
 
 void eeprom_init();
 void save_dispenser_state_to_eeprom(DispenserState *state);
 bool load_dispenser_state_from_eeprom(DispenserState *state);
+void save_wheel_journal(uint8_t wheel, WheelJournal *journal);
+bool load_wheel_journal(uint8_t wheel, WheelJournal *journal);
 
 
 #endif //PILLDISPENSER_EEPROM_H
\ No newline at end of file
@@ -0,0 +1,246 @@
+#include "eeprom_writer.h"
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/i2c.h"
+#include "hardware/irq.h"
+#include "../config.h"
+#include "eeprom.h"
+
+typedef struct {
+    uint16_t addr;
+    uint8_t length;
+    uint8_t data[EEPROM_PAGE_SIZE];
+} PageJob;
+
+typedef enum {
+    WRITER_IDLE,
+    WRITER_SENDING, // page on the bus, the dma feeds the tx fifo
+    WRITER_PROGRAMMING, // part busy, polled with a one byte read until it ACKs
+} WriterState;
+
+// pages in write order, main code adds at the head and the irq takes from the tail
+static PageJob queue[EEPROM_WRITER_QUEUE_DEPTH];
+static volatile uint32_t queue_head = 0;
+static volatile uint32_t queue_tail = 0;
+static volatile WriterState writer_state = WRITER_IDLE;
+static volatile bool is_transfer_aborted = false;
+static uint32_t page_retries = 0;
+static uint32_t page_start_us = 0;
+static uint32_t programming_start_us = 0;
+
+// address bytes then data, each with the controller's command bits, the last one sends STOP
+static uint16_t dma_commands[2 + EEPROM_PAGE_SIZE];
+static uint writer_dma_chan;
+static EepromWriterStats stats;
+
+static PageJob *current_page() {
+    return &queue[queue_tail % EEPROM_WRITER_QUEUE_DEPTH];
+}
+
+static void send_page() {
+    const PageJob *job = current_page();
+    dma_commands[0] = (uint8_t)(job->addr >> 8);
+    dma_commands[1] = (uint8_t)(job->addr & 0xFF);
+    for (uint i = 0; i < job->length; i++) {
+        dma_commands[2 + i] = job->data[i];
+    }
+    dma_commands[1 + job->length] |= I2C_IC_DATA_CMD_STOP_BITS;
+    is_transfer_aborted = false;
+    writer_state = WRITER_SENDING;
+    dma_channel_transfer_from_buffer_now(writer_dma_chan, dma_commands, 2 + job->length);
+}
+
+// the part does not answer its address while it programs the page
+static void send_ack_poll() {
+    is_transfer_aborted = false;
+    i2c_get_hw(I2C_PORT)->data_cmd = I2C_IC_DATA_CMD_CMD_BITS | I2C_IC_DATA_CMD_STOP_BITS;
+}
+
+static int64_t retry_alarm(alarm_id_t id, void *user_data) {
+    if (writer_state == WRITER_IDLE) return 0; // the queue was dropped meanwhile
+    if (writer_state == WRITER_SENDING) send_page();
+    else send_ack_poll();
+    return 0;
+}
+
+static void retry_later() {
+    if (add_alarm_in_us(EEPROM_ACK_POLL_INTERVAL_US, retry_alarm, NULL, true) < 0) {
+        retry_alarm(0, NULL); // no free alarm, poll straight away
+    }
+}
+
+// next page, or idle with the controller interrupts off so blocking transfers can run
+static void start_next_page() {
+    if (queue_tail == queue_head) {
+        writer_state = WRITER_IDLE;
+        i2c_get_hw(I2C_PORT)->intr_mask = 0;
+        return;
+    }
+    page_retries = 0;
+    page_start_us = time_us_32();
+    send_page();
+}
+
+static void finish_page(bool is_written) {
+    if (is_written) {
+        stats.pages_written++;
+        stats.bytes_written += current_page()->length;
+        uint32_t page_us = time_us_32() - page_start_us;
+        if (page_us > stats.max_page_us) stats.max_page_us = page_us;
+    } else {
+        stats.pages_failed++;
+    }
+    queue_tail++;
+    start_next_page();
+}
+
+// every transfer ends with STOP, also after a NACK, so the writer moves on at STOP_DET
+static void eeprom_writer_irq_handler() {
+    i2c_hw_t *hw = i2c_get_hw(I2C_PORT);
+    uint32_t status = hw->raw_intr_stat;
+    if (status & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+        // the controller flushed its fifo, stop feeding it
+        (void)hw->clr_tx_abrt;
+        dma_channel_abort(writer_dma_chan);
+        is_transfer_aborted = true;
+    }
+    if (!(status & I2C_IC_RAW_INTR_STAT_STOP_DET_BITS)) return;
+    (void)hw->clr_stop_det;
+    while (hw->rxflr) (void)hw->data_cmd; // the byte of an answered poll
+
+    if (writer_state == WRITER_SENDING) {
+        if (!is_transfer_aborted) {
+            writer_state = WRITER_PROGRAMMING;
+            programming_start_us = time_us_32();
+            send_ack_poll();
+        } else if (++page_retries < EEPROM_WRITER_RETRIES) {
+            retry_later();
+        } else {
+            finish_page(false);
+        }
+    } else if (writer_state == WRITER_PROGRAMMING) {
+        if (!is_transfer_aborted) {
+            finish_page(true);
+        } else if (time_us_32() - programming_start_us > EEPROM_WRITE_TIMEOUT_US) {
+            finish_page(false);
+        } else {
+            retry_later();
+        }
+    }
+}
+
+void eeprom_writer_init() {
+    i2c_hw_t *hw = i2c_get_hw(I2C_PORT);
+    writer_dma_chan = (uint)dma_claim_unused_channel(true);
+    dma_channel_config dc = dma_channel_get_default_config(writer_dma_chan);
+    channel_config_set_transfer_data_size(&dc, DMA_SIZE_16);
+    channel_config_set_read_increment(&dc, true);
+    channel_config_set_write_increment(&dc, false);
+    channel_config_set_dreq(&dc, i2c_get_dreq(I2C_PORT, true));
+    dma_channel_configure(writer_dma_chan, &dc, &hw->data_cmd, dma_commands, 0, false);
+
+    hw->intr_mask = 0;
+    uint irq = I2C0_IRQ + i2c_hw_index(I2C_PORT);
+    irq_set_exclusive_handler(irq, eeprom_writer_irq_handler);
+    irq_set_enabled(irq, true);
+}
+
+// the irq never came back, count the queued pages as failed and leave the controller off.
+// the next write enables it again, as after the blocking transfers.
+static void drop_queue() {
+    uint32_t irq = save_and_disable_interrupts();
+    dma_channel_abort(writer_dma_chan);
+    i2c_hw_t *hw = i2c_get_hw(I2C_PORT);
+    hw->intr_mask = 0;
+    hw->enable = 0;
+    uint32_t dropped = queue_head - queue_tail;
+    stats.pages_failed += dropped;
+    stats.stalls++;
+    queue_tail = queue_head;
+    writer_state = WRITER_IDLE;
+    restore_interrupts(irq);
+    printf("[EEPROM] Writer stuck, %lu pages dropped\n", (unsigned long)dropped);
+}
+
+// until at most depth pages are queued. the limit is per page, a long queue that keeps
+// moving is not cut off.
+static bool wait_for_depth(uint32_t depth) {
+    uint32_t tail = queue_tail;
+    uint32_t since_us = time_us_32();
+    while (queue_head - queue_tail > depth) {
+        if (queue_tail != tail) {
+            tail = queue_tail;
+            since_us = time_us_32();
+        } else if (time_us_32() - since_us > EEPROM_WRITER_PAGE_TIMEOUT_US) {
+            drop_queue();
+            return false;
+        }
+        tight_loop_contents();
+    }
+    return true;
+}
+
+// copies the data into the queue page by page, waits only while the queue is full.
+// pages reach the part in the order they were queued.
+void eeprom_writer_write(uint16_t addr, const uint8_t *data_p, size_t length) {
+    i2c_hw_t *hw = i2c_get_hw(I2C_PORT);
+    while (length > 0) {
+        // a page write wraps inside its 64 byte page, so longer or unaligned writes are split
+        size_t chunk = EEPROM_PAGE_SIZE - (addr % EEPROM_PAGE_SIZE);
+        if (chunk > length) chunk = length;
+        if (queue_head - queue_tail >= EEPROM_WRITER_QUEUE_DEPTH) {
+            stats.queue_full_waits++;
+            wait_for_depth(EEPROM_WRITER_QUEUE_DEPTH - 1);
+        }
+        PageJob *job = &queue[queue_head % EEPROM_WRITER_QUEUE_DEPTH];
+        job->addr = addr;
+        job->length = (uint8_t)chunk;
+        memcpy(job->data, data_p, chunk);
+
+        uint32_t irq = save_and_disable_interrupts();
+        queue_head++;
+        uint32_t depth = queue_head - queue_tail;
+        if (depth > stats.max_depth) stats.max_depth = depth;
+        if (writer_state == WRITER_IDLE) {
+            // the blocking transfers may have left another target or stale flags
+            hw->enable = 0;
+            hw->tar = EEPROM_ADDR;
+            hw->enable = 1;
+            (void)hw->clr_tx_abrt;
+            (void)hw->clr_stop_det;
+            hw->intr_mask = I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+            start_next_page();
+        }
+        restore_interrupts(irq);
+
+        addr += chunk;
+        data_p += chunk;
+        length -= chunk;
+    }
+}
+
+// barrier: returns once every queued page is programmed (or given up).
+// false when one of them was given up or the writer got stuck on it.
+bool eeprom_writer_flush() {
+    uint32_t start_us = time_us_32();
+    uint32_t failed = stats.pages_failed;
+    wait_for_depth(0);
+    uint32_t flush_us = time_us_32() - start_us;
+    if (flush_us > stats.max_flush_us) stats.max_flush_us = flush_us;
+    return stats.pages_failed == failed;
+}
+
+const EepromWriterStats *eeprom_writer_get_stats() {
+    return &stats;
+}
+
+void eeprom_writer_report() {
+    printf("[EEPROM] %lu pages, %lu bytes written, %lu failed, queue max %lu/%d, %lu full waits, %lu stalls\n",
+           (unsigned long)stats.pages_written, (unsigned long)stats.bytes_written, (unsigned long)stats.pages_failed,
+           (unsigned long)stats.max_depth, EEPROM_WRITER_QUEUE_DEPTH, (unsigned long)stats.queue_full_waits,
+           (unsigned long)stats.stalls);
+    printf("[EEPROM] page max %lu us, flush max %lu us\n",
+           (unsigned long)stats.max_page_us, (unsigned long)stats.max_flush_us);
+}
@@ -0,0 +1,36 @@
+//
+// Background EEPROM page writes: a bounded queue drained by DMA and the I2C interrupt.
+//
+
+#ifndef PILLDISPENSER_EEPROM_WRITER_H
+#define PILLDISPENSER_EEPROM_WRITER_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "pico/types.h"
+
+#define EEPROM_WRITER_QUEUE_DEPTH 8 // pages, 68 bytes of RAM each
+#define EEPROM_WRITER_RETRIES 3 // NACKed page transfers before the page is given up
+#define EEPROM_ACK_POLL_INTERVAL_US 250
+// a page that is neither written nor given up by then means the writer is stuck (no STOP_DET,
+// a hung bus), its queue is dropped. covers the retries, a 100 kHz transfer and the write cycle.
+#define EEPROM_WRITER_PAGE_TIMEOUT_US 25000
+
+typedef struct {
+    uint32_t pages_written;
+    uint32_t bytes_written;
+    uint32_t pages_failed; // NACKed EEPROM_WRITER_RETRIES times or no ACK within EEPROM_WRITE_TIMEOUT_US
+    uint32_t queue_full_waits; // a write waited for a free page in the queue
+    uint32_t max_page_us; // first byte on the bus until the part ACKs again
+    uint32_t max_flush_us;
+    uint32_t max_depth;
+    uint32_t stalls; // waits that ran into EEPROM_WRITER_PAGE_TIMEOUT_US
+} EepromWriterStats;
+
+void eeprom_writer_init();
+void eeprom_writer_write(uint16_t addr, const uint8_t *data_p, size_t length);
+bool eeprom_writer_flush(); // false when a queued page did not make it to the part
+const EepromWriterStats *eeprom_writer_get_stats();
+void eeprom_writer_report();
+
+#endif //PILLDISPENSER_EEPROM_WRITER_H
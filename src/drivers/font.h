@@ -0,0 +1,31 @@
+//
+// Bitmap fonts for the SSD1306, one copy each in flash.
+//
+
+#ifndef PILLDISPENSER_FONT_H
+#define PILLDISPENSER_FONT_H
+#include <stdint.h>
+
+#define FONT_MAX_GLYPH_BYTES 64 // 16 columns by 4 pages
+#define FONT_BLOCK_GLYPHS 8 // a packed font keeps the data offset of every 8th glyph
+
+// a glyph is width columns per page, page after page, as the panel takes them.
+// a packed font keeps only the non-zero bytes, a mask bit per glyph byte marks them.
+typedef struct {
+    uint8_t width; // columns
+    uint8_t pages; // 8 pixel rows each
+    char first;
+    uint8_t count;
+    const uint8_t *data;
+    const uint8_t *masks; // NULL when the font is not packed
+    const uint16_t *block_offsets;
+} Font;
+
+extern const Font font_8x16; // ASCII ' ' to '~'
+extern const Font font_16x32_digits; // '/' and '0' to '9', for the pill counter
+
+// the glyph's columns, straight from flash or unpacked into buffer (FONT_MAX_GLYPH_BYTES).
+// a character the font does not have is blank.
+const uint8_t *font_glyph(const Font *font, char chr, uint8_t *buffer);
+
+#endif //PILLDISPENSER_FONT_H
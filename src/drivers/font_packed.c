@@ -0,0 +1,134 @@
+//
+// Written by tools/font_pack.c from the fonts in font.c, do not edit.
+//
+
+#include <stdint.h>
+#include "config.h"
+#include "pico/platform.h"
+
+#if OLED_FONT_PACKED
+
+// 95 glyphs of 8x16, 1520 bytes plain
+const uint8_t __in_flash("font") font_8x16_packed[] = {
+    0xF8, 0x33, 0x30, 0x10, 0x0C, 0x06, 0x10, 0x0C, 0x06, 0x40, 0xC0, 0x78, 0x40, 0xC0, 0x78, 0x40,
+    0x04, 0x3F, 0x04, 0x04, 0x3F, 0x04, 0x04, 0x70, 0x88, 0xFC, 0x08, 0x30, 0x18, 0x20, 0xFF, 0x21,
+    0x1E, 0xF0, 0x08, 0xF0, 0xE0, 0x18, 0x21, 0x1C, 0x03, 0x1E, 0x21, 0x1E, 0xF0, 0x08, 0x88, 0x70,
+    0x1E, 0x21, 0x23, 0x24, 0x19, 0x27, 0x21, 0x10, 0x10, 0x16, 0x0E, 0xE0, 0x18, 0x04, 0x02, 0x07,
+    0x18, 0x20, 0x40, 0x02, 0x04, 0x18, 0xE0, 0x40, 0x20, 0x18, 0x07, 0x40, 0x40, 0x80, 0xF0, 0x80,
+    0x40, 0x40, 0x02, 0x02, 0x01, 0x0F, 0x01, 0x02, 0x02, 0xF0, 0x01, 0x01, 0x01, 0x1F, 0x01, 0x01,
+    0x01, 0x80, 0xB0, 0x70, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x30, 0x30, 0x80, 0x60, 0x18,
+    0x04, 0x60, 0x18, 0x06, 0x01, 0xE0, 0x10, 0x08, 0x08, 0x10, 0xE0, 0x0F, 0x10, 0x20, 0x20, 0x10,
+    0x0F, 0x10, 0x10, 0xF8, 0x20, 0x20, 0x3F, 0x20, 0x20, 0x70, 0x08, 0x08, 0x08, 0x88, 0x70, 0x30,
+    0x28, 0x24, 0x22, 0x21, 0x30, 0x30, 0x08, 0x88, 0x88, 0x48, 0x30, 0x18, 0x20, 0x20, 0x20, 0x11,
+    0x0E, 0xC0, 0x20, 0x10, 0xF8, 0x07, 0x04, 0x24, 0x24, 0x3F, 0x24, 0xF8, 0x08, 0x88, 0x88, 0x08,
+    0x08, 0x19, 0x21, 0x20, 0x20, 0x11, 0x0E, 0xE0, 0x10, 0x88, 0x88, 0x18, 0x0F, 0x11, 0x20, 0x20,
+    0x11, 0x0E, 0x38, 0x08, 0x08, 0xC8, 0x38, 0x08, 0x3F, 0x70, 0x88, 0x08, 0x08, 0x88, 0x70, 0x1C,
+    0x22, 0x21, 0x21, 0x22, 0x1C, 0xE0, 0x10, 0x08, 0x08, 0x10, 0xE0, 0x31, 0x22, 0x22, 0x11, 0x0F,
+    0xC0, 0xC0, 0x30, 0x30, 0x80, 0x80, 0x60, 0x80, 0x40, 0x20, 0x10, 0x08, 0x01, 0x02, 0x04, 0x08,
+    0x10, 0x20, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04,
+    0x08, 0x10, 0x20, 0x40, 0x80, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01, 0x70, 0x48, 0x08, 0x08, 0x08,
+    0xF0, 0x30, 0x36, 0x01, 0xC0, 0x30, 0xC8, 0x28, 0xE8, 0x10, 0xE0, 0x07, 0x18, 0x27, 0x24, 0x23,
+    0x14, 0x0B, 0xC0, 0x38, 0xE0, 0x20, 0x3C, 0x23, 0x02, 0x02, 0x27, 0x38, 0x20, 0x08, 0xF8, 0x88,
+    0x88, 0x88, 0x70, 0x20, 0x3F, 0x20, 0x20, 0x20, 0x11, 0x0E, 0xC0, 0x30, 0x08, 0x08, 0x08, 0x08,
+    0x38, 0x07, 0x18, 0x20, 0x20, 0x20, 0x10, 0x08, 0x08, 0xF8, 0x08, 0x08, 0x08, 0x10, 0xE0, 0x20,
+    0x3F, 0x20, 0x20, 0x20, 0x10, 0x0F, 0x08, 0xF8, 0x88, 0x88, 0xE8, 0x08, 0x10, 0x20, 0x3F, 0x20,
+    0x20, 0x23, 0x20, 0x18, 0x08, 0xF8, 0x88, 0x88, 0xE8, 0x08, 0x10, 0x20, 0x3F, 0x20, 0x03, 0xC0,
+    0x30, 0x08, 0x08, 0x08, 0x38, 0x07, 0x18, 0x20, 0x20, 0x22, 0x1E, 0x02, 0x08, 0xF8, 0x08, 0x08,
+    0xF8, 0x08, 0x20, 0x3F, 0x21, 0x01, 0x01, 0x21, 0x3F, 0x20, 0x08, 0x08, 0xF8, 0x08, 0x08, 0x20,
+    0x20, 0x3F, 0x20, 0x20, 0x08, 0x08, 0xF8, 0x08, 0x08, 0xC0, 0x80, 0x80, 0x80, 0x7F, 0x08, 0xF8,
+    0x88, 0xC0, 0x28, 0x18, 0x08, 0x20, 0x3F, 0x20, 0x01, 0x26, 0x38, 0x20, 0x08, 0xF8, 0x08, 0x20,
+    0x3F, 0x20, 0x20, 0x20, 0x20, 0x30, 0x08, 0xF8, 0xF8, 0xF8, 0xF8, 0x08, 0x20, 0x3F, 0x3F, 0x3F,
+    0x20, 0x08, 0xF8, 0x30, 0xC0, 0x08, 0xF8, 0x08, 0x20, 0x3F, 0x20, 0x07, 0x18, 0x3F, 0xE0, 0x10,
+    0x08, 0x08, 0x08, 0x10, 0xE0, 0x0F, 0x10, 0x20, 0x20, 0x20, 0x10, 0x0F, 0x08, 0xF8, 0x08, 0x08,
+    0x08, 0x08, 0xF0, 0x20, 0x3F, 0x21, 0x01, 0x01, 0x01, 0xE0, 0x10, 0x08, 0x08, 0x08, 0x10, 0xE0,
+    0x0F, 0x18, 0x24, 0x24, 0x38, 0x50, 0x4F, 0x08, 0xF8, 0x88, 0x88, 0x88, 0x88, 0x70, 0x20, 0x3F,
+    0x20, 0x03, 0x0C, 0x30, 0x20, 0x70, 0x88, 0x08, 0x08, 0x08, 0x38, 0x38, 0x20, 0x21, 0x21, 0x22,
+    0x1C, 0x18, 0x08, 0x08, 0xF8, 0x08, 0x08, 0x18, 0x20, 0x3F, 0x20, 0x08, 0xF8, 0x08, 0x08, 0xF8,
+    0x08, 0x1F, 0x20, 0x20, 0x20, 0x20, 0x1F, 0x08, 0x78, 0x88, 0xC8, 0x38, 0x08, 0x07, 0x38, 0x0E,
+    0x01, 0xF8, 0x08, 0xF8, 0x08, 0xF8, 0x03, 0x3C, 0x07, 0x07, 0x3C, 0x03, 0x08, 0x18, 0x68, 0x80,
+    0x80, 0x68, 0x18, 0x08, 0x20, 0x30, 0x2C, 0x03, 0x03, 0x2C, 0x30, 0x20, 0x08, 0x38, 0xC8, 0xC8,
+    0x38, 0x08, 0x20, 0x3F, 0x20, 0x10, 0x08, 0x08, 0x08, 0xC8, 0x38, 0x08, 0x20, 0x38, 0x26, 0x21,
+    0x20, 0x20, 0x18, 0xFE, 0x02, 0x02, 0x02, 0x7F, 0x40, 0x40, 0x40, 0x0C, 0x30, 0xC0, 0x01, 0x06,
+    0x38, 0xC0, 0x02, 0x02, 0x02, 0xFE, 0x40, 0x40, 0x40, 0x7F, 0x04, 0x02, 0x02, 0x02, 0x04, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x02, 0x02, 0x04, 0x80, 0x80, 0x80, 0x80, 0x19, 0x24,
+    0x22, 0x22, 0x22, 0x3F, 0x20, 0x08, 0xF8, 0x80, 0x80, 0x3F, 0x11, 0x20, 0x20, 0x11, 0x0E, 0x80,
+    0x80, 0x80, 0x0E, 0x11, 0x20, 0x20, 0x20, 0x11, 0x80, 0x80, 0x88, 0xF8, 0x0E, 0x11, 0x20, 0x20,
+    0x10, 0x3F, 0x20, 0x80, 0x80, 0x80, 0x80, 0x1F, 0x22, 0x22, 0x22, 0x22, 0x13, 0x80, 0x80, 0xF0,
+    0x88, 0x88, 0x88, 0x18, 0x20, 0x20, 0x3F, 0x20, 0x20, 0x80, 0x80, 0x80, 0x80, 0x80, 0x6B, 0x94,
+    0x94, 0x94, 0x93, 0x60, 0x08, 0xF8, 0x80, 0x80, 0x80, 0x20, 0x3F, 0x21, 0x20, 0x3F, 0x20, 0x80,
+    0x98, 0x98, 0x20, 0x20, 0x3F, 0x20, 0x20, 0x80, 0x98, 0x98, 0xC0, 0x80, 0x80, 0x80, 0x7F, 0x08,
+    0xF8, 0x80, 0x80, 0x80, 0x20, 0x3F, 0x24, 0x02, 0x2D, 0x30, 0x20, 0x08, 0x08, 0xF8, 0x20, 0x20,
+    0x3F, 0x20, 0x20, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x20, 0x3F, 0x20, 0x3F, 0x20, 0x3F,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x20, 0x3F, 0x21, 0x20, 0x3F, 0x20, 0x80, 0x80, 0x80, 0x80, 0x1F,
+    0x20, 0x20, 0x20, 0x20, 0x1F, 0x80, 0x80, 0x80, 0x80, 0x80, 0xFF, 0xA1, 0x20, 0x20, 0x11, 0x0E,
+    0x80, 0x80, 0x80, 0x80, 0x0E, 0x11, 0x20, 0x20, 0xA0, 0xFF, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x20, 0x20, 0x3F, 0x21, 0x20, 0x01, 0x80, 0x80, 0x80, 0x80, 0x80, 0x33, 0x24, 0x24, 0x24,
+    0x24, 0x19, 0x80, 0x80, 0xE0, 0x80, 0x80, 0x1F, 0x20, 0x20, 0x80, 0x80, 0x80, 0x80, 0x1F, 0x20,
+    0x20, 0x20, 0x10, 0x3F, 0x20, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x01, 0x0E, 0x30, 0x08, 0x06,
+    0x01, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x0F, 0x30, 0x0C, 0x03, 0x0C, 0x30, 0x0F, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x20, 0x31, 0x2E, 0x0E, 0x31, 0x20, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x81, 0x8E, 0x70, 0x18, 0x06, 0x01, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x21, 0x30, 0x2C, 0x22,
+    0x21, 0x30, 0x80, 0x7C, 0x02, 0x02, 0x3F, 0x40, 0x40, 0xFF, 0xFF, 0x02, 0x02, 0x7C, 0x80, 0x40,
+    0x40, 0x3F, 0x06, 0x01, 0x01, 0x02, 0x02, 0x04, 0x04,
+};
+
+const uint8_t __in_flash("font") font_8x16_masks[] = {
+    0x00, 0x00, 0x08, 0x18, 0x7E, 0x00, 0x7F, 0x7F, 0x3E, 0x3E, 0x37, 0x7E, 0x1E, 0xFF, 0x07, 0x00,
+    0x78, 0x78, 0x1E, 0x1E, 0x7F, 0x7F, 0x08, 0x7F, 0x00, 0x07, 0x00, 0xFE, 0x00, 0x06, 0xF0, 0x1E,
+    0x7E, 0x7E, 0x0E, 0x3E, 0x7E, 0x7E, 0x7E, 0x7E, 0x3C, 0x7E, 0x7E, 0x7E, 0x3E, 0x7E, 0x7E, 0x08,
+    0x7E, 0x7E, 0x7E, 0x7C, 0x18, 0x18, 0x08, 0x0C, 0x7C, 0x7E, 0x7F, 0x7F, 0x3E, 0x7E, 0x7E, 0x38,
+    0x7F, 0x7F, 0x1C, 0xFF, 0x3F, 0x7F, 0x7F, 0x7F, 0x7F, 0x7F, 0x7F, 0x7F, 0x7F, 0x17, 0x3F, 0x7F,
+    0xE7, 0xFF, 0x3E, 0x3E, 0x7C, 0x1F, 0x7F, 0x7F, 0x07, 0x7F, 0x77, 0x6B, 0xEF, 0x77, 0x7F, 0x7F,
+    0x7F, 0x3F, 0x7F, 0x7F, 0x7F, 0xF7, 0x7E, 0x7E, 0x7F, 0x1C, 0xE7, 0x7E, 0xE7, 0x3C, 0x6B, 0x77,
+    0xFF, 0xFF, 0x77, 0x1C, 0x7F, 0x7F, 0x78, 0x78, 0x0E, 0x78, 0x1E, 0x1E, 0x7C, 0x00, 0x00, 0xFF,
+    0x0E, 0x00, 0x3C, 0xFE, 0x1B, 0x7E, 0x38, 0x7E, 0x78, 0xFE, 0x3C, 0x7E, 0xFE, 0x3E, 0x7C, 0x7E,
+    0x3B, 0xE7, 0x0E, 0x3E, 0x38, 0x3E, 0x73, 0x7F, 0x0E, 0x3E, 0x7F, 0xB7, 0x3B, 0xE7, 0x3C, 0x7E,
+    0x1B, 0x7F, 0x78, 0xFE, 0x77, 0x5F, 0x7C, 0x7E, 0x3E, 0x38, 0x63, 0xFE, 0xE7, 0x7E, 0xEB, 0x7F,
+    0x76, 0x7E, 0xE7, 0x7F, 0x7E, 0x7E, 0xF0, 0xE0, 0x10, 0x10, 0x1E, 0x0E, 0xFE, 0x00,
+};
+
+const uint16_t __in_flash("font") font_8x16_offsets[] = {
+    0, 59, 117, 201, 276, 380, 476, 572, 647, 724, 805, 894,
+};
+
+// 11 glyphs of 16x32, 704 bytes plain
+const uint8_t __in_flash("font") font_16x32_digit_packed[] = {
+    0xC0, 0xE0, 0x70, 0x30, 0xC0, 0xE0, 0x7C, 0x3E, 0x07, 0x03, 0xC0, 0xE0, 0x7C, 0x3E, 0x07, 0x03,
+    0x3C, 0x3E, 0x07, 0x03, 0x80, 0xC0, 0xC0, 0xC0, 0xC0, 0x80, 0xFC, 0xFE, 0x07, 0x03, 0x01, 0x01,
+    0x03, 0x07, 0xFE, 0xFC, 0xFF, 0xFF, 0x80, 0x80, 0xFF, 0xFF, 0x01, 0x03, 0x07, 0x0E, 0x0C, 0x0C,
+    0x0E, 0x07, 0x03, 0x01, 0x80, 0xC0, 0xC0, 0x03, 0x03, 0x03, 0x07, 0xFF, 0xFF, 0xFF, 0xFF, 0x0C,
+    0x0C, 0x0C, 0x0E, 0x0F, 0x0F, 0x0E, 0x0C, 0x0C, 0x0C, 0x80, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0,
+    0xC0, 0xC0, 0x80, 0x3F, 0x3F, 0x01, 0xC0, 0xE1, 0x7F, 0x3F, 0x80, 0xC0, 0xE0, 0x70, 0x38, 0x1C,
+    0x0E, 0x07, 0x03, 0x07, 0x0F, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x0E, 0x0F, 0x07, 0x80,
+    0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0x80, 0x0F, 0x0F, 0x01, 0xC0, 0xC0, 0xC0, 0xE0,
+    0x30, 0x39, 0x1F, 0x0F, 0xC0, 0xC0, 0x01, 0x03, 0x87, 0xFE, 0xFC, 0x03, 0x07, 0x0E, 0x0C, 0x0C,
+    0x0C, 0x0C, 0x0E, 0x07, 0x03, 0x01, 0x80, 0xC0, 0xC0, 0x80, 0xF0, 0xF8, 0x1C, 0x0E, 0x03, 0x03,
+    0xFF, 0xFF, 0x1F, 0x3F, 0x39, 0x30, 0x30, 0x30, 0x30, 0x78, 0xFF, 0xFF, 0x78, 0x30, 0x0C, 0x0C,
+    0x0C, 0x0E, 0x0F, 0x0F, 0x0E, 0x0C, 0x80, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0,
+    0xC0, 0xC0, 0xFF, 0xFF, 0x01, 0xC0, 0xC0, 0xC0, 0xC0, 0x80, 0xC1, 0xC3, 0x03, 0x03, 0x01, 0x01,
+    0x03, 0x87, 0xFE, 0xFC, 0x03, 0x07, 0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0E, 0x07, 0x03, 0x01, 0x80,
+    0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0x80, 0xFC, 0xFE, 0x07, 0x03, 0xC1, 0xC0, 0xC0, 0xC1, 0x83, 0x03,
+    0xFF, 0xFF, 0x87, 0x03, 0x01, 0x01, 0x03, 0x87, 0xFE, 0xFC, 0x01, 0x03, 0x07, 0x0E, 0x0C, 0x0C,
+    0x0E, 0x07, 0x03, 0x01, 0x80, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0,
+    0x0F, 0x0F, 0x01, 0x80, 0xF0, 0xF9, 0x1F, 0x0F, 0x01, 0xFF, 0xFF, 0x01, 0x0F, 0x0F, 0x80, 0xC0,
+    0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0x80, 0x3F, 0x7F, 0xE1, 0xC0, 0x80, 0x80, 0xC0, 0xE1,
+    0x7F, 0x3F, 0xF0, 0xF8, 0x1C, 0x0C, 0x07, 0x03, 0x03, 0x07, 0x0C, 0x1C, 0xF8, 0xF0, 0x03, 0x07,
+    0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x0E, 0x07, 0x03, 0x80, 0xC0, 0xC0, 0xC0, 0xC0, 0x80,
+    0xFC, 0xFE, 0x87, 0x03, 0x01, 0x01, 0x03, 0x87, 0xFE, 0xFC, 0x01, 0x03, 0x07, 0x0E, 0x0C, 0x0C,
+    0x0E, 0x03, 0x83, 0xFF, 0xFF, 0x07, 0x0F, 0x0E, 0x0C, 0x0C, 0x0E, 0x07, 0x03, 0x01,
+};
+
+const uint8_t __in_flash("font") font_16x32_digit_masks[] = {
+    0x00, 0xF0, 0x00, 0x3F, 0xF0, 0x03, 0x3C, 0x00, 0xE0, 0x07, 0x7C, 0x3E, 0x1C, 0x38, 0xF8, 0x1F,
+    0xE0, 0x00, 0xFC, 0x00, 0xC0, 0x00, 0xFC, 0x0F, 0xF8, 0x1F, 0x1C, 0x3C, 0xF8, 0x0F, 0xFC, 0x3F,
+    0xF8, 0x1F, 0xDC, 0x3F, 0x0C, 0x3E, 0xFC, 0x1F, 0x00, 0x0E, 0xF8, 0x0F, 0xFC, 0x3F, 0xC0, 0x3F,
+    0xFC, 0x3F, 0xDC, 0x07, 0x7C, 0x3E, 0xFC, 0x1F, 0xE0, 0x0F, 0xFC, 0x0F, 0x7C, 0x3E, 0xF8, 0x1F,
+    0xFC, 0x3F, 0x9C, 0x1F, 0xC0, 0x01, 0xC0, 0x00, 0xF8, 0x1F, 0x7C, 0x3E, 0xFC, 0x3F, 0xFC, 0x3F,
+    0xE0, 0x07, 0x7C, 0x3E, 0xF8, 0x3F, 0xF0, 0x1F,
+};
+
+const uint16_t __in_flash("font") font_16x32_digit_offsets[] = {
+    0, 260,
+};
+
+#endif
@@ -0,0 +1,21 @@
+#include "i2c_hal.h"
+#include "hardware/gpio.h"
+#include "hardware/i2c.h"
+
+void i2c_hal_init(uint bus, uint32_t baudrate, uint sda_gpio, uint scl_gpio) {
+    i2c_init(i2c_get_instance(bus), baudrate);
+    gpio_set_function(sda_gpio, GPIO_FUNC_I2C);
+    gpio_set_function(scl_gpio, GPIO_FUNC_I2C);
+    gpio_pull_up(sda_gpio);
+    gpio_pull_up(scl_gpio);
+}
+
+int i2c_hal_write(uint bus, uint8_t addr, const uint8_t *src, size_t length, bool nostop) {
+    int result = i2c_write_blocking(i2c_get_instance(bus), addr, src, length, nostop);
+    return result < 0 ? I2C_HAL_ERROR : result;
+}
+
+int i2c_hal_read(uint bus, uint8_t addr, uint8_t *dst, size_t length, bool nostop) {
+    int result = i2c_read_blocking(i2c_get_instance(bus), addr, dst, length, nostop);
+    return result < 0 ? I2C_HAL_ERROR : result;
+}
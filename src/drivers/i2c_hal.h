@@ -0,0 +1,20 @@
+//
+// Blocking I2C transfers by bus number, so the drivers above it also build on a PC.
+// i2c_hal.c maps them to the Pico SDK, tools/sim/i2c_hal_linux.c to simulated parts.
+//
+
+#ifndef PILLDISPENSER_I2C_HAL_H
+#define PILLDISPENSER_I2C_HAL_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "pico/types.h"
+
+#define I2C_HAL_ERROR (-2) // same value as PICO_ERROR_GENERIC: no ACK from the address
+
+void i2c_hal_init(uint bus, uint32_t baudrate, uint sda_gpio, uint scl_gpio);
+// bytes transferred or I2C_HAL_ERROR, nostop keeps the bus for a repeated start
+int i2c_hal_write(uint bus, uint8_t addr, const uint8_t *src, size_t length, bool nostop);
+int i2c_hal_read(uint bus, uint8_t addr, uint8_t *dst, size_t length, bool nostop);
+
+#endif //PILLDISPENSER_I2C_HAL_H
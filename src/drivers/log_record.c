@@ -0,0 +1,117 @@
+#include "log_record.h"
+#include <stdio.h>
+#include "crc16.h"
+
+// seconds up to 9 hours, minutes beyond, so a daily dose still gets its gap
+static uint16_t encode_time_delta(uint32_t seconds) {
+    if (seconds < LOG_TIME_DELTA_MINUTES) return (uint16_t)seconds;
+    uint32_t minutes = seconds / 60;
+    if (minutes >= LOG_TIME_DELTA_MINUTES) minutes = LOG_TIME_DELTA_MINUTES - 1;
+    return (uint16_t)(LOG_TIME_DELTA_MINUTES | minutes);
+}
+
+static uint32_t decode_time_delta(uint16_t value) {
+    if (value & LOG_TIME_DELTA_MINUTES) return (uint32_t)(value & ~LOG_TIME_DELTA_MINUTES) * 60;
+    return value;
+}
+
+static void put_u16(uint8_t *out, uint16_t value) {
+    out[0] = (uint8_t)(value & 0xFF);
+    out[1] = (uint8_t)(value >> 8);
+}
+
+static uint16_t get_u16(const uint8_t *in) {
+    return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+void log_record_encode(const LogRecord *record, uint8_t *out) {
+    put_u16(&out[0], record->sequence);
+    out[2] = record->event;
+    out[3] = record->wheel;
+    put_u16(&out[4], encode_time_delta(record->time_delta_s));
+    put_u16(&out[6], record->arg0);
+    put_u16(&out[8], record->arg1);
+    put_u16(&out[10], crc16(out, LOG_RECORD_SIZE - 2));
+}
+
+// for records whose crc was already checked, e.g. with crc16_verify_many
+bool log_record_unpack(const uint8_t *in, LogRecord *record) {
+    if (in[2] == 0 || in[2] >= LOG_EVENT_COUNT) return false;
+    record->sequence = get_u16(&in[0]);
+    record->event = in[2];
+    record->wheel = in[3];
+    record->time_delta_s = decode_time_delta(get_u16(&in[4]));
+    record->arg0 = get_u16(&in[6]);
+    record->arg1 = get_u16(&in[8]);
+    return true;
+}
+
+// false for erased, torn or foreign bytes
+bool log_record_decode(const uint8_t *in, LogRecord *record) {
+    if (crc16(in, LOG_RECORD_SIZE - 2) != get_u16(&in[10])) return false;
+    return log_record_unpack(in, record);
+}
+
+// the text the old string log used to store
+int log_record_format(const LogRecord *r, char *buffer, size_t size) {
+    char prefix[8] = "";
+    if (r->wheel != LOG_NO_WHEEL) snprintf(prefix, sizeof(prefix), "W%u ", r->wheel);
+    switch (r->event) {
+        case LOG_EVENT_BOOT:
+            return snprintf(buffer, size, "%sBOOT:Calibrated:%d,Dispensed:%d/%d,MotorStatus:%d", prefix,
+                            r->arg1 & 1, r->arg0 & 0xFF, r->arg0 >> 8, (r->arg1 >> 1) & 1);
+        case LOG_EVENT_BOOT_NEW:
+            return snprintf(buffer, size, "System Boot: No previous settings found.");
+        case LOG_EVENT_CALIBRATED_FAST:
+        case LOG_EVENT_CALIBRATED_ROUNDS:
+            return snprintf(buffer, size, "%sCAL:%s,%ums,%u steps/rev", prefix,
+                            r->event == LOG_EVENT_CALIBRATED_FAST ? "fast" : "rounds", r->arg1, r->arg0);
+        case LOG_EVENT_POSITION_CORRECTED:
+            return snprintf(buffer, size, "%sPOS: corrected %d steps", prefix, (int16_t)r->arg0);
+        case LOG_EVENT_POSITION_LOST:
+            return snprintf(buffer, size, "%sPOS: lost, full calibration next time", prefix);
+        case LOG_EVENT_PILL_OK:
+            return snprintf(buffer, size, "%sOK: %u/%u", prefix, r->arg0, r->arg1);
+        case LOG_EVENT_PILL_DOUBLE:
+            return snprintf(buffer, size, "%sDOUBLE: two pills fell", prefix);
+        case LOG_EVENT_PILL_MISSING:
+            return snprintf(buffer, size, "%sDispense failed: no pill detected", prefix);
+        case LOG_EVENT_PILL_NOISE:
+            return snprintf(buffer, size, "%sDispense failed: piezo noise, no pill", prefix);
+        case LOG_EVENT_EMPTY:
+            return snprintf(buffer, size, "EMPTY");
+        case LOG_EVENT_RECOVERED:
+            return snprintf(buffer, size, "Recovery from power-off successful");
+        case LOG_EVENT_FACTORY_RESET:
+            return snprintf(buffer, size, "System: Factory Reset Performed");
+        case LOG_EVENT_DISPENSE_ABORTED:
+            return snprintf(buffer, size, "FAULT: dispense aborted after %u failed rounds", r->arg0);
+        case LOG_EVENT_DISPENSE_INTENT:
+            return snprintf(buffer, size, "%sTURN: %u dispensed, to slot %d", prefix, r->arg0, (int16_t)r->arg1);
+        default:
+            return snprintf(buffer, size, "event %u (%u, %u)", r->event, r->arg0, r->arg1);
+    }
+}
+
+// short machine friendly names for the csv and json output of tools/log_decode.c
+const char *log_event_name(uint8_t event) {
+    static const char *const names[LOG_EVENT_COUNT] = {
+            [LOG_EVENT_BOOT] = "boot",
+            [LOG_EVENT_BOOT_NEW] = "boot_new",
+            [LOG_EVENT_CALIBRATED_FAST] = "calibrated_fast",
+            [LOG_EVENT_CALIBRATED_ROUNDS] = "calibrated_rounds",
+            [LOG_EVENT_POSITION_CORRECTED] = "position_corrected",
+            [LOG_EVENT_POSITION_LOST] = "position_lost",
+            [LOG_EVENT_PILL_OK] = "pill_ok",
+            [LOG_EVENT_PILL_DOUBLE] = "pill_double",
+            [LOG_EVENT_PILL_MISSING] = "pill_missing",
+            [LOG_EVENT_PILL_NOISE] = "pill_noise",
+            [LOG_EVENT_EMPTY] = "empty",
+            [LOG_EVENT_RECOVERED] = "recovered",
+            [LOG_EVENT_FACTORY_RESET] = "factory_reset",
+            [LOG_EVENT_DISPENSE_ABORTED] = "dispense_aborted",
+            [LOG_EVENT_DISPENSE_INTENT] = "dispense_intent",
+    };
+    if (event >= LOG_EVENT_COUNT || !names[event]) return "unknown";
+    return names[event];
+}
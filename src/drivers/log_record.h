@@ -0,0 +1,51 @@
+//
+// Binary event log records, 12 bytes each. Plain C, shared with tools/log_decode.c.
+//
+
+#ifndef PILLDISPENSER_LOG_RECORD_H
+#define PILLDISPENSER_LOG_RECORD_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// little endian on the wire:
+// sequence(2) event(1) wheel(1) time_delta(2) arg0(2) arg1(2) crc16(2)
+#define LOG_RECORD_SIZE 12
+#define LOG_NO_WHEEL 0xFF // system events that are not about one wheel
+#define LOG_TIME_DELTA_MINUTES 0x8000 // set: the delta is in minutes, else seconds
+
+typedef enum {
+    LOG_EVENT_BOOT = 1, // arg0 = dispensed | period << 8, arg1 = calibrated | motor running << 1
+    LOG_EVENT_BOOT_NEW, // no saved state found
+    LOG_EVENT_CALIBRATED_FAST, // arg0 = steps/rev, arg1 = ms
+    LOG_EVENT_CALIBRATED_ROUNDS, // arg0 = steps/rev, arg1 = ms
+    LOG_EVENT_POSITION_CORRECTED, // arg0 = steps (int16)
+    LOG_EVENT_POSITION_LOST,
+    LOG_EVENT_PILL_OK, // arg0 = dispensed, arg1 = period
+    LOG_EVENT_PILL_DOUBLE,
+    LOG_EVENT_PILL_MISSING,
+    LOG_EVENT_PILL_NOISE,
+    LOG_EVENT_EMPTY,
+    LOG_EVENT_RECOVERED,
+    LOG_EVENT_FACTORY_RESET,
+    LOG_EVENT_DISPENSE_ABORTED, // arg0 = failed rounds
+    LOG_EVENT_DISPENSE_INTENT, // before the wheel turns, arg0 = dispensed, arg1 = target slot (int16)
+    LOG_EVENT_COUNT
+} LogEvent;
+
+typedef struct {
+    uint16_t sequence; // consecutive, wraps at 65536
+    uint8_t event;
+    uint8_t wheel;
+    uint32_t time_delta_s; // since the previous record, the first of a boot since power on
+    uint16_t arg0;
+    uint16_t arg1;
+} LogRecord;
+
+void log_record_encode(const LogRecord *record, uint8_t *out);
+bool log_record_decode(const uint8_t *in, LogRecord *record);
+bool log_record_unpack(const uint8_t *in, LogRecord *record);
+int log_record_format(const LogRecord *record, char *buffer, size_t size);
+const char *log_event_name(uint8_t event);
+
+#endif //PILLDISPENSER_LOG_RECORD_H
@@ -1,42 +1,353 @@
 #include "motor.h"
 #include "pico/stdlib.h"
 #include "hardware/gpio.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/clocks.h"
+#include "stepper.pio.h"
 #include "../config.h"
 
-const bool half_step_sequence[8][4]={
-    {1,0,0,0},
-    {1,1,0,0},
-    {0,1,0,0},
-    {0,1,1,0},
-    {0,0,1,0},
-    {0,0,1,1},
-    {0,0,0,1},
-    {1,0,0,1}
+// coil bits of half-step phase p: coil p/2, plus the next coil on odd phases.
+// wave drive uses the even phases, full drive the odd ones, half drive all of them.
+#define PHASE_COILS(p) (uint8_t)((1u << ((p) / 2)) | (((p) & 1) ? 1u << (((p) / 2 + 1) % 4) : 0u))
+
+static const uint8_t phase_coils[8] = {
+    PHASE_COILS(0), PHASE_COILS(1), PHASE_COILS(2), PHASE_COILS(3),
+    PHASE_COILS(4), PHASE_COILS(5), PHASE_COILS(6), PHASE_COILS(7)
 };
 
+typedef struct {
+    uint8_t stride; // half-steps per step
+    uint8_t phase_offset; // mode lands on phases offset, offset+stride, ...
+    uint16_t start_interval_us;
+    uint16_t cruise_interval_us;
+} DriveModeInfo;
+
+static const DriveModeInfo drive_modes[MOTOR_DRIVE_MODE_COUNT] = {
+    [MOTOR_DRIVE_WAVE] = {2, 0, MOTOR_WAVE_START_INTERVAL_US, MOTOR_WAVE_CRUISE_INTERVAL_US},
+    [MOTOR_DRIVE_FULL] = {2, 1, MOTOR_FULL_START_INTERVAL_US, MOTOR_FULL_CRUISE_INTERVAL_US},
+    [MOTOR_DRIVE_HALF] = {1, 0, MOTOR_HALF_START_INTERVAL_US, MOTOR_HALF_CRUISE_INTERVAL_US},
+};
+
+#define PIO_TICK_HZ 1000000 // one state machine tick per microsecond
+#define PIO_PATTERN_BITS 12
+#define PIO_HOLD_MAX ((1u << (32 - PIO_PATTERN_BITS)) - 1)
+
 // in module scope initialize motor pins, use it directly.
 // and in logic layers no need to declare the instant again.
-const uint motor_pins[4]= MOTOR_PINS;
+static const uint motor_pins[MOTOR_COUNT][4] = {
+    { WHEEL0_MOTOR_PINS },
+#if MOTOR_COUNT > 1
+    { WHEEL1_MOTOR_PINS },
+#endif
+#if MOTOR_COUNT > 2
+    { WHEEL2_MOTOR_PINS },
+#endif
+#if MOTOR_COUNT > 3
+    { WHEEL3_MOTOR_PINS },
+#endif
+};
 
-void set_motor_pins() {
-    for(int i=0;i<4;i++) {
-        gpio_init(motor_pins[i]);
-        gpio_set_dir(motor_pins[i],GPIO_OUT);
-        gpio_put(motor_pins[i],0);
+// a state machine writes the GPIOs from its lowest to its highest motor pin. the output latch
+// of pio0 is shared, so a window must fit the pattern and hold no pin of another wheel.
+#define PIN_LOWER(a, b) ((a) < (b) ? (a) : (b))
+#define PIN_HIGHER(a, b) ((a) > (b) ? (a) : (b))
+#define PINS_LOWEST_(a, b, c, d) PIN_LOWER(PIN_LOWER(a, b), PIN_LOWER(c, d))
+#define PINS_HIGHEST_(a, b, c, d) PIN_HIGHER(PIN_HIGHER(a, b), PIN_HIGHER(c, d))
+#define PINS_LOWEST(...) PINS_LOWEST_(__VA_ARGS__)
+#define PINS_HIGHEST(...) PINS_HIGHEST_(__VA_ARGS__)
+#define WINDOW_LOW(wheel) PINS_LOWEST(WHEEL##wheel##_MOTOR_PINS)
+#define WINDOW_HIGH(wheel) PINS_HIGHEST(WHEEL##wheel##_MOTOR_PINS)
+#define WINDOW_FITS(wheel) (WINDOW_HIGH(wheel) - WINDOW_LOW(wheel) < PIO_PATTERN_BITS)
+#define WINDOWS_APART(a, b) (WINDOW_HIGH(a) < WINDOW_LOW(b) || WINDOW_HIGH(b) < WINDOW_LOW(a))
+
+_Static_assert(MOTOR_COUNT <= 4, "pio0 has 4 state machines, one per wheel");
+_Static_assert(WINDOW_FITS(0), "wheel 0 motor pins span more than 12 GPIOs");
+#if MOTOR_COUNT > 1
+_Static_assert(WINDOW_FITS(1), "wheel 1 motor pins span more than 12 GPIOs");
+_Static_assert(WINDOWS_APART(0, 1), "wheel 0 and 1 motor pin windows overlap");
+#endif
+#if MOTOR_COUNT > 2
+_Static_assert(WINDOW_FITS(2), "wheel 2 motor pins span more than 12 GPIOs");
+_Static_assert(WINDOWS_APART(0, 2), "wheel 0 and 2 motor pin windows overlap");
+_Static_assert(WINDOWS_APART(1, 2), "wheel 1 and 2 motor pin windows overlap");
+#endif
+#if MOTOR_COUNT > 3
+_Static_assert(WINDOW_FITS(3), "wheel 3 motor pins span more than 12 GPIOs");
+_Static_assert(WINDOWS_APART(0, 3), "wheel 0 and 3 motor pin windows overlap");
+_Static_assert(WINDOWS_APART(1, 3), "wheel 1 and 3 motor pin windows overlap");
+_Static_assert(WINDOWS_APART(2, 3), "wheel 2 and 3 motor pin windows overlap");
+#endif
+
+#define DMA_CHUNK_STEPS 256 // refilled from the dma irq, FIFO covers the refill latency
+
+// ramp_intervals[mode][n] is the delay after the n-th step of an acceleration, filled once at init
+static uint16_t ramp_intervals[MOTOR_DRIVE_MODE_COUNT][MOTOR_RAMP_MAX_STEPS];
+static uint32_t ramp_length[MOTOR_DRIVE_MODE_COUNT];
+
+// a job is an optional half-step to reach a phase of its mode, the mode steps,
+// and an optional half-step for an odd remainder.
+typedef struct {
+    MotorDriveMode mode;
+    int direction;
+    uint32_t align_words;
+    uint32_t mode_steps;
+    uint32_t total_words;
+} MotorJob;
+
+// one stepper sequencer per wheel, all of them on pio0 sharing one program and its output latch
+typedef struct {
+    uint sm;
+    uint dma_chan;
+    uint32_t phase_words[8]; // phase_coils as PIO pin masks
+    // coil phase of the last step handed to the sequencer
+    int step_index;
+    MotorDriveMode drive_mode;
+    // current (or last) move job, chunks are fed to the PIO by dma
+    MotorJob job;
+    volatile uint32_t job_words_queued;
+    int32_t position_before_job;
+    uint32_t dma_buffer[DMA_CHUNK_STEPS];
+} Motor;
+
+static PIO motor_pio = pio0;
+static uint motor_pio_offset;
+static Motor motors[MOTOR_COUNT];
+
+static uint32_t isqrt(uint32_t value) {
+    uint32_t root = 0;
+    uint32_t bit = 1u << 30;
+    while (bit > value) bit >>= 2;
+    while (bit != 0) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
     }
+    return root;
 }
 
-void motor_move_one_step(int direction) {
-    static int step_index = 0;
-    step_index=(step_index+direction + 8) % 8;
-    for(int i=0;i<4;i++) {
-        gpio_put(motor_pins[i],half_step_sequence[step_index][i]);
+// constant acceleration: v(n)^2 = v0^2 + 2*a*n, interval = 1/v(n)
+static void build_ramp_tables() {
+    for (int mode = 0; mode < MOTOR_DRIVE_MODE_COUNT; mode++) {
+        const DriveModeInfo *m = &drive_modes[mode];
+        uint32_t v0 = 1000000u / m->start_interval_us;
+        uint32_t length = 0;
+        while (length < MOTOR_RAMP_MAX_STEPS) {
+            uint32_t v = isqrt(v0 * v0 + 2u * MOTOR_ACCELERATION * length);
+            uint32_t interval = 1000000u / v;
+            if (interval <= m->cruise_interval_us) break;
+            ramp_intervals[mode][length++] = (uint16_t)interval;
+        }
+        ramp_length[mode] = length;
     }
-    sleep_ms(STEP_DELAY_MS);
 }
 
-void motor_stop() {
+static uint32_t word_advance(const MotorJob *job, uint32_t word) {
+    if (word < job->align_words || word >= job->align_words + job->mode_steps) return 1;
+    return drive_modes[job->mode].stride;
+}
+
+// half-steps covered by the first `words` words of the job
+static uint32_t half_steps_of_words(const MotorJob *job, uint32_t words) {
+    if (words <= job->align_words) return words;
+    uint32_t body = words - job->align_words;
+    uint32_t stride = drive_modes[job->mode].stride;
+    if (body <= job->mode_steps) return job->align_words + body * stride;
+    return job->align_words + job->mode_steps * stride + (body - job->mode_steps);
+}
+
+static uint32_t step_word(Motor *m, uint32_t advance, int direction, uint32_t hold_us) {
+    m->step_index=(m->step_index + direction * (int)advance + 8) % 8;
+    uint32_t hold = hold_us > stepper_WORD_OVERHEAD ? hold_us - stepper_WORD_OVERHEAD : 0;
+    if (hold > PIO_HOLD_MAX) hold = PIO_HOLD_MAX;
+    return m->phase_words[m->step_index] | (hold << PIO_PATTERN_BITS);
+}
+
+static void start_next_chunk(Motor *m) {
+    const MotorJob *job = &m->job;
+    uint32_t first = m->job_words_queued;
+    uint32_t count = job->total_words - first;
+    if (count > DMA_CHUNK_STEPS) count = DMA_CHUNK_STEPS;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t word = first + i;
+        // let the last step settle at start speed before anyone releases the coils
+        uint32_t hold = word + 1 < job->total_words ? motor_profile_interval_us(job->mode, word, job->total_words)
+                                                    : drive_modes[job->mode].start_interval_us;
+        m->dma_buffer[i] = step_word(m, word_advance(job, word), job->direction, hold);
+    }
+    m->job_words_queued = first + count;
+    dma_channel_transfer_from_buffer_now(m->dma_chan, m->dma_buffer, count);
+}
+
+static void motor_dma_irq_handler() {
+    for (uint i = 0; i < MOTOR_COUNT; i++) {
+        Motor *m = &motors[i];
+        if (!dma_channel_get_irq0_status(m->dma_chan)) continue;
+        dma_channel_acknowledge_irq0(m->dma_chan);
+        if (m->job_words_queued < m->job.total_words) {
+            start_next_chunk(m);
+        }
+    }
+}
+
+static void wait_until_idle(uint motor) {
+    while (motor_is_busy(motor)) {
+        tight_loop_contents();
+    }
+}
+
+// the previous job is finished, fold it into the absolute position and plan the next one
+static void begin_job(uint motor, MotorDriveMode mode, uint32_t half_steps, int direction) {
+    wait_until_idle(motor);
+    Motor *m = &motors[motor];
+    MotorJob *job = &m->job;
+    m->position_before_job += job->direction * (int32_t)half_steps_of_words(job, job->total_words);
+
+    const DriveModeInfo *info = &drive_modes[mode];
+    job->mode = mode;
+    job->direction = direction;
+    job->align_words = 0;
+    if (half_steps > 0 && (m->step_index + 8 - info->phase_offset) % info->stride != 0) {
+        job->align_words = 1;
+    }
+    uint32_t remaining = half_steps - job->align_words;
+    job->mode_steps = remaining / info->stride;
+    job->total_words = job->align_words + job->mode_steps + remaining % info->stride;
+    m->job_words_queued = 0;
+}
+
+static void init_motor(uint motor) {
+    Motor *m = &motors[motor];
+    const uint *pins = motor_pins[motor];
+    uint pin_base = pins[0];
+    uint pin_top = pins[0];
+    for(int i=1;i<4;i++) {
+        if (pins[i] < pin_base) pin_base = pins[i];
+        if (pins[i] > pin_top) pin_top = pins[i];
+    }
+    uint32_t pin_mask = 0;
     for(int i=0;i<4;i++) {
-        gpio_put(motor_pins[i],0);
+        pin_mask |= 1u << pins[i];
+        pio_gpio_init(motor_pio, pins[i]);
+    }
+    for (int p = 0; p < 8; p++) {
+        m->phase_words[p] = 0;
+        for(int i=0;i<4;i++) {
+            if (phase_coils[p] & (1u << i)) m->phase_words[p] |= 1u << (pins[i] - pin_base);
+        }
+    }
+    m->step_index = 0;
+    m->drive_mode = MOTOR_DRIVE_HALF;
+    m->job = (MotorJob){MOTOR_DRIVE_HALF, 1, 0, 0, 0};
+    m->job_words_queued = 0;
+    m->position_before_job = 0;
+
+    m->sm = (uint)pio_claim_unused_sm(motor_pio, true);
+    pio_sm_config c = stepper_program_get_default_config(motor_pio_offset);
+    // out pins,12 and mov pins,null write only the wheel's own window, the pattern bits above it are dropped
+    sm_config_set_out_pins(&c, pin_base, pin_top - pin_base + 1);
+    sm_config_set_out_shift(&c, true, false, 32);
+    sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_TX);
+    sm_config_set_clkdiv_int_frac(&c, clock_get_hz(clk_sys) / PIO_TICK_HZ, 0);
+    pio_sm_set_pins_with_mask(motor_pio, m->sm, 0, pin_mask);
+    pio_sm_set_pindirs_with_mask(motor_pio, m->sm, pin_mask, pin_mask);
+    pio_sm_init(motor_pio, m->sm, motor_pio_offset, &c);
+    pio_sm_set_enabled(motor_pio, m->sm, true);
+
+    m->dma_chan = (uint)dma_claim_unused_channel(true);
+    dma_channel_config dc = dma_channel_get_default_config(m->dma_chan);
+    channel_config_set_transfer_data_size(&dc, DMA_SIZE_32);
+    channel_config_set_read_increment(&dc, true);
+    channel_config_set_write_increment(&dc, false);
+    channel_config_set_dreq(&dc, pio_get_dreq(motor_pio, m->sm, true));
+    dma_channel_configure(m->dma_chan, &dc, &motor_pio->txf[m->sm], m->dma_buffer, 0, false);
+    dma_channel_set_irq0_enabled(m->dma_chan, true);
+}
+
+void set_motor_pins() {
+    motor_pio_offset = pio_add_program(motor_pio, &stepper_program);
+    for (uint i = 0; i < MOTOR_COUNT; i++) {
+        init_motor(i);
     }
-}
\ No newline at end of file
+    irq_add_shared_handler(DMA_IRQ_0, motor_dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
+
+    build_ramp_tables();
+}
+
+void motor_move_one_step(uint motor, int direction) {
+    begin_job(motor, MOTOR_DRIVE_HALF, 1, direction);
+    Motor *m = &motors[motor];
+    m->job_words_queued = 1;
+    pio_sm_put_blocking(motor_pio, m->sm, step_word(m, 1, direction, STEP_DELAY_MS * 1000));
+    wait_until_idle(motor);
+}
+
+void motor_stop(uint motor) {
+    wait_until_idle(motor);
+    pio_sm_exec(motor_pio, motors[motor].sm, pio_encode_mov(pio_pins, pio_null));
+}
+
+// takes effect with the next motor_move_async()
+void motor_set_drive_mode(uint motor, MotorDriveMode mode) {
+    if (mode < MOTOR_DRIVE_MODE_COUNT) motors[motor].drive_mode = mode;
+}
+
+// delay between step `step` and step `step+1` of a move with total_steps steps.
+// accelerate from the start, mirror the ramp at the end, cruise in between.
+uint32_t motor_profile_interval_us(MotorDriveMode mode, uint32_t step, uint32_t total_steps) {
+    if (total_steps < 2 || step + 1 >= total_steps) return 0;
+    uint32_t from_end = total_steps - 2 - step;
+    uint32_t ramp_pos = step < from_end ? step : from_end;
+    if (ramp_pos >= ramp_length[mode]) return drive_modes[mode].cruise_interval_us;
+    return ramp_intervals[mode][ramp_pos];
+}
+
+// start a move of half_steps in the current drive mode and return immediately.
+// step timing is done by the PIO, the CPU only refills a dma chunk every DMA_CHUNK_STEPS steps.
+void motor_move_async(uint motor, uint32_t half_steps, int direction) {
+    Motor *m = &motors[motor];
+    begin_job(motor, m->drive_mode, half_steps, direction);
+    if (m->job.total_words == 0) return;
+    uint32_t irq = save_and_disable_interrupts();
+    start_next_chunk(m);
+    restore_interrupts(irq);
+}
+
+// idle once every word is pushed, the FIFO is drained and the last hold has run out
+bool motor_is_busy(uint motor) {
+    const Motor *m = &motors[motor];
+    if (m->job_words_queued < m->job.total_words || dma_channel_is_busy(m->dma_chan)) return true;
+    if (!pio_sm_is_tx_fifo_empty(motor_pio, m->sm)) return true;
+    return pio_sm_get_pc(motor_pio, m->sm) != motor_pio_offset + stepper_wrap_target;
+}
+
+// half-steps of the current job whose pattern is already on the pins
+uint32_t motor_get_steps_done(uint motor) {
+    const Motor *m = &motors[motor];
+    uint32_t irq = save_and_disable_interrupts();
+    uint32_t pushed = m->job_words_queued - dma_channel_hw_addr(m->dma_chan)->transfer_count;
+    uint32_t waiting = pio_sm_get_tx_fifo_level(motor_pio, m->sm);
+    restore_interrupts(irq);
+    return half_steps_of_words(&m->job, pushed - waiting);
+}
+
+// absolute half-step position since boot, counted in the rotating direction
+int32_t motor_get_position(uint motor) {
+    const Motor *m = &motors[motor];
+    return m->position_before_job + m->job.direction * (int32_t)motor_get_steps_done(motor);
+}
+
+// coil phase 0-7 of the last step, journaled so a reboot continues the sequence
+uint8_t motor_get_phase(uint motor) {
+    return (uint8_t)motors[motor].step_index;
+}
+
+void motor_set_phase(uint motor, uint8_t phase) {
+    wait_until_idle(motor);
+    motors[motor].step_index = phase % 8;
+}
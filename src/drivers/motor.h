@@ -4,11 +4,46 @@
 
 #ifndef PILLDISPENSER_MOTOR_H
 #define PILLDISPENSER_MOTOR_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "pico/types.h"
+#include "../config.h"
 
 #define STEP_DELAY_MS 3
 
+// all distances and positions are counted in half-steps, whatever the drive mode.
+typedef enum {
+    MOTOR_DRIVE_WAVE, // one coil at a time, full steps, least current
+    MOTOR_DRIVE_FULL, // two coils at a time, full steps, most torque and speed
+    MOTOR_DRIVE_HALF, // alternating one/two coils, finest positioning
+    MOTOR_DRIVE_MODE_COUNT
+} MotorDriveMode;
+
+// trapezoidal profile for background moves, intervals are per step of the mode.
+// start (and stop) slow enough to pull in, accelerate up to cruise speed.
+#define MOTOR_HALF_START_INTERVAL_US (STEP_DELAY_MS * 1000)
+#define MOTOR_HALF_CRUISE_INTERVAL_US 1200
+#define MOTOR_FULL_START_INTERVAL_US 4000
+#define MOTOR_FULL_CRUISE_INTERVAL_US 2000
+#define MOTOR_WAVE_START_INTERVAL_US 4000
+#define MOTOR_WAVE_CRUISE_INTERVAL_US 2400
+#define MOTOR_ACCELERATION 4000 // steps/s^2
+#define MOTOR_RAMP_MAX_STEPS 128 // size of the ramp table, must cover start->cruise
+
+// one motor per wheel, motor N turns wheel N
+#define MOTOR_COUNT WHEEL_COUNT
+
 void set_motor_pins();
-void motor_move_one_step(int direction);
-void motor_stop();
+void motor_move_one_step(uint motor, int direction); // always one half-step
+void motor_stop(uint motor);
+
+void motor_set_drive_mode(uint motor, MotorDriveMode mode);
+void motor_move_async(uint motor, uint32_t half_steps, int direction);
+bool motor_is_busy(uint motor);
+uint32_t motor_get_steps_done(uint motor);
+int32_t motor_get_position(uint motor);
+uint8_t motor_get_phase(uint motor);
+void motor_set_phase(uint motor, uint8_t phase);
+uint32_t motor_profile_interval_us(MotorDriveMode mode, uint32_t step, uint32_t total_steps);
 
-#endif //PILLDISPENSER_MOTOR_H
\ No newline at end of file
+#endif //PILLDISPENSER_MOTOR_H
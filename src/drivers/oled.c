@@ -7,26 +7,35 @@
 #include <stdio.h>
 #include <string.h>
 #include "pico/stdlib.h"
-#include "hardware/i2c.h"
+#include "i2c_hal.h"
+#include "oled_dma.h"
+#include "font.h"
 
-#define MAX_PAGE 8
+// what the panel should show, the drawing calls only change this. oled_commit() queues the
+// columns that changed since the last frame, one write per page, and dma sends them.
+static uint8_t framebuffer[OLED_PAGES][OLED_WIDTH];
+static uint8_t dirty_first[OLED_PAGES];
+static uint8_t dirty_end[OLED_PAGES]; // one past the last dirty column, 0 when the page is clean
+// the glyph in each 8x16 text cell, 0 when unknown. text at a cell position that
+// already shows the same glyph is not drawn again.
+static char text_cells[OLED_TEXT_ROWS][OLED_TEXT_COLS];
+static bool is_frame_pending = false;
+static uint32_t frame_start_us = 0;
+static OledStats stats;
 
 void oled_init(void) {
-    i2c_init(OLED_I2C_PORT, 400 * 1000); // 400kHz
-    gpio_set_function(OLED_SDA_GPIO, GPIO_FUNC_I2C);
-    gpio_set_function(OLED_SCL_GPIO, GPIO_FUNC_I2C);
-    gpio_pull_up(OLED_SDA_GPIO);
-    gpio_pull_up(OLED_SCL_GPIO);
+    i2c_hal_init(OLED_I2C_BUS, OLED_I2C_BAUDRATE, OLED_SDA_GPIO, OLED_SCL_GPIO);
+    oled_dma_init();
 }
 
 void oled_send_cmd(uint8_t cmd) {
     uint8_t buf[2] = {0x00, cmd};
-    i2c_write_blocking(OLED_I2C_PORT, OLED_ADDR, buf, 2, false);
+    i2c_hal_write(OLED_I2C_BUS, OLED_ADDR, buf, 2, false);
 }
 
 void oled_send_data(uint8_t data) {
     uint8_t buf[2] = {0x40, data};
-    i2c_write_blocking(OLED_I2C_PORT, OLED_ADDR, buf, 2, false);
+    i2c_hal_write(OLED_I2C_BUS, OLED_ADDR, buf, 2, false);
 }
 
 // SSD1306 datasheet P37 command table
@@ -42,18 +51,107 @@ void oled_init_minimal() {
     oled_send_cmd(0xAF);// Power on
 }
 
+static void mark_dirty(uint8_t page, uint8_t first, uint8_t end) {
+    if (dirty_end[page] == 0) {
+        dirty_first[page] = first;
+        dirty_end[page] = end;
+        return;
+    }
+    if (first < dirty_first[page]) dirty_first[page] = first;
+    if (end > dirty_end[page]) dirty_end[page] = end;
+}
+
+// columns that already show these bytes stay clean
+static void draw_columns(uint8_t x, uint8_t page, const uint8_t *columns, uint8_t count) {
+    if (page >= OLED_PAGES || x >= OLED_WIDTH) return;
+    if (count > OLED_WIDTH - x) count = OLED_WIDTH - x;
+    uint8_t *row = &framebuffer[page][x];
+    for (uint8_t i = 0; i < count; i++) {
+        if (row[i] == columns[i]) continue;
+        row[i] = columns[i];
+        mark_dirty(page, x + i, x + i + 1);
+    }
+}
 
 void oled_clear() {
-    oled_send_cmd(0x21); // set column address
-    oled_send_cmd(0); // from column 0
-    oled_send_cmd(127); // to colum 127
-    oled_send_cmd(0x22); // set page address
-    oled_send_cmd(0); //from page 0 (8 pixels)
-    oled_send_cmd(7); //to page 7
-
-    for (int i = 0; i < 128 * 8; i++) {
-        oled_send_data(0x00);
+    memset(text_cells, ' ', sizeof(text_cells));
+    for (uint8_t page = 0; page < OLED_PAGES; page++) {
+        for (uint8_t x = 0; x < OLED_WIDTH; x++) {
+            if (framebuffer[page][x] == 0) continue;
+            framebuffer[page][x] = 0;
+            mark_dirty(page, x, x + 1);
+        }
+    }
+}
+
+// the whole panel on the next flush, e.g. after oled_init_minimal() when GDDRAM holds noise
+void oled_invalidate() {
+    for (uint8_t page = 0; page < OLED_PAGES; page++) {
+        mark_dirty(page, 0, OLED_WIDTH);
+    }
+}
+
+bool oled_is_frame_in_flight() {
+    if (!is_frame_pending || oled_dma_is_busy()) return is_frame_pending;
+    is_frame_pending = false;
+    uint32_t frame_us = time_us_32() - frame_start_us;
+    if (frame_us > stats.max_frame_us) stats.max_frame_us = frame_us;
+    return false;
+}
+
+// a column and page window, then all its bytes in one data stream (control byte 0x40).
+// never waits: while the last frame is still on the bus the changes go with the next one.
+bool oled_commit() {
+    if (oled_is_frame_in_flight()) {
+        stats.busy_commits++;
+        return false;
+    }
+    uint32_t bytes = 0;
+    uint32_t start_us = time_us_32();
+    oled_dma_begin_frame();
+    for (uint8_t page = 0; page < OLED_PAGES; page++) {
+        if (dirty_end[page] == 0) continue;
+        uint8_t first = dirty_first[page];
+        uint8_t count = dirty_end[page] - first;
+        uint8_t window[] = {0x00, 0x21, first, dirty_end[page] - 1, 0x22, page, page};
+        oled_dma_add_write(window, sizeof(window));
+        uint8_t data[1 + OLED_WIDTH];
+        data[0] = 0x40;
+        memcpy(&data[1], &framebuffer[page][first], count);
+        oled_dma_add_write(data, 1 + count);
+        bytes += 1 + sizeof(window) + 1 + 1 + count; // with the address bytes
+        dirty_end[page] = 0;
+    }
+    if (bytes == 0) return true;
+    frame_start_us = start_us;
+    is_frame_pending = true;
+    oled_dma_start_frame();
+    stats.frames++;
+    stats.last_frame_bytes = bytes;
+    stats.total_bytes += bytes;
+    if (bytes > stats.max_frame_bytes) stats.max_frame_bytes = bytes;
+    return true;
+}
+
+// before a blocking wait: the frame drawn so far is on its way when this returns
+void oled_flush() {
+    while (oled_is_frame_in_flight()) {
+        tight_loop_contents();
     }
+    oled_commit();
+}
+
+const OledStats *oled_get_stats() {
+    return &stats;
+}
+
+void oled_report() {
+    printf("[OLED] %lu frames, %lu I2C bytes, %lu last, %lu max per frame, %lu glyphs drawn\n",
+           (unsigned long)stats.frames, (unsigned long)stats.total_bytes, (unsigned long)stats.last_frame_bytes,
+           (unsigned long)stats.max_frame_bytes, (unsigned long)stats.glyph_draws);
+    printf("[OLED] frame max %lu us on the bus, %lu commits while busy, %lu not ACKed\n",
+           (unsigned long)stats.max_frame_us, (unsigned long)stats.busy_commits,
+           (unsigned long)oled_dma_abort_count());
 }
 
 //ssd1306 128*64 oled; x [0,127], y [0-7]; every 8 pixel per page;
@@ -63,23 +161,38 @@ void oled_set_position(uint8_t x, uint8_t y) {
     oled_send_cmd(x & 0x0f);
 }
 
+// text off the cell grid or in another font covers cells partly, they have to be drawn again
+static void forget_cells(uint8_t x, uint8_t y, uint8_t width, uint8_t pages) {
+    for (uint8_t row = y / 2; row <= (y + pages - 1) / 2 && row < OLED_TEXT_ROWS; row++) {
+        for (uint8_t col = x / 8; col <= (x + width - 1) / 8 && col < OLED_TEXT_COLS; col++) {
+            text_cells[row][col] = 0;
+        }
+    }
+}
+
+static void draw_glyph(uint8_t x, uint8_t y, const Font *font, char chr) {
+    uint8_t buffer[FONT_MAX_GLYPH_BYTES];
+    const uint8_t *glyph = font_glyph(font, chr, buffer);
+    stats.glyph_draws++;
+    for (uint8_t page = 0; page < font->pages; page++) {
+        draw_columns(x, y + page, &glyph[page * font->width], font->width);
+    }
+}
+
 void oled_show_char(uint8_t x, uint8_t y, char chr) {
-    uint8_t c = 0;
-    uint8_t i = 0;
-    c = chr - ' ';
     if (x>120) {
         x=0;
         y++;
     }
 
-    oled_set_position(x, y);
-    for (i=0;i<MAX_PAGE;i++) {
-        oled_send_data(F8X16[c * 16 + i]);
-    }
-    oled_set_position(x, y+1);
-    for (i=0;i<MAX_PAGE;i++) {
-        oled_send_data(F8X16[c * 16 + i+8]);
+    if (x % 8 == 0 && y % 2 == 0 && y < OLED_PAGES) {
+        char *cell = &text_cells[y / 2][x / 8];
+        if (*cell == chr) return;
+        *cell = chr;
+    } else {
+        forget_cells(x, y, font_8x16.width, font_8x16.pages);
     }
+    draw_glyph(x, y, &font_8x16, chr);
 }
 
 void oled_show_string(uint8_t x, uint8_t y, const char *str) {
@@ -88,4 +201,14 @@ void oled_show_string(uint8_t x, uint8_t y, const char *str) {
         x+=8;
         str++;
     }
-}
\ No newline at end of file
+}
+
+void oled_show_big_string(uint8_t x, uint8_t y, const char *str) {
+    // the framebuffer diff keeps the digits that did not change off the bus
+    while (*str != '\0' && x < OLED_WIDTH) {
+        forget_cells(x, y, font_16x32_digits.width, font_16x32_digits.pages);
+        draw_glyph(x, y, &font_16x32_digits, *str);
+        x += font_16x32_digits.width;
+        str++;
+    }
+}
@@ -0,0 +1,62 @@
+#include "oled_dma.h"
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/i2c.h"
+#include "config.h"
+
+// controller command words, the data byte and a STOP on the last byte of every write.
+// after a STOP the controller starts the next write by itself while the fifo holds more.
+static uint16_t dma_commands[OLED_FRAME_MAX_BYTES];
+static uint32_t command_count = 0;
+static uint oled_dma_chan;
+static uint32_t aborts = 0;
+
+void oled_dma_init(void) {
+    i2c_hw_t *hw = i2c_get_hw(OLED_I2C_PORT);
+    oled_dma_chan = (uint)dma_claim_unused_channel(true);
+    dma_channel_config dc = dma_channel_get_default_config(oled_dma_chan);
+    channel_config_set_transfer_data_size(&dc, DMA_SIZE_16);
+    channel_config_set_read_increment(&dc, true);
+    channel_config_set_write_increment(&dc, false);
+    channel_config_set_dreq(&dc, i2c_get_dreq(OLED_I2C_PORT, true));
+    dma_channel_configure(oled_dma_chan, &dc, &hw->data_cmd, dma_commands, 0, false);
+}
+
+void oled_dma_begin_frame(void) {
+    command_count = 0;
+}
+
+void oled_dma_add_write(const uint8_t *bytes, size_t length) {
+    if (length == 0 || command_count + length > OLED_FRAME_MAX_BYTES) return;
+    for (size_t i = 0; i < length; i++) {
+        dma_commands[command_count++] = bytes[i];
+    }
+    dma_commands[command_count - 1] |= I2C_IC_DATA_CMD_STOP_BITS;
+}
+
+void oled_dma_start_frame(void) {
+    if (command_count == 0) return;
+    i2c_hw_t *hw = i2c_get_hw(OLED_I2C_PORT);
+    // the blocking init commands may have left another target or a stale abort
+    hw->enable = 0;
+    hw->tar = OLED_ADDR;
+    hw->enable = 1;
+    (void)hw->clr_tx_abrt;
+    dma_channel_transfer_from_buffer_now(oled_dma_chan, dma_commands, command_count);
+}
+
+// busy until the dma is done and the controller has sent the last STOP
+bool oled_dma_is_busy(void) {
+    i2c_hw_t *hw = i2c_get_hw(OLED_I2C_PORT);
+    if (hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+        // no ACK, the controller flushed its fifo. the rest of the frame is dropped.
+        dma_channel_abort(oled_dma_chan);
+        (void)hw->clr_tx_abrt;
+        aborts++;
+    }
+    return dma_channel_is_busy(oled_dma_chan) || hw->txflr > 0 || (hw->status & I2C_IC_STATUS_ACTIVITY_BITS);
+}
+
+uint32_t oled_dma_abort_count(void) {
+    return aborts;
+}
@@ -0,0 +1,23 @@
+//
+// Background OLED frames: the I2C writes of a frame go out as one DMA transfer into the
+// controller's command register, the CPU only queues them.
+//
+
+#ifndef PILLDISPENSER_OLED_DMA_H
+#define PILLDISPENSER_OLED_DMA_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// all 8 pages changed: a 7 byte window write and a 129 byte data write each
+#define OLED_FRAME_MAX_BYTES (8 * (7 + 1 + 128))
+
+void oled_dma_init(void);
+void oled_dma_begin_frame(void);
+// one write to the panel, STOP after its last byte. bytes past OLED_FRAME_MAX_BYTES are dropped.
+void oled_dma_add_write(const uint8_t *bytes, size_t length);
+void oled_dma_start_frame(void);
+bool oled_dma_is_busy(void);
+uint32_t oled_dma_abort_count(void); // frames the panel did not ACK
+
+#endif //PILLDISPENSER_OLED_DMA_H
@@ -0,0 +1,119 @@
+#include "piezo_capture.h"
+#include "../config.h"
+#include "pico/stdlib.h"
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+
+#define ADC_CLOCK_HZ 48000000u
+#define CAPTURE_TRANSFERS 0xFFFFFFFFu // runs until stopped, the ring keeps the newest samples
+
+// the dma ring wrap needs the buffer aligned to its size
+static uint16_t ring[PIEZO_CAPTURE_RING_SAMPLES] __attribute__((aligned(1u << PIEZO_CAPTURE_RING_BITS)));
+static uint capture_dma_chan;
+
+// channels of the last capture, sampled round robin in ascending order
+static uint32_t capture_channel_mask = 0;
+static uint32_t capture_channels = 0;
+static uint32_t samples_written = 0;
+static uint64_t stop_us = 0;
+static bool is_capturing = false;
+
+bool piezo_capture_is_adc_pin(uint gpio) {
+    return gpio >= PIEZO_ADC_FIRST_GPIO && gpio < PIEZO_ADC_FIRST_GPIO + 4;
+}
+
+// position of a pin's channel in the round robin interleave, -1 if it was not captured
+static int channel_slot(uint gpio) {
+    if (!piezo_capture_is_adc_pin(gpio)) return -1;
+    uint channel = gpio - PIEZO_ADC_FIRST_GPIO;
+    if (!(capture_channel_mask & (1u << channel))) return -1;
+    int slot = 0;
+    for (uint i = 0; i < channel; i++) {
+        if (capture_channel_mask & (1u << i)) slot++;
+    }
+    return slot;
+}
+
+void piezo_capture_init() {
+    adc_init();
+    const uint piezo_pins[WHEEL_COUNT] = WHEEL_PIEZO_PINS;
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+        if (!piezo_capture_is_adc_pin(piezo_pins[i])) continue;
+        // also disables the pulls, sensor.c leaves them off on these pins
+        adc_gpio_init(piezo_pins[i]);
+        // adc_gpio_init turns the digital input off, the edge irq still needs it
+        gpio_set_input_enabled(piezo_pins[i], true);
+    }
+
+    capture_dma_chan = (uint)dma_claim_unused_channel(true);
+    dma_channel_config dc = dma_channel_get_default_config(capture_dma_chan);
+    channel_config_set_transfer_data_size(&dc, DMA_SIZE_16);
+    channel_config_set_read_increment(&dc, false);
+    channel_config_set_write_increment(&dc, true);
+    channel_config_set_ring(&dc, true, PIEZO_CAPTURE_RING_BITS);
+    channel_config_set_dreq(&dc, DREQ_ADC);
+    dma_channel_configure(capture_dma_chan, &dc, ring, &adc_hw->fifo, 0, false);
+}
+
+// start sampling every ADC pin in gpio_mask at PIEZO_CAPTURE_SAMPLE_HZ each, false if none is an ADC pin
+bool piezo_capture_start(uint32_t gpio_mask) {
+    if (is_capturing) piezo_capture_stop();
+    capture_channel_mask = 0;
+    capture_channels = 0;
+    uint first_channel = 0;
+    for (int channel = 3; channel >= 0; channel--) {
+        if (!(gpio_mask & (1u << (PIEZO_ADC_FIRST_GPIO + channel)))) continue;
+        capture_channel_mask |= 1u << channel;
+        capture_channels++;
+        first_channel = (uint)channel;
+    }
+    samples_written = 0;
+    if (capture_channels == 0) return false;
+
+    adc_run(false);
+    adc_fifo_drain();
+    adc_select_input(first_channel);
+    adc_set_round_robin(capture_channel_mask);
+    adc_fifo_setup(true, true, 1, false, false);
+    // divider is 16.8 fixed point, one conversion takes (1 + div) adc clocks
+    uint32_t rate = PIEZO_CAPTURE_SAMPLE_HZ * capture_channels;
+    adc_hw->div = (uint32_t)(((uint64_t)ADC_CLOCK_HZ << 8) / rate) - (1u << 8);
+
+    dma_channel_set_write_addr(capture_dma_chan, ring, false);
+    dma_channel_set_trans_count(capture_dma_chan, CAPTURE_TRANSFERS, true);
+    adc_run(true);
+    is_capturing = true;
+    return true;
+}
+
+void piezo_capture_stop() {
+    if (!is_capturing) return;
+    adc_run(false);
+    stop_us = time_us_64();
+    dma_channel_abort(capture_dma_chan);
+    samples_written = CAPTURE_TRANSFERS - dma_channel_hw_addr(capture_dma_chan)->transfer_count;
+    adc_fifo_drain();
+    adc_set_round_robin(0);
+    is_capturing = false;
+}
+
+// samples of one piezo pin from since_us to the end of the last capture, oldest first
+uint32_t piezo_capture_read(uint gpio, uint64_t since_us, uint16_t *out, uint32_t max_samples) {
+    int slot = channel_slot(gpio);
+    if (slot < 0 || is_capturing) return 0;
+
+    uint32_t available = samples_written < PIEZO_CAPTURE_RING_SAMPLES ? samples_written : PIEZO_CAPTURE_RING_SAMPLES;
+    uint32_t partial = samples_written % capture_channels;
+    uint32_t rounds = available > partial ? (available - partial) / capture_channels : 0;
+    uint32_t back = since_us >= stop_us ? 0
+                  : (uint32_t)((stop_us - since_us) * PIEZO_CAPTURE_SAMPLE_HZ / 1000000u);
+    if (back > rounds) back = rounds;
+    uint32_t wanted = back < max_samples ? back : max_samples;
+
+    uint32_t first = samples_written - partial - back * capture_channels + (uint32_t)slot;
+    for (uint32_t i = 0; i < wanted; i++) {
+        out[i] = ring[(first + i * capture_channels) % PIEZO_CAPTURE_RING_SAMPLES] & 0x0FFF;
+    }
+    return wanted;
+}
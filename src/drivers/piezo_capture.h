@@ -0,0 +1,21 @@
+//
+// DMA-fed ADC capture of the piezo during the pill-drop window.
+//
+
+#ifndef PILLDISPENSER_PIEZO_CAPTURE_H
+#define PILLDISPENSER_PIEZO_CAPTURE_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "pico/types.h"
+
+#define PIEZO_CAPTURE_RING_BITS 12 // ring of 2^12 bytes, the dma wraps the write address
+#define PIEZO_CAPTURE_RING_SAMPLES ((1u << PIEZO_CAPTURE_RING_BITS) / sizeof(uint16_t))
+#define PIEZO_ADC_FIRST_GPIO 26 // GP26-29 are ADC0-3
+
+void piezo_capture_init();
+bool piezo_capture_is_adc_pin(uint gpio);
+bool piezo_capture_start(uint32_t gpio_mask);
+void piezo_capture_stop();
+uint32_t piezo_capture_read(uint gpio, uint64_t since_us, uint16_t *out, uint32_t max_samples);
+
+#endif //PILLDISPENSER_PIEZO_CAPTURE_H
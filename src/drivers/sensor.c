@@ -1,41 +1,105 @@
 #include "sensor.h"
 #include "../config.h"
 #include "hardware/gpio.h"
+#include "pico/time.h"
+#include "motor.h"
+#include "piezo_capture.h"
 
-static volatile bool pill_detected = false;
+// one opto fork per wheel, wheels may share a piezo when they drop into the same chute
+static const uint opto_pins[WHEEL_COUNT] = WHEEL_OPTO_PINS;
+static const uint piezo_pins[WHEEL_COUNT] = WHEEL_PIEZO_PINS;
+
+// a drop window is armed before the wheel moves and opens once the motor passes open_position,
+// edges before that are the wheel rattling. the first edge inside is stamped with time and step.
+typedef struct {
+    volatile bool is_armed;
+    volatile bool pill_detected;
+    int32_t open_position;
+    int direction;
+    volatile uint64_t edge_us;
+    volatile int32_t edge_position;
+} DropWindow;
+
+static DropWindow drop_windows[WHEEL_COUNT];
 
 void piezo_irq_handler(uint gpio,uint32_t events) {
-    if (gpio==PIEZO_SENSOR_PIN) {
-        pill_detected = true;
+    uint64_t now_us = time_us_64();
+    for (uint i = 0; i < WHEEL_COUNT; i++) {
+        DropWindow *window = &drop_windows[i];
+        if (gpio!=piezo_pins[i] || !window->is_armed || window->pill_detected) continue;
+        int32_t position = motor_get_position(i);
+        if ((position - window->open_position) * window->direction < 0) continue;
+        window->edge_us = now_us;
+        window->edge_position = position;
+        window->pill_detected = true;
     }
 }
 
 // Opto fork Reads zero when the opening is at the sensor.
-int opto_fork_sensor_read() {
-    return gpio_get(OPTO_SENSOR_PIN);
+int opto_fork_sensor_read(uint wheel) {
+    return gpio_get(opto_pins[wheel]);
+}
+
+uint sensor_get_opto_pin(uint wheel) {
+    return opto_pins[wheel];
+}
+
+uint sensor_get_piezo_pin(uint wheel) {
+    return piezo_pins[wheel];
 }
 
 void sensor_init() {
-    gpio_init(OPTO_SENSOR_PIN);
-    gpio_set_dir(OPTO_SENSOR_PIN,GPIO_IN);
-    gpio_pull_up(OPTO_SENSOR_PIN);
+    for (uint i = 0; i < WHEEL_COUNT; i++) {
+        gpio_init(opto_pins[i]);
+        gpio_set_dir(opto_pins[i],GPIO_IN);
+        gpio_pull_up(opto_pins[i]);
+        // both edges, the position observer timestamps them with the motor step count
+        gpio_set_irq_enabled(
+            opto_pins[i],
+            GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE,
+            true);
 
-    gpio_init(PIEZO_SENSOR_PIN);
-    gpio_set_dir(PIEZO_SENSOR_PIN,GPIO_IN);
-    gpio_pull_up(PIEZO_SENSOR_PIN);
+        gpio_init(piezo_pins[i]);
+        gpio_set_dir(piezo_pins[i],GPIO_IN);
+        // a pull on an ADC pin would bias the waveform the classifier reads, the piezo drives it
+        if (piezo_capture_is_adc_pin(piezo_pins[i])) {
+            gpio_disable_pulls(piezo_pins[i]);
+        } else {
+            gpio_pull_up(piezo_pins[i]);
+        }
+
+        gpio_set_irq_enabled(
+            piezo_pins[i],
+            GPIO_IRQ_EDGE_FALL,
+            true);
+    }
+    piezo_capture_init();
+}
+
+void sensor_arm_drop_window(uint wheel, int32_t open_position, int direction) {
+    DropWindow *window = &drop_windows[wheel];
+    window->is_armed = false;
+    window->pill_detected = false;
+    window->open_position = open_position;
+    window->direction = direction;
+    window->is_armed = true;
+}
 
-    gpio_set_irq_enabled(
-        PIEZO_SENSOR_PIN,
-        GPIO_IRQ_EDGE_FALL,
-        true);
+void sensor_disarm_drop_window(uint wheel) {
+    drop_windows[wheel].is_armed = false;
 }
 
-void sensor_reset_pill_detected() {
-    pill_detected = false;
+bool sensor_get_pill_detected(uint wheel) {
+    return drop_windows[wheel].pill_detected;
 }
 
-bool sensor_get_pill_detected() {
-    return pill_detected;
+// time and motor position of the piezo edge that counted as the pill
+bool sensor_get_drop_edge(uint wheel, uint64_t *edge_us, int32_t *edge_position) {
+    const DropWindow *window = &drop_windows[wheel];
+    if (!window->pill_detected) return false;
+    *edge_us = window->edge_us;
+    *edge_position = window->edge_position;
+    return true;
 }
 
 
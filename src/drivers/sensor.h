@@ -5,12 +5,17 @@
 #ifndef PILLDISPENSER_SENSOR_H
 #define PILLDISPENSER_SENSOR_H
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "pico/types.h"
 
 void sensor_init();
-void sensor_reset_pill_detected();
-bool sensor_get_pill_detected();
-int opto_fork_sensor_read();
+void sensor_arm_drop_window(uint wheel, int32_t open_position, int direction);
+void sensor_disarm_drop_window(uint wheel);
+bool sensor_get_pill_detected(uint wheel);
+bool sensor_get_drop_edge(uint wheel, uint64_t *edge_us, int32_t *edge_position);
+int opto_fork_sensor_read(uint wheel);
+uint sensor_get_opto_pin(uint wheel);
+uint sensor_get_piezo_pin(uint wheel);
 void piezo_irq_handler(uint gpio,uint32_t events);
 #endif //PILLDISPENSER_SENSOR_H
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "dispenser.h"
 #include "statemachine.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include "../config.h"
 #include <string.h>
 #include "lora.h"
@@ -8,124 +9,591 @@
 #include "../drivers/motor.h"
 #include "../drivers/sensor.h"
 #include "../drivers/eeprom.h"
-
-//default values for dispenser state
-static bool is_calibrated = false;
-static float step_per_revolution = 4096.0f;
-static uint8_t pill_dispensed_count = 0;
-static uint8_t pill_treatment_period = 7;
+#include "../drivers/eeprom_writer.h"
+#include "observer.h"
+#include "pill_classifier.h"
+#include "../drivers/piezo_capture.h"
+
+#define WHEEL_BIT(wheel) (1u << (wheel))
+#define ALL_WHEELS (WHEEL_BIT(WHEEL_COUNT) - 1)
+
+// everything the dispenser knows about one wheel, wheel N is turned by motor N
+typedef struct {
+    bool is_calibrated;
+    uint32_t step_per_revolution_q8;
+    uint8_t pill_dispensed_count;
+    uint8_t pill_treatment_period;
+    bool is_turning; // saved as WHEEL_STATE_MOTOR_RUNNING for the power-off protection
+    // compartments the wheel has moved since it was centred at home, home + COMPARTMENTS_PER_WHEEL is home again
+    int32_t wheel_slot;
+    // last wheel journal found at boot, used once by the power-off recovery
+    WheelJournal boot_journal;
+    bool has_boot_journal;
+} Wheel;
+
+static Wheel wheels[WHEEL_COUNT];
 static bool motor_running_at_boot = false;
 
 //helper functions to change states in eeprom
 // and load states from eeprom
-static void state_from_globals(DispenserState *s, uint8_t motor_status) {
+static void state_from_globals(DispenserState *s) {
     memset(s, 0, sizeof(*s));
-    s->step_per_revolution   = step_per_revolution;
-    s->is_calibrated         = is_calibrated;
-    s->pill_dispensed_count  = pill_dispensed_count;
-    s->pill_treatment_period = pill_treatment_period;
-    s->motor_status          = motor_status;
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+        const Wheel *w = &wheels[i];
+        s->wheels[i].step_per_revolution_q8 = w->step_per_revolution_q8;
+        s->wheels[i].pill_dispensed_count   = w->pill_dispensed_count;
+        s->wheels[i].pill_treatment_period  = w->pill_treatment_period;
+        s->wheels[i].flags = (w->is_calibrated ? WHEEL_STATE_CALIBRATED : 0) |
+                             (w->is_turning ? WHEEL_STATE_MOTOR_RUNNING : 0);
+        // a wheel is only saved turning before its dispense move, heading one slot on
+        if (w->is_turning) s->wheels[i].intent_slot = (uint8_t)(w->wheel_slot + 1);
+    }
 }
 static void globals_from_state(const DispenserState *s) {
-    is_calibrated        = s->is_calibrated;
-    step_per_revolution  = s->step_per_revolution;
-    pill_dispensed_count = s->pill_dispensed_count;
-    pill_treatment_period= s->pill_treatment_period;
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+        Wheel *w = &wheels[i];
+        w->is_calibrated          = s->wheels[i].flags & WHEEL_STATE_CALIBRATED;
+        w->step_per_revolution_q8 = s->wheels[i].step_per_revolution_q8;
+        w->pill_dispensed_count   = s->wheels[i].pill_dispensed_count;
+        w->pill_treatment_period  = s->wheels[i].pill_treatment_period;
+    }
+}
+static void save_state() {
+    DispenserState state;
+    state_from_globals(&state);
+    save_dispenser_state_to_eeprom(&state);
+}
+
+// message prefix naming the wheel, empty on a single wheel dispenser so the logs stay as they were
+static void wheel_prefix(char *buffer, uint wheel) {
+    if (WHEEL_COUNT > 1) sprintf(buffer, "W%u ", wheel);
+    else buffer[0] = '\0';
+}
+
+// wheel field of a log record, left out like the prefix on a single wheel machine
+static uint8_t log_wheel(uint wheel) {
+    return WHEEL_COUNT > 1 ? (uint8_t)wheel : LOG_NO_WHEEL;
+}
+
+// whole steps of one revolution, for the observer and the calibration seek limits
+static uint32_t spr_whole_steps(uint wheel) {
+    return (wheels[wheel].step_per_revolution_q8 + (1u << (SPR_Q8_SHIFT - 1))) >> SPR_Q8_SHIFT;
+}
+
+// fractional part in hundredths, for printing without %f
+static uint32_t spr_hundredths(uint wheel) {
+    return ((wheels[wheel].step_per_revolution_q8 & ((1u << SPR_Q8_SHIFT) - 1)) * 100) >> SPR_Q8_SHIFT;
 }
 
 //find falling edge(align with opening)
-void move_to_falling_edge(int direction) {
-    if (opto_fork_sensor_read() == 0) {
-        while (opto_fork_sensor_read() == 0) {
-            motor_move_one_step(direction);
+void move_to_falling_edge(uint wheel, int direction) {
+    if (opto_fork_sensor_read(wheel) == 0) {
+        while (opto_fork_sensor_read(wheel) == 0) {
+            motor_move_one_step(wheel, direction);
             sleep_ms(1);
         }
     }
 
-    while (opto_fork_sensor_read() == 1) {
-        motor_move_one_step(direction);
+    while (opto_fork_sensor_read(wheel) == 1) {
+        motor_move_one_step(wheel, direction);
         sleep_ms(1);
     }
 }
 
 // align exactly to the hole
-static int measure_gap_width(int direction, int max_steps) {
+static int measure_gap_width(uint wheel, int direction, int max_steps) {
     int gap_width = 0;
-    while (opto_fork_sensor_read() == 0 && gap_width < max_steps) {
-        motor_move_one_step(direction);
+    while (opto_fork_sensor_read(wheel) == 0 && gap_width < max_steps) {
+        motor_move_one_step(wheel, direction);
         gap_width++;
         sleep_ms(1);
     }
     return gap_width;
 }
 
-static void move_to_center_from_edge(int direction, int gap_width) {
+static void move_to_center_from_edge(uint wheel, int direction, int gap_width) {
     int steps_to_center = gap_width / 2;
     for (int i = 0; i < steps_to_center; i++) {
-        motor_move_one_step(direction);
+        motor_move_one_step(wheel, direction);
         sleep_ms(1);
     }
 }
 
+// motors turn in the background, keep LoRa and LEDs serviced meanwhile
+static void wait_for_wheels_idle(uint32_t wheel_mask) {
+    for (uint w = 0; w < WHEEL_COUNT; w++) {
+        if (!(wheel_mask & WHEEL_BIT(w))) continue;
+        while (motor_is_busy(w)) {
+            sleep_ms_with_lora(1);
+        }
+    }
+}
+
+static void wait_for_motor_idle(uint wheel) {
+    wait_for_wheels_idle(WHEEL_BIT(wheel));
+}
+
+// travel the bulk of a move in full-step drive, switch to half-step for the final approach.
+// positions stay in half-steps so the two segments add up exactly.
+// every wheel in the mask runs its own move at the same time, segment by segment.
+static void move_coarse_then_fine(uint32_t wheel_mask, const uint32_t half_steps[], const int directions[]) {
+    uint32_t fine_steps[WHEEL_COUNT];
+    for (uint w = 0; w < WHEEL_COUNT; w++) {
+        if (!(wheel_mask & WHEEL_BIT(w))) continue;
+        fine_steps[w] = half_steps[w] < FINE_APPROACH_STEPS ? half_steps[w] : FINE_APPROACH_STEPS;
+        motor_set_drive_mode(w, MOTOR_DRIVE_FULL);
+        motor_move_async(w, half_steps[w] - fine_steps[w], directions[w]);
+    }
+    wait_for_wheels_idle(wheel_mask);
+    for (uint w = 0; w < WHEEL_COUNT; w++) {
+        if (!(wheel_mask & WHEEL_BIT(w))) continue;
+        motor_set_drive_mode(w, MOTOR_DRIVE_HALF);
+        motor_move_async(w, fine_steps[w], directions[w]);
+    }
+    wait_for_wheels_idle(wheel_mask);
+}
+
+// absolute motor position of a compartment, relative to the home the observer tracks.
+// slot N is always round(N * spr / COMPARTMENTS_PER_WHEEL) from home, so the fraction is spread
+// over the compartments and never adds up, and it is integer maths only.
+static int32_t slot_offset(uint wheel, int32_t slot) {
+    uint32_t divisor = (uint32_t)COMPARTMENTS_PER_WHEEL << SPR_Q8_SHIFT;
+    return (int32_t)(((uint32_t)slot * wheels[wheel].step_per_revolution_q8 + divisor / 2) / divisor);
+}
+
+static int32_t slot_position(uint wheel, int32_t slot) {
+    return observer_get_home_position(wheel) + slot_offset(wheel, slot);
+}
+
+static void report_observer_result(uint wheel, ObserverResult result) {
+    if (result == OBSERVER_CORRECTED) {
+        log_write_event(LOG_EVENT_POSITION_CORRECTED, log_wheel(wheel), (uint16_t)(int16_t)observer_get_last_error(wheel), 0);
+    } else if (result == OBSERVER_LOST) {
+        log_write_event(LOG_EVENT_POSITION_LOST, log_wheel(wheel), 0, 0);
+    }
+}
+
+// record where the wheel is (or is heading) so a reboot can carry on from there
+static void journal_wheel(uint wheel, bool is_moving, int32_t target) {
+    WheelJournal journal;
+    memset(&journal, 0, sizeof(journal));
+    int32_t home = observer_get_home_position(wheel);
+    journal.coil_phase = motor_get_phase(wheel);
+    journal.flags = (is_moving ? WHEEL_JOURNAL_MOVING : 0) | (observer_is_valid(wheel) ? WHEEL_JOURNAL_TRACKED : 0);
+    journal.offset_from_home = motor_get_position(wheel) - home;
+    journal.target_from_home = target - home;
+    journal.wheel_slot = (int16_t)wheels[wheel].wheel_slot;
+    journal.gap_width = (uint16_t)observer_get_gap_width(wheel);
+    save_wheel_journal((uint8_t)wheel, &journal);
+}
+
+// move every wheel in the mask to its compartment while the observers check the opto-fork
+// edges on the way. the caller journals the move or logs its intent, at rest each wheel is
+// journaled again.
+// back at home the slot numbering starts over.
+// returns when the wheels came to rest, the journal write after that is only queued.
+static uint64_t move_wheels_to_slots(uint32_t wheel_mask, const int32_t slots[], ObserverResult results[]) {
+    uint32_t distances[WHEEL_COUNT];
+    int directions[WHEEL_COUNT];
+    for (uint w = 0; w < WHEEL_COUNT; w++) {
+        if (!(wheel_mask & WHEEL_BIT(w))) continue;
+        int32_t target = slot_position(w, slots[w]);
+        int32_t distance = target - motor_get_position(w);
+        directions[w] = distance < 0 ? DISPENSER_BACK_DIRECTION : DEFAULT_DISPENSER_ROTATED_DIRECTION;
+        distances[w] = (uint32_t)(distance < 0 ? -distance : distance);
+        observer_begin_move(w, directions[w]);
+    }
+    // a power cut mid-move is recovered from the caller's journal or dispense intent,
+    // it has to be on the part first
+    if (!eeprom_writer_flush()) {
+        printf("[EEPROM] Journal not on the part before the move.\n");
+    }
+    move_coarse_then_fine(wheel_mask, distances, directions);
+    uint64_t done_us = time_us_64();
+
+    for (uint w = 0; w < WHEEL_COUNT; w++) {
+        if (!(wheel_mask & WHEEL_BIT(w))) continue;
+        results[w] = observer_end_move(w);
+        report_observer_result(w, results[w]);
+
+        Wheel *wheel = &wheels[w];
+        wheel->wheel_slot = slots[w];
+        if (wheel->wheel_slot != 0 && wheel->wheel_slot % COMPARTMENTS_PER_WHEEL == 0) {
+            observer_set_home_position(w, slot_position(w, wheel->wheel_slot));
+            wheel->wheel_slot = 0;
+        }
+        journal_wheel(w, false, motor_get_position(w));
+    }
+    return done_us;
+}
+
+static ObserverResult move_to_slot_observed(uint wheel, int32_t slot) {
+    int32_t slots[WHEEL_COUNT];
+    ObserverResult results[WHEEL_COUNT];
+    slots[wheel] = slot;
+    journal_wheel(wheel, true, slot_position(wheel, slot));
+    move_wheels_to_slots(WHEEL_BIT(wheel), slots, results);
+    return results[wheel];
+}
+
+// after a refill the wheel only needs to come forward to home, the edge check there
+// tells whether the old calibration still holds.
+static bool return_home_observed(uint wheel) {
+    if (!observer_is_valid(wheel)) return false;
+    int32_t slot = wheels[wheel].wheel_slot;
+    int32_t slots_to_home = (COMPARTMENTS_PER_WHEEL - slot % COMPARTMENTS_PER_WHEEL) % COMPARTMENTS_PER_WHEEL;
+    ObserverResult result = move_to_slot_observed(wheel, slot + slots_to_home);
+    motor_stop(wheel);
+    return result != OBSERVER_LOST;
+}
+
+// position is still tracked: go back over the empty compartments to home and forward
+// to the target slot, no gap search needed.
+static bool move_to_slot_via_home_observed(uint wheel, int32_t target_slot) {
+    if (!observer_is_valid(wheel)) return false;
+    int32_t slot = wheels[wheel].wheel_slot;
+    if (move_to_slot_observed(wheel, slot - slot % COMPARTMENTS_PER_WHEEL) == OBSERVER_LOST) return false;
+    ObserverResult result = move_to_slot_observed(wheel, wheels[wheel].wheel_slot + target_slot);
+    motor_stop(wheel);
+    return result != OBSERVER_LOST;
+}
+
+// index of the first stamped edge from `from` on with the given level, -1 if none
+static int find_edge(const OptoEdge *edges, int count, int from, bool level) {
+    for (int i = from; i < count; i++) {
+        if (edges[i].level == level) return i;
+    }
+    return -1;
+}
+
+// creep in short background moves until such an edge is stamped
+static int seek_edge(uint wheel, int direction, OptoEdge *edges, int *count, int from, bool level, int32_t max_steps) {
+    int32_t start = motor_get_position(wheel);
+    while (true) {
+        *count = observer_get_edges(wheel, edges, OBSERVER_MAX_EDGES);
+        int index = find_edge(edges, *count, from, level);
+        if (index >= 0 || (motor_get_position(wheel) - start) * direction >= max_steps) return index;
+        motor_move_async(wheel, FAST_CALIBRATION_SEEK_STEPS, direction);
+        wait_for_motor_idle(wheel);
+    }
+}
+
+// power was cut while the wheel turned from offset_from_home to target_from_home, the rotor is
+// somewhere in between. back up to the first gap edge, which is never past the empty home
+// compartment, and take the position from where the irq stamped it. that edge is the upper
+// end of the gap when the wheel enters it, the lower end when it leaves. the copy of it one
+// revolution apart is told by the distance travelled.
+static bool resume_cut_move(uint wheel) {
+    const WheelJournal *journal = &wheels[wheel].boot_journal;
+    int32_t spr = (int32_t)spr_whole_steps(wheel);
+    int32_t gap = journal->gap_width;
+    bool is_forward = journal->offset_from_home < journal->target_from_home;
+    int32_t low = is_forward ? journal->offset_from_home : journal->target_from_home;
+    int32_t high = is_forward ? journal->target_from_home : journal->offset_from_home;
+    OptoEdge edges[OBSERVER_MAX_EDGES];
+    int count = 0;
+
+    motor_set_phase(wheel, journal->coil_phase);
+    motor_set_drive_mode(wheel, MOTOR_DRIVE_HALF);
+    int32_t start = motor_get_position(wheel);
+    bool level = !opto_fork_sensor_read(wheel);
+    // farthest it can be is the lower end of the gap below the start
+    int32_t lowest_edge = low - ((low + gap / 2) % spr + spr) % spr;
+    int32_t max_steps = high - lowest_edge + JOURNAL_CUT_TOLERANCE_STEPS;
+    observer_begin_move(wheel, DISPENSER_BACK_DIRECTION);
+    int index = seek_edge(wheel, DISPENSER_BACK_DIRECTION, edges, &count, 0, level, max_steps);
+    observer_end_move(wheel);
+    if (index < 0) {
+        printf("[Recovery] Wheel %u no gap edge behind the cut move.\n", wheel);
+        return false;
+    }
+
+    int32_t travelled = start - edges[index].position;
+    int32_t edge_offset = level == 0 ? gap - gap / 2 : -(gap / 2);
+    int32_t revolutions = high + JOURNAL_CUT_TOLERANCE_STEPS - travelled - edge_offset;
+    revolutions = revolutions >= 0 ? revolutions / spr : -((spr - 1 - revolutions) / spr);
+    edge_offset += revolutions * spr;
+    if (edge_offset + travelled < low - JOURNAL_CUT_TOLERANCE_STEPS) {
+        printf("[Recovery] Wheel %u gap edge %ld steps back does not fit the cut move.\n", wheel, (long)travelled);
+        return false;
+    }
+
+    observer_learn(wheel, edges[index].position - edge_offset, (uint32_t)spr, (uint32_t)gap);
+    wheels[wheel].wheel_slot = journal->wheel_slot;
+    printf("[Recovery] Wheel %u was cut %ld steps from home, gap edge found %ld steps back.\n", wheel,
+           (long)(edge_offset + travelled), (long)travelled);
+    return true;
+}
+
+// power came back with the wheel at rest where the journal says. restore the tracking
+// and check it against the sensor and a short observed move instead of searching the gap.
+// a wheel cut mid-move finds its position on the nearest gap edge behind it.
+static bool resume_from_journal(uint wheel) {
+    Wheel *w = &wheels[wheel];
+    if (!w->has_boot_journal) return false;
+    w->has_boot_journal = false;
+    if (!(w->boot_journal.flags & WHEEL_JOURNAL_TRACKED)) return false;
+    if (w->boot_journal.flags & WHEEL_JOURNAL_MOVING) return resume_cut_move(wheel);
+
+    motor_set_phase(wheel, w->boot_journal.coil_phase);
+    observer_learn(wheel, motor_get_position(wheel) - w->boot_journal.offset_from_home,
+                   spr_whole_steps(wheel), w->boot_journal.gap_width);
+    w->wheel_slot = w->boot_journal.wheel_slot;
+
+    bool is_verified = observer_level_matches(wheel, motor_get_position(wheel), opto_fork_sensor_read(wheel));
+    int direction = DISPENSER_BACK_DIRECTION;
+    for (int i = 0; i < 2 && is_verified; i++) {
+        observer_begin_move(wheel, direction);
+        motor_move_async(wheel, JOURNAL_VERIFY_STEPS, direction);
+        wait_for_motor_idle(wheel);
+        is_verified = observer_end_move(wheel) != OBSERVER_LOST &&
+                      observer_level_matches(wheel, motor_get_position(wheel), opto_fork_sensor_read(wheel));
+        direction = -direction;
+    }
+    motor_stop(wheel);
+    if (!is_verified) {
+        observer_forget(wheel);
+        printf("[Recovery] Wheel %u journal does not match the sensor.\n", wheel);
+    }
+    return is_verified;
+}
+
+// the period is over once every wheel has given its pills
 static bool is_dispenser_empty() {
-    return pill_dispensed_count >= pill_treatment_period;
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+        if (wheels[i].pill_dispensed_count < wheels[i].pill_treatment_period) return false;
+    }
+    return true;
+}
+
+// wait up to one fall time after aligned_us for the armed wheels in the mask, returns the
+// wheels whose pill was seen. the piezo irq wakes the core, so this ends right at the last drop.
+static uint32_t wait_for_pills(uint32_t wheel_mask, uint64_t aligned_us) {
+    absolute_time_t deadline = from_us_since_boot(aligned_us + PILL_FALL_TIMEOUT_MS * 1000);
+    uint32_t dropped = 0;
+    while (true) {
+        for (uint w = 0; w < WHEEL_COUNT; w++) {
+            if ((wheel_mask & WHEEL_BIT(w)) && sensor_get_pill_detected(w)) dropped |= WHEEL_BIT(w);
+        }
+        if (dropped == wheel_mask || time_reached(deadline)) break;
+        best_effort_wfe_or_timeout(deadline);
+    }
+    return dropped;
 }
 
+static struct {
+    uint32_t buckets[DROP_LATENCY_BUCKETS];
+    uint32_t count;
+    uint32_t max_ms;
+    int32_t max_steps_early;
+} drop_latency;
+
+// file the stamped piezo edge against the moment the compartment aligned
+static void record_drop_latency(uint wheel, uint64_t aligned_us) {
+    uint64_t edge_us;
+    int32_t edge_position;
+    if (!sensor_get_drop_edge(wheel, &edge_us, &edge_position)) return;
+
+    int32_t steps_early = abs(motor_get_position(wheel) - edge_position);
+    uint32_t latency_ms = edge_us > aligned_us ? (uint32_t)((edge_us - aligned_us) / 1000) : 0;
+    uint32_t bucket = 0;
+    if (steps_early == 0) {
+        bucket = 1 + latency_ms / DROP_LATENCY_BUCKET_MS;
+        if (bucket >= DROP_LATENCY_BUCKETS) bucket = DROP_LATENCY_BUCKETS - 1;
+        if (latency_ms > drop_latency.max_ms) drop_latency.max_ms = latency_ms;
+    } else if (steps_early > drop_latency.max_steps_early) {
+        drop_latency.max_steps_early = steps_early;
+    }
+    drop_latency.buckets[bucket]++;
+    drop_latency.count++;
+}
 
-bool is_pill_dropped() {
-    uint64_t start_time = time_us_64() / 1000;
-    while (time_us_64() / 1000 - start_time < PILL_FALL_TIMEOUT_MS) {
-        if (sensor_get_pill_detected()) {
-            return true;
+// one trace at a time, too big for the stack
+static uint16_t piezo_trace[PIEZO_TRACE_MAX_SAMPLES];
+
+// hex dump the classifier input, so it can be replayed and tuned on a PC
+static void dump_piezo_trace(uint wheel, PillClass pill_class, uint32_t count) {
+    printf("[Trace] wheel=%u hz=%u class=%s n=%lu\n", wheel, PIEZO_CAPTURE_SAMPLE_HZ,
+           pill_class_name(pill_class), (unsigned long)count);
+    for (uint32_t i = 0; i < count; i += 16) {
+        printf("[Trace]");
+        for (uint32_t j = i; j < i + 16 && j < count; j++) {
+            printf(" %03X", piezo_trace[j]);
         }
-        sleep_ms(1);
+        printf("\n");
+    }
+}
+
+// look at the waveform around the piezo edge. wheels without an ADC piezo, or without
+// enough samples, trust the edge.
+static PillClass classify_drop(uint wheel) {
+    uint64_t edge_us;
+    int32_t edge_position;
+    uint gpio = sensor_get_piezo_pin(wheel);
+    if (!piezo_capture_is_adc_pin(gpio) || !sensor_get_drop_edge(wheel, &edge_us, &edge_position)) {
+        return PILL_CLASS_SINGLE;
+    }
+    uint32_t count = piezo_capture_read(gpio, edge_us - PIEZO_CAPTURE_PRETRIGGER_MS * 1000,
+                                        piezo_trace, PIEZO_TRACE_MAX_SAMPLES);
+    if (count <= PILL_BASELINE_SAMPLES) return PILL_CLASS_SINGLE;
+
+    PillFeatures features;
+    pill_classifier_extract(piezo_trace, count, &features);
+    PillClass pill_class = pill_classifier_classify(&features);
+    printf("[Piezo] Wheel %u %s: peak %u, energy %lu, %u active, %u bursts\n", wheel,
+           pill_class_name(pill_class), features.peak, (unsigned long)features.energy,
+           features.duration, features.bursts);
+    if (PIEZO_TRACE_DUMP_ALL || pill_class != PILL_CLASS_SINGLE) {
+        dump_piezo_trace(wheel, pill_class, count);
+    }
+    return pill_class;
+}
+
+void dispenser_report_drop_latency() {
+    printf("[Drop] %lu pills, %lu while turning (up to %ld steps early), max %lu ms after alignment\n",
+           (unsigned long)drop_latency.count, (unsigned long)drop_latency.buckets[0],
+           (long)drop_latency.max_steps_early, (unsigned long)drop_latency.max_ms);
+    for (int i = 1; i < DROP_LATENCY_BUCKETS; i++) {
+        if (drop_latency.buckets[i] == 0) continue;
+        printf("[Drop] %3d-%3d ms: %lu\n", (i - 1) * DROP_LATENCY_BUCKET_MS, i * DROP_LATENCY_BUCKET_MS - 1,
+               (unsigned long)drop_latency.buckets[i]);
     }
-    return false;
 }
 
 bool is_calibrated_dispenser() {
-    return is_calibrated;
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+        if (!wheels[i].is_calibrated) return false;
+    }
+    return true;
+}
+
+static void wheel_defaults(Wheel *w) {
+    w->is_calibrated = false;
+    w->step_per_revolution_q8 = DEFAULT_STEP_PER_REVOLUTION << SPR_Q8_SHIFT;
+    w->pill_dispensed_count = 0;
+    w->pill_treatment_period = DEFAULT_PERIOD;
+    w->is_turning = false;
+    w->wheel_slot = 0;
+}
+
+// a dispense move is not journaled, the open intent has its slot. the wheel journal at rest
+// one slot before it is where the move started. a journal already at the slot means the wheel
+// got there and only the result record was cut.
+static void journal_intent_move(uint wheel, uint8_t intent_slot) {
+    Wheel *w = &wheels[wheel];
+    if (!w->has_boot_journal || (w->boot_journal.flags & WHEEL_JOURNAL_MOVING)) return;
+    if (w->boot_journal.wheel_slot + 1 != intent_slot) return;
+    w->boot_journal.flags |= WHEEL_JOURNAL_MOVING;
+    w->boot_journal.target_from_home = slot_offset(wheel, intent_slot);
 }
 
 void dispenser_init() {
     eeprom_init();
     DispenserState old_state;
+    for (uint i = 0; i < WHEEL_COUNT; i++) {
+        wheel_defaults(&wheels[i]);
+        wheels[i].has_boot_journal = load_wheel_journal((uint8_t)i, &wheels[i].boot_journal);
+    }
 
     if (load_dispenser_state_from_eeprom(&old_state)) {
         globals_from_state(&old_state);
 
-        printf("Calibrated: %d, Dispensed: %d/%d, Motor status: %d\n",is_calibrated, pill_dispensed_count, pill_treatment_period,
-               old_state.motor_status);
-
-        char log_message[MAX_MESSAGE_LENGTH];
-        sprintf(log_message, "BOOT:Calibrated:%d,Dispensed:%d/%d,MotorStatus:%d",is_calibrated, pill_dispensed_count, pill_treatment_period,
-                old_state.motor_status);
-        log_write_message(log_message);
-
         //  modify the motor_status flag (power off when turning)
-        if (old_state.motor_status == 1) {
-            motor_running_at_boot = true;
-        } else {
-            motor_running_at_boot = false;
+        motor_running_at_boot = false;
+        for (int i = 0; i < WHEEL_COUNT; i++) {
+            uint8_t motor_status = (old_state.wheels[i].flags & WHEEL_STATE_MOTOR_RUNNING) ? 1 : 0;
+            if (motor_status == 1) {
+                motor_running_at_boot = true;
+                journal_intent_move(i, old_state.wheels[i].intent_slot);
+            }
+            const Wheel *w = &wheels[i];
+            char prefix[8];
+            wheel_prefix(prefix, i);
+            printf("%sCalibrated: %d, Dispensed: %d/%d, Motor status: %d\n", prefix, w->is_calibrated,
+                   w->pill_dispensed_count, w->pill_treatment_period, motor_status);
+
+            log_write_event(LOG_EVENT_BOOT, log_wheel(i),
+                            (uint16_t)(w->pill_dispensed_count | w->pill_treatment_period << 8),
+                            (uint16_t)(w->is_calibrated | motor_status << 1));
         }
     } else {
         // totally new machine or without any eeprom state.
         motor_running_at_boot = false;
-        is_calibrated = false;
-        step_per_revolution = 4096.0f;
-        pill_dispensed_count = 0;
-        pill_treatment_period = 7;
 
-        log_write_message("System Boot: No previous settings found.");
+        log_write_event(LOG_EVENT_BOOT_NEW, LOG_NO_WHEEL, 0, 0);
         lora_send_message("BOOT:NEW");
     }
 }
 
-void dispenser_calibration() {
+// one revolution plus the gap in the background with the opto edges stamped by irq:
+// enter0 -> leave0 -> enter1 -> leave1 gives two independent steps/rev and gap widths.
+// ends centred in the second gap, approached forward like move_to_center_from_edge().
+static bool fast_calibration(uint wheel, int *gap_width) {
+    int32_t spr_guess = (int32_t)spr_whole_steps(wheel);
+    int32_t margin = spr_guess / FAST_CALIBRATION_MARGIN_DIV;
+    OptoEdge edges[OBSERVER_MAX_EDGES];
+    int count = 0;
+
+    observer_forget(wheel);
+    motor_set_drive_mode(wheel, MOTOR_DRIVE_HALF);
+    int direction = DEFAULT_DISPENSER_ROTATED_DIRECTION;
+    observer_begin_move(wheel, direction);
+    int enter0 = seek_edge(wheel, direction, edges, &count, 0, 0, spr_guess);
+    if (enter0 >= 0) {
+        int32_t travel = edges[enter0].position + spr_guess - margin - motor_get_position(wheel);
+        if (travel > 0) {
+            motor_move_async(wheel, travel, direction);
+            wait_for_motor_idle(wheel);
+        }
+    }
+    // leave0 was stamped on the long move, its gap bounds the rest of the pass
+    int leave0 = enter0 < 0 ? -1 : seek_edge(wheel, direction, edges, &count, enter0 + 1, 1, 0);
+    int enter1 = -1;
+    if (leave0 >= 0) {
+        int32_t limit = edges[enter0].position + spr_guess + margin;
+        enter1 = seek_edge(wheel, direction, edges, &count, leave0 + 1, 0, limit - motor_get_position(wheel));
+    }
+    // a second gap wider by more than the spread fails the check anyway
+    int leave1 = -1;
+    if (enter1 >= 0) {
+        int32_t limit = edges[enter1].position + edges[leave0].position - edges[enter0].position +
+                        FAST_CALIBRATION_MAX_SPREAD;
+        leave1 = seek_edge(wheel, direction, edges, &count, enter1 + 1, 1, limit - motor_get_position(wheel));
+    }
+    observer_end_move(wheel);
+    if (leave1 < 0) {
+        printf("[Calibration] Wheel %u gap edges not found in one revolution.\n", wheel);
+        return false;
+    }
+
+    int32_t spr_enter = edges[enter1].position - edges[enter0].position;
+    int32_t spr_leave = edges[leave1].position - edges[leave0].position;
+    int32_t gap0 = edges[leave0].position - edges[enter0].position;
+    int32_t gap1 = edges[leave1].position - edges[enter1].position;
+    int32_t spread = abs(spr_enter - spr_leave);
+
+    // back to before the second gap, then into its centre in the dispensing direction
+    int32_t approach = edges[enter1].position - FAST_CALIBRATION_APPROACH_STEPS;
+    motor_move_async(wheel, motor_get_position(wheel) - approach, DISPENSER_BACK_DIRECTION);
+    wait_for_motor_idle(wheel);
+    motor_move_async(wheel, FAST_CALIBRATION_APPROACH_STEPS + gap1 / 2, direction);
+    wait_for_motor_idle(wheel);
+    motor_stop(wheel);
+
+    printf("[Calibration] Wheel %u fast: %ld/%ld steps/rev, gap %ld/%ld, spread %ld.\n", wheel,
+           (long)spr_enter, (long)spr_leave, (long)gap0, (long)gap1, (long)spread);
+    if (spread > FAST_CALIBRATION_MAX_SPREAD) return false;
+
+    wheels[wheel].step_per_revolution_q8 = (uint32_t)(spr_enter + spr_leave) << (SPR_Q8_SHIFT - 1);
+    *gap_width = gap1;
+    return true;
+}
+
+// the original method: CALIBRATION_ROUNDS blocking revolutions, averaged
+static void multi_round_calibration(uint wheel, int *gap_width) {
     int direction = DEFAULT_DISPENSER_ROTATED_DIRECTION; //clockwise
-    printf("Starting calibration...\n");
 
-    move_to_falling_edge(direction);
+    move_to_falling_edge(wheel, direction);
     sleep_ms(200);
 
     uint measurements[CALIBRATION_ROUNDS];
@@ -135,14 +603,14 @@ void dispenser_calibration() {
         int gap_steps = 0;
         int blind_steps = 0;
 
-        while (opto_fork_sensor_read() == 0) {
-            motor_move_one_step(direction);
+        while (opto_fork_sensor_read(wheel) == 0) {
+            motor_move_one_step(wheel, direction);
             gap_steps++;
             sleep_ms(1);
         }
 
-        while (opto_fork_sensor_read() == 1) {
-            motor_move_one_step(direction);
+        while (opto_fork_sensor_read(wheel) == 1) {
+            motor_move_one_step(wheel, direction);
             blind_steps++;
             sleep_ms(1);
         }
@@ -152,78 +620,216 @@ void dispenser_calibration() {
         sleep_ms(100);
     }
 
-    move_to_center_from_edge(direction, last_gap_width);
-    motor_stop();
+    move_to_center_from_edge(wheel, direction, last_gap_width);
+    motor_stop(wheel);
 
-    float sum_steps = 0;
+    uint32_t sum_steps = 0;
     for (int i = 0; i < CALIBRATION_ROUNDS; i++) {
         sum_steps += measurements[i];
     }
-    step_per_revolution = sum_steps / (float)CALIBRATION_ROUNDS;
-
-    is_calibrated = true;
-    pill_dispensed_count = 0;
+    wheels[wheel].step_per_revolution_q8 = ((sum_steps << SPR_Q8_SHIFT) + CALIBRATION_ROUNDS / 2) / CALIBRATION_ROUNDS;
+    *gap_width = last_gap_width;
+}
 
-    DispenserState calibrated_state;
-    state_from_globals(&calibrated_state,0);
-    save_dispenser_state_to_eeprom(&calibrated_state);
+static void calibrate_wheel(uint wheel) {
+    Wheel *w = &wheels[wheel];
+    if (return_home_observed(wheel)) {
+        w->is_calibrated = true;
+        w->pill_dispensed_count = 0;
+        printf("Wheel %u calibration skipped, wheel tracked back to home.\n", wheel);
+        return;
+    }
+    printf("Starting calibration of wheel %u...\n", wheel);
 
-    printf("Calibration Complete. Avg: %.2f steps/rev.",step_per_revolution);
-}
+    uint64_t start_us = time_us_64();
+    int gap_width = 0;
+    bool is_fast = fast_calibration(wheel, &gap_width);
+    if (!is_fast) {
+        printf("[Calibration] Falling back to %d rounds.\n", CALIBRATION_ROUNDS);
+        multi_round_calibration(wheel, &gap_width);
+    }
+    uint32_t elapsed_ms = (uint32_t)((time_us_64() - start_us) / 1000);
 
-bool do_dispense_single_round() {
-    if (!is_calibrated) return false;
+    log_write_event(is_fast ? LOG_EVENT_CALIBRATED_FAST : LOG_EVENT_CALIBRATED_ROUNDS, log_wheel(wheel),
+                    (uint16_t)spr_whole_steps(wheel), (uint16_t)(elapsed_ms > UINT16_MAX ? UINT16_MAX : elapsed_ms));
 
-    DispenserState pre_state;
-    state_from_globals(&pre_state, 1);
-    save_dispenser_state_to_eeprom(&pre_state);
-    sleep_ms(50);
+    observer_learn(wheel, motor_get_position(wheel), spr_whole_steps(wheel), gap_width);
+    w->wheel_slot = 0;
+    journal_wheel(wheel, false, motor_get_position(wheel));
 
-    sensor_reset_pill_detected();
-    long steps_need = (long)(step_per_revolution / 8.0f + 0.5f);
+    w->is_calibrated = true;
+    w->pill_dispensed_count = 0;
 
-    printf("[Debug] Starting to dispense round %d/%d...\n",
-           pill_dispensed_count + 1, pill_treatment_period, steps_need);
+    printf("Calibration Complete. Avg: %lu.%02lu steps/rev.\n",
+           (unsigned long)(w->step_per_revolution_q8 >> SPR_Q8_SHIFT), (unsigned long)spr_hundredths(wheel));
+}
 
-    for (long i = 0; i < steps_need; i++) {
-        motor_move_one_step(DEFAULT_DISPENSER_ROTATED_DIRECTION);
+// wheels still waiting for calibration, one after the other so only one motor draws current
+void dispenser_calibration() {
+    for (uint w = 0; w < WHEEL_COUNT; w++) {
+        if (!wheels[w].is_calibrated) calibrate_wheel(w);
     }
-    motor_stop();
+    save_state();
+}
 
-    if (is_pill_dropped()) {
-        pill_dispensed_count++;
+// wheels can turn at the same time when a drop is still credited to the right wheel.
+// every wheel has its own motor sequencer, so only a shared piezo keeps them apart.
+static bool wheels_are_independent(uint a, uint b) {
+    return sensor_get_piezo_pin(a) != sensor_get_piezo_pin(b);
+}
 
-        char log_message[MAX_MESSAGE_LENGTH];
-        sprintf(log_message, "OK: %d/%d",pill_dispensed_count, pill_treatment_period);
-        log_write_message(log_message);
+// turn the wheels in the mask one compartment on together and credit the pills that fall.
+// returns true when every wheel in the mask gave its pill.
+static bool dispense_batch(uint32_t wheel_mask) {
+    int32_t slots[WHEEL_COUNT];
+    ObserverResult results[WHEEL_COUNT];
+    for (uint w = 0; w < WHEEL_COUNT; w++) {
+        if (!(wheel_mask & WHEEL_BIT(w))) continue;
+        wheels[w].is_turning = true;
+        // target is absolute, so a slip corrected by the observer is made up on this move
+        slots[w] = wheels[w].wheel_slot + 1;
+        // the intent with the result record replaces the state saves before and after a pill,
+        // an open intent at boot means it was turning, from the journal at rest to its slot.
+        log_write_event(LOG_EVENT_DISPENSE_INTENT, log_wheel(w), wheels[w].pill_dispensed_count, (uint16_t)slots[w]);
+    }
+    save_state(); // nothing to write, unless the log missed a change
+
+    // the window opens the last few steps before the compartment is over the opening,
+    // a pill that slips out early is caught while the motor is still finishing the move
+    uint32_t piezo_mask = 0;
+    for (uint w = 0; w < WHEEL_COUNT; w++) {
+        if (!(wheel_mask & WHEEL_BIT(w))) continue;
+        int32_t target = slot_position(w, slots[w]);
+        int direction = target < motor_get_position(w) ? DISPENSER_BACK_DIRECTION : DEFAULT_DISPENSER_ROTATED_DIRECTION;
+        sensor_arm_drop_window(w, target - direction * PILL_DROP_WINDOW_LEAD_STEPS, direction);
+        piezo_mask |= 1u << sensor_get_piezo_pin(w);
+    }
+    bool is_capturing = piezo_capture_start(piezo_mask);
+
+    // within a poll of the last step, the fall timeout counts from here
+    uint64_t aligned_us = move_wheels_to_slots(wheel_mask, slots, results);
+    uint32_t dropped = wait_for_pills(wheel_mask, aligned_us);
+    if (is_capturing) {
+        if (dropped != 0) sleep_ms(PIEZO_CAPTURE_TAIL_MS);
+        piezo_capture_stop();
+    }
+    PillClass classes[WHEEL_COUNT];
+    for (uint w = 0; w < WHEEL_COUNT; w++) {
+        if (!(wheel_mask & WHEEL_BIT(w))) continue;
+        sensor_disarm_drop_window(w);
+        classes[w] = (dropped & WHEEL_BIT(w)) ? classify_drop(w) : PILL_CLASS_NONE;
+        // the edge counts the pill, the class only takes it back with the veto on
+        bool is_pill_class = classes[w] == PILL_CLASS_SINGLE || classes[w] == PILL_CLASS_DOUBLE;
+        if (PILL_CLASSIFIER_VETO && !is_pill_class) dropped &= ~WHEEL_BIT(w);
+        if (dropped & WHEEL_BIT(w)) record_drop_latency(w, aligned_us);
+        motor_stop(w);
+    }
 
+    for (uint w = 0; w < WHEEL_COUNT; w++) {
+        if (!(wheel_mask & WHEEL_BIT(w))) continue;
+        Wheel *wheel = &wheels[w];
+        // if no pill fall the motor state should also be 0
+        wheel->is_turning = false;
+        char prefix[8];
+        wheel_prefix(prefix, w);
         char lora_message[MAX_MESSAGE_LENGTH];
-        snprintf(lora_message, MAX_MESSAGE_LENGTH, "OK:%d/%d",pill_dispensed_count, pill_treatment_period);
-        lora_send_message(lora_message);
-
-        if (is_dispenser_empty()) {
-            is_calibrated = false;
-            pill_dispensed_count = 0;
-            //printf("⚠️ Dispenser empty, please refill and recalibrate.\n");
-            log_write_message("EMPTY");
+        if (dropped & WHEEL_BIT(w)) {
+            wheel->pill_dispensed_count++;
+
+            log_write_event(LOG_EVENT_PILL_OK, log_wheel(w), wheel->pill_dispensed_count, wheel->pill_treatment_period);
+
+            snprintf(lora_message, MAX_MESSAGE_LENGTH, "%sOK:%d/%d", prefix,
+                     wheel->pill_dispensed_count, wheel->pill_treatment_period);
+            lora_send_message(lora_message);
+
+            if (classes[w] == PILL_CLASS_DOUBLE) {
+                log_write_event(LOG_EVENT_PILL_DOUBLE, log_wheel(w), 0, 0);
+            }
+        } else if (classes[w] == PILL_CLASS_NOISE) {
+            log_write_event(LOG_EVENT_PILL_NOISE, log_wheel(w), 0, 0);
+            snprintf(lora_message, MAX_MESSAGE_LENGTH, "%sNOPILL", prefix);
+            lora_send_message(lora_message);
+        } else {
+            log_write_event(LOG_EVENT_PILL_MISSING, log_wheel(w), 0, 0);
+            snprintf(lora_message, MAX_MESSAGE_LENGTH, "%sNOPILL", prefix);
+            lora_send_message(lora_message);
         }
+    }
 
-        DispenserState success_state;
-        state_from_globals(&success_state, 0);
-        save_dispenser_state_to_eeprom(&success_state);
+    if (is_dispenser_empty()) {
+        for (int i = 0; i < WHEEL_COUNT; i++) {
+            wheels[i].is_calibrated = false;
+            wheels[i].pill_dispensed_count = 0;
+        }
+        //printf("⚠️ Dispenser empty, please refill and recalibrate.\n");
+        log_write_event(LOG_EVENT_EMPTY, LOG_NO_WHEEL, 0, 0);
+    }
+    save_state();
+    return dropped == wheel_mask;
+}
 
-        return true;
-    } else {
-        log_write_message("Dispense failed: no pill detected");
-        lora_send_message("NOPILL");
+// one round gives the next day's pill from every wheel that is behind, a wheel that
+// failed before is retried while the others wait for it. independent wheels turn together.
+bool do_dispense_single_round() {
+    if (!is_calibrated_dispenser()) return false;
+
+    uint32_t pending = 0;
+    uint8_t round = dispenser_get_dispensed_count();
+    for (uint w = 0; w < WHEEL_COUNT; w++) {
+        if (wheels[w].pill_dispensed_count == round &&
+            wheels[w].pill_dispensed_count < wheels[w].pill_treatment_period) {
+            pending |= WHEEL_BIT(w);
+        }
+    }
 
-        // if no pill fall the motor state should also be 0
-        DispenserState fail_state;
-        state_from_globals(&fail_state, 0);
-        save_dispenser_state_to_eeprom(&fail_state);
+    bool is_success = pending != 0;
+    while (pending != 0) {
+        uint32_t batch = 0;
+        for (uint w = 0; w < WHEEL_COUNT; w++) {
+            if (!(pending & WHEEL_BIT(w))) continue;
+            bool fits = true;
+            for (uint other = 0; other < WHEEL_COUNT; other++) {
+                if ((batch & WHEEL_BIT(other)) && !wheels_are_independent(w, other)) fits = false;
+            }
+            if (fits) batch |= WHEEL_BIT(w);
+        }
+        pending &= ~batch;
+        if (!dispense_batch(batch)) is_success = false;
+    }
+    return is_success;
+}
 
-        return false;
+static void recover_wheel(uint wheel) {
+    Wheel *w = &wheels[wheel];
+    int target_slot = w->pill_dispensed_count; // how many pills already detected
+
+    if (move_to_slot_via_home_observed(wheel, target_slot)) {
+        printf("[Recovery] Position still tracked, skipped the gap search\n");
+    } else if (resume_from_journal(wheel)) {
+        // a cut dispense is repeated, the wheel goes back to the slot of the last counted pill
+        if (w->wheel_slot != target_slot || motor_get_position(wheel) != slot_position(wheel, target_slot)) {
+            move_to_slot_observed(wheel, target_slot);
+        }
+        motor_stop(wheel);
+        printf("[Recovery] Resumed from wheel journal at slot %ld\n", (long)w->wheel_slot);
+    } else {
+        //printf("[Recovery] Target position: slot %d\n",target_slot);
+        move_to_falling_edge(wheel, DISPENSER_BACK_DIRECTION);
+        int gap_width = measure_gap_width(wheel, DISPENSER_BACK_DIRECTION, 100);
+        move_to_center_from_edge(wheel, DEFAULT_DISPENSER_ROTATED_DIRECTION, gap_width);
+        motor_stop(wheel);
+        observer_learn(wheel, motor_get_position(wheel), spr_whole_steps(wheel), gap_width);
+        w->wheel_slot = 0;
+
+        if (target_slot > 0) {
+            move_to_slot_observed(wheel, target_slot);
+        } else {
+            journal_wheel(wheel, false, motor_get_position(wheel));
+            printf("[Recovery] Already at home position, no forward movement needed\n");
+        }
+        motor_stop(wheel);
     }
+    w->is_calibrated = true;
 }
 
 void dispenser_recalibrate_from_poweroff() {
@@ -234,68 +840,57 @@ void dispenser_recalibrate_from_poweroff() {
         printf("[Recovery] ERROR: No saved state found!\n");
         return;
     }
-    step_per_revolution = old_state.step_per_revolution;
-    pill_dispensed_count = old_state.pill_dispensed_count;
-    pill_treatment_period = old_state.pill_treatment_period;
-    printf("[Recovery] State loaded: dispensed=%d/%d, steps/rev=%.2f\n",pill_dispensed_count, pill_treatment_period, step_per_revolution);
-
-    int target_slot = pill_dispensed_count; // how many pills already detected
-    float steps_per_slot = step_per_revolution / 8.0f; // same as do the first time calibration
-    int target_steps_from_home = (int)(target_slot * steps_per_slot);
-
-    //printf("[Recovery] Target position: slot %d, %d steps from home\n",target_slot, target_steps_from_home);
-    move_to_falling_edge(DISPENSER_BACK_DIRECTION);
-    int gap_width = measure_gap_width(DISPENSER_BACK_DIRECTION, 100);
-    move_to_center_from_edge(DEFAULT_DISPENSER_ROTATED_DIRECTION, gap_width);
-    motor_stop();
-
-
-    if (target_steps_from_home > 0) {
-        for (int i = 0; i < target_steps_from_home; i++) {
-            motor_move_one_step(DEFAULT_DISPENSER_ROTATED_DIRECTION);
-        }
-    } else {
-        printf("[Recovery] Already at home position, no forward movement needed\n");
+    globals_from_state(&old_state);
+
+    for (uint i = 0; i < WHEEL_COUNT; i++) {
+        Wheel *w = &wheels[i];
+        w->is_turning = false;
+        printf("[Recovery] Wheel %u state loaded: dispensed=%d/%d, steps/rev=%lu.%02lu\n", i,
+               w->pill_dispensed_count, w->pill_treatment_period,
+               (unsigned long)(w->step_per_revolution_q8 >> SPR_Q8_SHIFT), (unsigned long)spr_hundredths(i));
+        // a wheel that was never calibrated is left to the normal calibration
+        if (w->is_calibrated) recover_wheel(i);
     }
-    motor_stop();
-
-    is_calibrated = true;
-    old_state.motor_status = 0;
-    save_dispenser_state_to_eeprom(&old_state);
+    save_state();
 
-    printf("[Recovery]Recovery complete! Ready to dispense slot %d\n",pill_dispensed_count + 1);
-    log_write_message("Recovery from power-off successful");
+    printf("[Recovery]Recovery complete! Ready to dispense slot %d\n",dispenser_get_dispensed_count() + 1);
+    log_write_event(LOG_EVENT_RECOVERED, LOG_NO_WHEEL, 0, 0);
 }
 
 // didn't use in main statemachine, just in case if I want a fully clean mode.
 void dispenser_reset() {
     //log_erase_all();
-    DispenserState clean_state;
-    state_from_globals(&clean_state, 0);
-    save_dispenser_state_to_eeprom(&clean_state);
-
-    is_calibrated = false;
-    pill_dispensed_count = 0;
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+        wheels[i].is_calibrated = false;
+        wheels[i].pill_dispensed_count = 0;
+        wheels[i].is_turning = false;
+    }
+    save_state();
 
-    log_write_message("System: Factory Reset Performed");
+    log_write_event(LOG_EVENT_FACTORY_RESET, LOG_NO_WHEEL, 0, 0);
     printf("Factory Reset Complete. Please Restart.\n");
 }
 
-// user could adjust the period and save to eeprom
+// user could adjust the period and save to eeprom, all wheels follow the same period
 void dispenser_set_period(uint8_t period) {
-    pill_treatment_period = period;
-    DispenserState new_period_state;
-    state_from_globals(&new_period_state, 0);
-    save_dispenser_state_to_eeprom(&new_period_state);
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+        wheels[i].pill_treatment_period = period;
+    }
+    save_state();
     printf("[Debug] New period set %d.\n",period);
 }
 
 // get new modified period from user and expose to other files
 uint8_t dispenser_get_period() {
-    return pill_treatment_period;
+    return wheels[0].pill_treatment_period;
 }
+// days done, a day counts once every wheel has given its pill
 uint8_t dispenser_get_dispensed_count() {
-    return pill_dispensed_count;
+    uint8_t count = wheels[0].pill_dispensed_count;
+    for (int i = 1; i < WHEEL_COUNT; i++) {
+        if (wheels[i].pill_dispensed_count < count) count = wheels[i].pill_dispensed_count;
+    }
+    return count;
 }
 
 // mark if the motor is power off when turning.
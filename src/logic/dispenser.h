@@ -7,10 +7,17 @@
 #include "eeprom.h"
 #include "pico/types.h"
 
+// drop latency from the compartment aligning to the piezo edge, for tuning PILL_FALL_TIMEOUT_MS.
+// bucket 0 counts pills seen while the wheel was still turning into place.
+#define DROP_LATENCY_BUCKET_MS 10
+#define DROP_LATENCY_BUCKETS 16 // the last bucket also takes everything later
+
+// piezo samples behind one edge handed to the classifier
+#define PIEZO_TRACE_MAX_SAMPLES ((PIEZO_CAPTURE_PRETRIGGER_MS + PIEZO_CAPTURE_TAIL_MS + 32) * PIEZO_CAPTURE_SAMPLE_HZ / 1000)
+
 uint dispenser_align_with_opening_centered(int direction);
 void dispenser_init();
 void dispenser_calibration();
-bool is_pill_dropped();
 bool do_dispense_single_round();
 bool is_calibrated_dispenser();
 void dispenser_recalibrate_from_poweroff();
@@ -21,6 +28,7 @@ uint8_t dispenser_get_period();
 uint8_t dispenser_get_dispensed_count();
 bool dispenser_was_motor_running_at_boot();
 void dispenser_clear_boot_flag();
+void dispenser_report_drop_latency();
 
 
 #define DEFAULT_DISPENSER_ROTATED_DIRECTION 1 //clock-wise
@@ -28,5 +36,15 @@ void dispenser_clear_boot_flag();
 
 #define FAILURE_DISPENSE_PROMPT "Failure dispense."
 #define CALIBRATION_ROUNDS 3 //temporary
+#define FINE_APPROACH_STEPS 64 // last half-steps of a move are done in half-step drive
+
+// single pass calibration from irq stamped edges, multi-round only as fallback
+#define FAST_CALIBRATION_SEEK_STEPS 16 // short background moves while looking for an edge
+#define FAST_CALIBRATION_MARGIN_DIV 20 // stop the long move 1/20 rev before the gap is expected
+#define FAST_CALIBRATION_MAX_SPREAD 4 // steps between the enter and leave based revolutions
+#define FAST_CALIBRATION_APPROACH_STEPS 16 // the gap centre is approached forward from this far before it
+
+#define JOURNAL_VERIFY_STEPS 16 // back and forth after a reboot to check the journaled position
+#define JOURNAL_CUT_TOLERANCE_STEPS 8 // a cut move: the coils may pull the rotor a phase cycle either way
 
 #endif //PILLDISPENSER_DISPENSER_H
\ No newline at end of file
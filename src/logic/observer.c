@@ -0,0 +1,176 @@
+#include "observer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "../config.h"
+#include "pico/stdlib.h"
+#include "../drivers/motor.h"
+#include "../drivers/sensor.h"
+
+// gap of the wheel spans [gap_start, gap_start + gap_width) in forward steps,
+// repeated every revolution. home is the centre of the gap.
+typedef struct {
+    bool model_valid;
+    int32_t home_position;
+    int32_t model_spr;
+    int32_t model_gap_width;
+    int32_t last_error;
+
+    // filled by the gpio irq while a move is observed
+    volatile bool is_observing;
+    volatile uint8_t edge_count;
+    volatile bool edges_overflowed;
+    OptoEdge edges[OBSERVER_MAX_EDGES];
+    int move_direction;
+    int32_t move_start_position;
+} WheelObserver;
+
+static WheelObserver observers[WHEEL_COUNT];
+
+void observer_gpio_handler(uint gpio, uint32_t events) {
+    for (uint wheel = 0; wheel < WHEEL_COUNT; wheel++) {
+        WheelObserver *o = &observers[wheel];
+        if (gpio != sensor_get_opto_pin(wheel) || !o->is_observing) continue;
+        if (o->edge_count >= OBSERVER_MAX_EDGES) {
+            o->edges_overflowed = true;
+            continue;
+        }
+        o->edges[o->edge_count].position = motor_get_position(wheel);
+        o->edges[o->edge_count].level = gpio_get(gpio);
+        o->edge_count++;
+    }
+}
+
+// signed distance from position to the nearest copy of reference, one per revolution
+static int32_t error_to_nearest(const WheelObserver *o, int32_t position, int32_t reference) {
+    int32_t d = (position - reference) % o->model_spr;
+    if (d > o->model_spr / 2) d -= o->model_spr;
+    else if (d < -o->model_spr / 2) d += o->model_spr;
+    return d;
+}
+
+static int32_t gap_start(const WheelObserver *o) {
+    return o->home_position - o->model_gap_width / 2;
+}
+
+// is a copy of boundary strictly inside (from, to), with some margin for the jitter
+static bool boundary_crossed(const WheelObserver *o, int32_t boundary, int32_t from, int32_t to) {
+    int32_t low = from < to ? from : to;
+    int32_t high = from < to ? to : from;
+    low += OBSERVER_TOLERANCE_STEPS;
+    high -= OBSERVER_TOLERANCE_STEPS;
+    if (high <= low) return false;
+    int32_t first = low + ((boundary - low) % o->model_spr + o->model_spr) % o->model_spr;
+    return first < high;
+}
+
+void observer_learn(uint wheel, int32_t home, uint32_t steps_per_revolution, uint32_t gap_width) {
+    WheelObserver *o = &observers[wheel];
+    o->home_position = home;
+    o->model_spr = (int32_t)steps_per_revolution;
+    o->model_gap_width = (int32_t)gap_width;
+    o->last_error = 0;
+    o->model_valid = o->model_spr > 0;
+}
+
+void observer_forget(uint wheel) {
+    observers[wheel].model_valid = false;
+}
+
+bool observer_is_valid(uint wheel) {
+    return observers[wheel].model_valid;
+}
+
+int32_t observer_get_home_position(uint wheel) {
+    return observers[wheel].home_position;
+}
+
+// same physical home, renumbered after whole revolutions so positions stay small
+void observer_set_home_position(uint wheel, int32_t home) {
+    observers[wheel].home_position = home;
+}
+
+uint32_t observer_get_gap_width(uint wheel) {
+    return (uint32_t)observers[wheel].model_gap_width;
+}
+
+// does a sensor reading agree with the tracked position, right at a boundary both do
+bool observer_level_matches(uint wheel, int32_t position, bool level) {
+    const WheelObserver *o = &observers[wheel];
+    int32_t distance = abs(error_to_nearest(o, position, o->home_position));
+    int32_t half_gap = o->model_gap_width / 2;
+    if (abs(distance - half_gap) <= OBSERVER_TOLERANCE_STEPS) return true;
+    return (distance < half_gap) == (level == 0);
+}
+
+int32_t observer_get_last_error(uint wheel) {
+    return observers[wheel].last_error;
+}
+
+// edges stamped so far in the current move, oldest first
+uint8_t observer_get_edges(uint wheel, OptoEdge *out, uint8_t max_edges) {
+    const WheelObserver *o = &observers[wheel];
+    uint8_t count = o->edge_count;
+    if (count > max_edges) count = max_edges;
+    for (uint8_t i = 0; i < count; i++) {
+        out[i] = o->edges[i];
+    }
+    return count;
+}
+
+void observer_begin_move(uint wheel, int direction) {
+    WheelObserver *o = &observers[wheel];
+    o->is_observing = false;
+    o->edge_count = 0;
+    o->edges_overflowed = false;
+    o->move_direction = direction;
+    o->move_start_position = motor_get_position(wheel);
+    o->is_observing = true;
+}
+
+// compare every captured edge with where the calibration says the gap is.
+// moving forward the wheel enters the gap at gap_start, backward at gap_start + width.
+ObserverResult observer_end_move(uint wheel) {
+    WheelObserver *o = &observers[wheel];
+    o->is_observing = false;
+    if (!o->model_valid) return OBSERVER_OK;
+    if (o->edges_overflowed) {
+        o->model_valid = false;
+        return OBSERVER_LOST;
+    }
+
+    int32_t enter = o->move_direction > 0 ? gap_start(o) : gap_start(o) + o->model_gap_width;
+    int32_t leave = o->move_direction > 0 ? gap_start(o) + o->model_gap_width : gap_start(o);
+    int32_t error_sum = 0;
+    int32_t worst = 0;
+    bool saw_enter = false;
+    bool saw_leave = false;
+    for (int i = 0; i < o->edge_count; i++) {
+        bool entered = o->edges[i].level == 0;
+        int32_t error = error_to_nearest(o, o->edges[i].position, entered ? enter : leave) * o->move_direction;
+        if (entered) saw_enter = true;
+        else saw_leave = true;
+        error_sum += error;
+        if (abs(error) > abs(worst)) worst = error;
+    }
+
+    // a boundary we drove across without an edge means the wheel never got there
+    int32_t move_end_position = motor_get_position(wheel);
+    if ((!saw_enter && boundary_crossed(o, enter, o->move_start_position, move_end_position)) ||
+        (!saw_leave && boundary_crossed(o, leave, o->move_start_position, move_end_position))) {
+        o->model_valid = false;
+        return OBSERVER_LOST;
+    }
+    if (o->edge_count == 0) return OBSERVER_OK;
+
+    o->last_error = error_sum / o->edge_count;
+    if (abs(worst) > OBSERVER_MAX_CORRECTION_STEPS) {
+        o->model_valid = false;
+        return OBSERVER_LOST;
+    }
+    if (abs(o->last_error) <= OBSERVER_TOLERANCE_STEPS) {
+        return OBSERVER_OK;
+    }
+    // wheel lags the step count by last_error, move home along with it
+    o->home_position += o->last_error * o->move_direction;
+    return OBSERVER_CORRECTED;
+}
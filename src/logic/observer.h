@@ -0,0 +1,41 @@
+//
+// Closed-loop wheel position tracking from opto-fork edges.
+//
+
+#ifndef PILLDISPENSER_OBSERVER_H
+#define PILLDISPENSER_OBSERVER_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "pico/types.h"
+
+typedef enum {
+    OBSERVER_OK, // no edge expected, or edges where calibration put them
+    OBSERVER_CORRECTED, // small slip, home position shifted to match the wheel
+    OBSERVER_LOST // stall or slip beyond the threshold, full calibration needed
+} ObserverResult;
+
+#define OBSERVER_TOLERANCE_STEPS 3 // edge jitter we accept without correcting
+#define OBSERVER_MAX_CORRECTION_STEPS 64 // beyond this the position is not trusted
+#define OBSERVER_MAX_EDGES 8 // edges captured per move
+
+typedef struct {
+    int32_t position;
+    bool level; // sensor level after the edge, 0 = inside the gap
+} OptoEdge;
+
+// one observer per wheel, wheel N is turned by motor N
+void observer_gpio_handler(uint gpio, uint32_t events);
+void observer_learn(uint wheel, int32_t home_position, uint32_t steps_per_revolution, uint32_t gap_width);
+void observer_forget(uint wheel);
+bool observer_is_valid(uint wheel);
+int32_t observer_get_home_position(uint wheel);
+void observer_set_home_position(uint wheel, int32_t home);
+uint32_t observer_get_gap_width(uint wheel);
+bool observer_level_matches(uint wheel, int32_t position, bool level);
+int32_t observer_get_last_error(uint wheel);
+
+void observer_begin_move(uint wheel, int direction);
+ObserverResult observer_end_move(uint wheel);
+uint8_t observer_get_edges(uint wheel, OptoEdge *out, uint8_t max_edges);
+
+#endif //PILLDISPENSER_OBSERVER_H
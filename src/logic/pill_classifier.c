@@ -0,0 +1,60 @@
+#include "pill_classifier.h"
+
+// one pass over the trace, integer maths only
+void pill_classifier_extract(const uint16_t *samples, uint32_t count, PillFeatures *features) {
+    PillFeatures f = {0};
+    uint32_t baseline_count = count < PILL_BASELINE_SAMPLES ? count : PILL_BASELINE_SAMPLES;
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < baseline_count; i++) {
+        sum += samples[i];
+    }
+    f.baseline = baseline_count > 0 ? (uint16_t)(sum / baseline_count) : 0;
+
+    bool is_in_burst = false;
+    uint16_t burst_peak = 0;
+    uint32_t quiet = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        int32_t d = (int32_t)samples[i] - f.baseline;
+        uint16_t deviation = (uint16_t)(d < 0 ? -d : d);
+        if (deviation > f.peak) f.peak = deviation;
+        if (deviation < PILL_ACTIVE_THRESHOLD) {
+            // a burst ends after enough quiet samples, only strong ones count as impacts
+            if (is_in_burst && ++quiet >= PILL_BURST_GAP_SAMPLES) {
+                if (burst_peak >= PILL_MIN_PEAK && f.bursts < UINT8_MAX) f.bursts++;
+                is_in_burst = false;
+            }
+            continue;
+        }
+        if (!is_in_burst) {
+            is_in_burst = true;
+            burst_peak = 0;
+            if (f.duration == 0) f.first_active = (uint16_t)i;
+        }
+        quiet = 0;
+        if (deviation > burst_peak) burst_peak = deviation;
+        f.last_active = (uint16_t)i;
+        if (f.duration < UINT16_MAX) f.duration++;
+        f.energy += ((uint32_t)deviation * deviation) >> PILL_ENERGY_SHIFT;
+    }
+    if (is_in_burst && burst_peak >= PILL_MIN_PEAK && f.bursts < UINT8_MAX) f.bursts++;
+    *features = f;
+}
+
+PillClass pill_classifier_classify(const PillFeatures *f) {
+    if (f->duration == 0) return PILL_CLASS_NONE;
+    if (f->peak < PILL_MIN_PEAK || f->duration < PILL_MIN_DURATION || f->duration > PILL_MAX_DURATION) {
+        return PILL_CLASS_NOISE;
+    }
+    if (f->bursts >= 2 || f->energy > PILL_DOUBLE_ENERGY) return PILL_CLASS_DOUBLE;
+    return PILL_CLASS_SINGLE;
+}
+
+const char *pill_class_name(PillClass pill_class) {
+    switch (pill_class) {
+        case PILL_CLASS_NONE: return "none";
+        case PILL_CLASS_NOISE: return "noise";
+        case PILL_CLASS_SINGLE: return "single";
+        case PILL_CLASS_DOUBLE: return "double";
+    }
+    return "?";
+}
@@ -0,0 +1,42 @@
+//
+// Fixed-point piezo trace features and pill / double drop / noise classification.
+// Plain C without SDK headers, so recorded traces can be replayed on a PC.
+//
+
+#ifndef PILLDISPENSER_PILL_CLASSIFIER_H
+#define PILLDISPENSER_PILL_CLASSIFIER_H
+#include <stdbool.h>
+#include <stdint.h>
+
+// thresholds are in 12 bit ADC counts and samples at PIEZO_CAPTURE_SAMPLE_HZ (8 kHz)
+#define PILL_BASELINE_SAMPLES 32 // resting level, taken before the trigger
+#define PILL_ACTIVE_THRESHOLD 120 // deviation from the baseline that counts as movement
+#define PILL_BURST_GAP_SAMPLES 40 // 5 ms quiet ends an impact
+#define PILL_MIN_PEAK 600 // a pill hits harder than motor vibration
+#define PILL_MIN_DURATION 8 // 1 ms, shorter spikes are electrical
+#define PILL_MAX_DURATION 800 // 100 ms of movement is the table shaking, not a pill
+#define PILL_ENERGY_SHIFT 6 // squared deviations are scaled down to fit 32 bits
+#define PILL_DOUBLE_ENERGY 600000 // two pills landing together in one burst
+
+typedef enum {
+    PILL_CLASS_NONE, // nothing above the threshold
+    PILL_CLASS_NOISE, // movement, but not a pill
+    PILL_CLASS_SINGLE,
+    PILL_CLASS_DOUBLE
+} PillClass;
+
+typedef struct {
+    uint16_t baseline;
+    uint16_t peak; // largest deviation from the baseline
+    uint32_t energy; // sum of squared deviations of the active samples >> PILL_ENERGY_SHIFT
+    uint16_t duration; // active samples
+    uint8_t bursts; // impacts reaching PILL_MIN_PEAK, separated by PILL_BURST_GAP_SAMPLES
+    uint16_t first_active; // sample index, for trimming trace dumps
+    uint16_t last_active;
+} PillFeatures;
+
+void pill_classifier_extract(const uint16_t *samples, uint32_t count, PillFeatures *features);
+PillClass pill_classifier_classify(const PillFeatures *features);
+const char *pill_class_name(PillClass pill_class);
+
+#endif //PILLDISPENSER_PILL_CLASSIFIER_H
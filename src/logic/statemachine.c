@@ -10,6 +10,8 @@
 #include "encoder&button.h"
 #include "lora.h"
 #include "dispenser.h"
+#include "observer.h"
+#include "eeprom_writer.h"
 #include "hardware/structs/vreg_and_chip_reset.h"
 
 typedef enum {
@@ -39,6 +41,7 @@ static bool is_reset_button_event = false;
 void statemachine_gpio_callback(uint gpio, uint32_t events) {
     encoder_gpio_handler(gpio, events);
     piezo_irq_handler(gpio, events);
+    observer_gpio_handler(gpio, events);
 }
 
 static void change_state(AppState_t new_state) {
@@ -47,9 +50,18 @@ static void change_state(AppState_t new_state) {
     oled_clear();
 }
 
+// the pill counter in the big digits across pages 2 to 5, a fixed 5 characters so
+// a count or period that gets shorter leaves nothing behind
+static void show_pill_count(int count, int period) {
+    char buf[8];
+    snprintf(buf, sizeof(buf), "%2d/%-2d", count, period);
+    oled_show_big_string((OLED_WIDTH - 5 * 16) / 2, 2, buf);
+}
+
 // sleep that keeps lora alive
 // the function make sure Lora would not block
 void sleep_ms_with_lora(uint32_t ms) {
+    oled_flush(); // the screen shows what was drawn before the wait
     uint32_t end_time = to_ms_since_boot(get_absolute_time()) + ms;
     while (to_ms_since_boot(get_absolute_time()) < end_time) {
         if (is_lora_enabled && lora_get_status() != LORA_STATUS_FAILED) {
@@ -100,6 +112,17 @@ void statemachine_init(void) {
     state_enter_time = to_ms_since_boot(get_absolute_time());
 }
 
+// one letter commands on the stdio uart for service: 'e' streams the whole EEPROM for
+// tools/log_decode.c, 'l' prints the event log
+static void service_command_poll() {
+    int command = getchar_timeout_us(0);
+    if (command == 'e') {
+        eeprom_export();
+    } else if (command == 'l') {
+        log_read_all();
+    }
+}
+
 void statemachine_loop(void) {
     // try at the first no matter user choose or not
     if (is_lora_enabled) {
@@ -126,6 +149,7 @@ void statemachine_loop(void) {
         }
     }
     led_blink_task();
+    service_command_poll();
 
     int rot = get_encoder_rotation();
     bool is_encoder_pressed = is_encoder_button_pressed();
@@ -188,6 +212,7 @@ void statemachine_loop(void) {
                 oled_show_string(0, 2, "Success!");
                 oled_show_string(0, 4, "LoRa Online");
                 led_set_mode(LED_ALL_ON);
+                oled_flush();
                 sleep_ms(PAGE_TIMEOUT);
                 change_state(STATE_MAIN_MENU);
             }
@@ -198,6 +223,7 @@ void statemachine_loop(void) {
                 oled_show_string(0, 4, "Go Offline Mode");
 
                 is_lora_enabled = false;
+                oled_flush();
                 sleep_ms(PAGE_TIMEOUT);
                 change_state(STATE_MAIN_MENU);
             }
@@ -208,7 +234,7 @@ void statemachine_loop(void) {
                 oled_show_string(0, 4, "Go Offline Mode");
 
                 is_lora_enabled = false;
-
+                oled_flush();
                 sleep_ms(PAGE_TIMEOUT);
                 change_state(STATE_MAIN_MENU);
             }
@@ -230,9 +256,10 @@ void statemachine_loop(void) {
                 else if (menu_index < 0) menu_index = 1;
             }
 
-            oled_show_string(10, 0, "Main menu");
-            oled_show_string(10, 2, menu_index == 0 ? "> Get Pills " : "  Get Pills   ");
-            oled_show_string(10, 4, menu_index == 1 ? "> Set Dose  " : "  Set Dose    ");
+            // on the text cells, an unchanged line costs a compare per character
+            oled_show_string(8, 0, "Main menu");
+            oled_show_string(8, 2, menu_index == 0 ? "> Get Pills " : "  Get Pills   ");
+            oled_show_string(8, 4, menu_index == 1 ? "> Set Dose  " : "  Set Dose    ");
 
 
             if (is_encoder_pressed) {
@@ -262,13 +289,17 @@ void statemachine_loop(void) {
             }
 
             if (setting_period != last_drawn_period) {
-                oled_clear();
-                oled_show_string(0, 0, "Set Period");
-                oled_show_string(0, 4, "Max 7 days");
-                oled_show_string(0, 6, "SW0- SW2+ Y->");
+                if (last_drawn_period < 0) {
+                    oled_show_string(0, 0, "Set Period");
+                    char max_buf[16];
+                    sprintf(max_buf, "Max %d days", MAX_PERIOD);
+                    oled_show_string(0, 4, max_buf);
+                    oled_show_string(0, 6, "SW0- SW2+ Y->");
+                }
 
+                // padded, the text cells only redraw the digits that changed
                 char buf[16];
-                sprintf(buf, "%d", setting_period);
+                sprintf(buf, "%-3d", setting_period);
                 oled_show_string(0, 2, buf);
                 last_drawn_period = setting_period;
             }
@@ -297,8 +328,9 @@ void statemachine_loop(void) {
                         oled_show_string(0, 6, "Keep Hands Away");
 
                         for (int i = POWER_ON_WARNING_TIME / 1000; i > 0; i--) {
-                            char count_buf[16];
-                            sprintf(count_buf, "in %d seconds...", i);
+                            // one digit is a character shorter, the space covers the last dot of 10
+                            char count_buf[20];
+                            sprintf(count_buf, "in %d seconds...%s", i, i < 10 ? " " : "");
                             oled_show_string(0, 4, count_buf);
 
                             leds_set_brightness(BRIGHTNESS_ERROR_OCCUR);
@@ -374,6 +406,7 @@ void statemachine_loop(void) {
                 led_set_mode(LED_BLINKING);
                 if (!is_calibrated_dispenser()) {
                     oled_show_string(0, 4, "Calibrating...");
+                    oled_flush();
                     dispenser_calibration();
                 } else {
                     if (is_recovery_mode) {
@@ -383,6 +416,7 @@ void statemachine_loop(void) {
                         oled_show_string(0, 2, "Re-calibration");
                         oled_show_string(0, 4, "Need More Pills");
                     }
+                    oled_flush();
                     dispenser_recalibrate_from_poweroff();
                     dispenser_clear_boot_flag();
                     sleep_ms(PAGE_TIMEOUT);
@@ -416,15 +450,14 @@ void statemachine_loop(void) {
             if (is_state_changed) {
                 oled_show_string(0, 0, "Dispensing...");
                 setting_period = dispenser_get_period();
-                char buf[16];
                 // get it from eeprom
                 int success_pill_count = dispenser_get_dispensed_count();
                 int failure_pill_count = 0;
                 // we set a separate variable considering the empty compartments occurs
                 int total_pills_need = setting_period;
 
-                sprintf(buf,"PILL: %d/%d",success_pill_count,setting_period);
-                oled_show_string(0, 4, buf);
+                show_pill_count(success_pill_count, setting_period);
+                oled_flush();
                 // the task will finish only when the user get enough pills
                 while (success_pill_count<total_pills_need) {
                     if (!is_calibrated_dispenser()) {
@@ -433,8 +466,7 @@ void statemachine_loop(void) {
                     bool result = do_dispense_single_round();
                     if (result) {
                         success_pill_count++;
-                        sprintf(buf, "PILL: %d/%d", success_pill_count, setting_period);
-                        oled_show_string(0, 4, buf);
+                        show_pill_count(success_pill_count, setting_period);
                         // show a warning when the next days is the last day in the period
                         int dispensed = dispenser_get_dispensed_count();
                         if (dispensed == total_pills_need -1) {
@@ -443,11 +475,13 @@ void statemachine_loop(void) {
                         // Doubt should give the pill first they enter or wait for one round first.
                         sleep_ms_with_lora(PILL_DISPENSE_INTERVAL);
                         oled_show_string(0, 6, "                ");
+                        oled_flush();
 
                     }else {
                         failure_pill_count++;
                         // allow 7 times retry
                         if (failure_pill_count>= MAX_DISPENSE_RETRIES) {
+                            log_write_event(LOG_EVENT_DISPENSE_ABORTED, LOG_NO_WHEEL, failure_pill_count, 0);
                             change_state(STATE_FAULT_CHECK);
                             return;
                         }
@@ -455,6 +489,7 @@ void statemachine_loop(void) {
                         // we do this buz when power off, application automatically recover LoRa connection
                         sleep_ms_with_lora(PILL_DISPENSE_INTERVAL);
                         oled_show_string(0, 6, "                ");
+                        oled_flush();
                     }
                 }
 
@@ -463,8 +498,13 @@ void statemachine_loop(void) {
                     lora_send_message("EMPTY");
                 }
 
-                oled_show_string(0, 4, "Finished!             ");
+                oled_show_string(0, 6, "Finished!       ");
+                // real drop times of this period, to tune PILL_FALL_TIMEOUT_MS
+                dispenser_report_drop_latency();
+                eeprom_writer_report();
+                oled_report();
                 is_recovery_mode = false;
+                oled_flush();
                 sleep_ms(PAGE_TIMEOUT);
                 change_state(STATE_MAIN_MENU);
             }
@@ -30,7 +30,7 @@ static void system_init() {
     statemachine_init();
     oled_init();
     oled_init_minimal();
-    oled_clear();
+    oled_invalidate(); // GDDRAM holds noise after power on, the first frame clears it
     printf("[User] System Init.\n");
 }
 
@@ -40,6 +40,7 @@ int main() {
 
     while (true) {
         statemachine_loop();
+        oled_commit(); // what the state machine drew in this tick, sent by dma
         watchdog_update();
         sleep_ms(20);
     }
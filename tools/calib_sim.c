@@ -0,0 +1,263 @@
+// Runs the firmware's two wheel calibrations on a PC against the RP2040 and stepper models in
+// tools/sim: fast_calibration(), one revolution plus the gap in the background with the opto
+// edges stamped by irq, and multi_round_calibration(), CALIBRATION_ROUNDS blocking revolutions
+// of gap search.
+//
+// build: cc -std=gnu11 -Isrc -Isrc/drivers -Isrc/logic -Itools/sim -o calib_sim tools/calib_sim.c
+//            tools/sim/clock.c tools/sim/rp2040.c tools/sim/i2c_hal_linux.c tools/sim/stepper_wheel.c
+//            src/drivers/motor.c src/drivers/sensor.c src/logic/observer.c src/logic/pill_classifier.c -lm
+// run:   ./calib_sim 10
+//        ./calib_sim slots
+//
+// each run starts the wheel at a random angle and calibrates it both ways from there. the fork
+// edges come up to SIM_EDGE_JITTER half-steps early or late. per method it prints the simulated
+// time, the steps/rev error against the wheel's 4075.77, how far from the gap centre the wheel
+// stopped and the most it turned in one calibration, in revolutions both ways. a failed fast
+// calibration counts with the rounds it falls back to.
+// slots checks slot_position() over every slot of a revolution and every 24.8 steps/rev up to
+// SLOTS_MAX_SPR against the float planner it replaced and against exact rounding, and counts
+// the soft-float calls that planner made on the RP2040, which has no FPU.
+// the firmware's own prints go to /dev/null, -v keeps them.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pico/stdlib.h"
+#include "config.h"
+#include "motor.h"
+#include "sensor.h"
+#include "observer.h"
+#include "sim.h"
+
+// the calibrations are static in dispenser.c, the scenario is built into it
+#include "logic/dispenser.c"
+
+#define SIM_EDGE_JITTER 1.0 // half-steps
+
+// what dispenser.c needs from the parts of the firmware not built here
+void sleep_ms_with_lora(uint32_t ms) { sleep_ms(ms); }
+void eeprom_init() {}
+bool eeprom_writer_flush() { return true; }
+void log_write_event(uint8_t event, uint8_t wheel, uint16_t arg0, uint16_t arg1) {
+    (void)event;
+    (void)wheel;
+    (void)arg0;
+    (void)arg1;
+}
+void save_dispenser_state_to_eeprom(DispenserState *state) { (void)state; }
+bool load_dispenser_state_from_eeprom(DispenserState *state) { (void)state; return false; }
+void save_wheel_journal(uint8_t wheel, WheelJournal *journal) { (void)wheel; (void)journal; }
+bool load_wheel_journal(uint8_t wheel, WheelJournal *journal) { (void)wheel; (void)journal; return false; }
+bool lora_send_message(const char *msg) { (void)msg; return false; }
+void piezo_capture_init() {}
+bool piezo_capture_is_adc_pin(uint gpio) { (void)gpio; return false; }
+bool piezo_capture_start(uint32_t gpio_mask) { (void)gpio_mask; return false; }
+void piezo_capture_stop() {}
+uint32_t piezo_capture_read(uint gpio, uint64_t since_us, uint16_t *out, uint32_t max_samples) {
+    (void)gpio;
+    (void)since_us;
+    (void)out;
+    (void)max_samples;
+    return 0;
+}
+
+// wheel 0 as it is built: the gearbox is 63.68:1, so a revolution is no whole number of half-steps
+static const SimWheelConfig wheel_config = {
+    .motor_pins = { WHEEL0_MOTOR_PINS },
+    .opto_pin = OPTO_SENSOR_PIN,
+    .half_steps_per_revolution = 4075.7728,
+    .gap_start = 1000,
+    .gap_width = 80,
+    .edge_jitter = SIM_EDGE_JITTER,
+};
+
+// as statemachine_gpio_callback() hands the edges out
+static void gpio_callback(uint gpio, uint32_t events) {
+    piezo_irq_handler(gpio, events);
+    observer_gpio_handler(gpio, events);
+}
+
+typedef struct {
+    const char *name;
+    uint32_t runs;
+    uint32_t fallbacks;
+    double ms;
+    double max_ms;
+    double spr_error; // absolute, summed over the runs
+    double max_spr_error;
+    double centre; // absolute, summed over the runs
+    double max_centre;
+    double gap_error; // absolute, summed over the runs
+    double max_turn; // revolutions, both ways
+} MethodStats;
+
+static void run(MethodStats *m, bool is_fast) {
+    wheel_defaults(&wheels[0]);
+    uint64_t start_ns = sim_time_ns();
+    uint64_t start_steps = sim_wheel_get_stats(0)->half_steps;
+    int gap_width = 0;
+    bool is_done = is_fast && fast_calibration(0, &gap_width);
+    if (!is_done) {
+        if (is_fast) m->fallbacks++;
+        multi_round_calibration(0, &gap_width);
+    }
+    double ms = (sim_time_ns() - start_ns) / 1e6;
+    double spr_error = fabs((double)wheels[0].step_per_revolution_q8 / (1u << SPR_Q8_SHIFT) -
+                            wheel_config.half_steps_per_revolution);
+    double centre = fabs(sim_wheel_from_gap_centre(0));
+    double turn = (sim_wheel_get_stats(0)->half_steps - start_steps) / wheel_config.half_steps_per_revolution;
+    m->runs++;
+    m->ms += ms;
+    m->spr_error += spr_error;
+    m->centre += centre;
+    m->gap_error += fabs(gap_width - wheel_config.gap_width);
+    if (ms > m->max_ms) m->max_ms = ms;
+    if (spr_error > m->max_spr_error) m->max_spr_error = spr_error;
+    if (centre > m->max_centre) m->max_centre = centre;
+    if (turn > m->max_turn) m->max_turn = turn;
+}
+
+// somewhere else on the wheel, in the background at cruise speed
+static void turn_randomly() {
+    motor_set_drive_mode(0, MOTOR_DRIVE_HALF);
+    motor_move_async(0, (uint32_t)(rand() % (int)wheel_config.half_steps_per_revolution), DEFAULT_DISPENSER_ROTATED_DIRECTION);
+    while (motor_is_busy(0)) tight_loop_contents();
+    motor_stop(0);
+}
+
+// the steps/rev slots covers, a wheel of 4 times the 28BYJ-48 revolution
+#define SLOTS_MAX_SPR 16384u
+
+// the planner before the fixed point one, with spr kept as a float. on the RP2040 every slot
+// was __aeabi_i2f, __aeabi_fmul, __aeabi_fdiv, __aeabi_fadd and __aeabi_f2iz from the bootrom.
+#define FLOAT_SLOT_CALLS 5
+static int32_t float_slot_position(float spr, int32_t slot) {
+    return (int32_t)(slot * spr / (float)COMPARTMENTS_PER_WHEEL + 0.5f);
+}
+
+static double now_host_ns() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static int slots() {
+    observer_set_home_position(0, 0);
+    uint64_t positions = 0;
+    uint64_t float_mismatches = 0;
+    uint32_t first_float_mismatch = 0; // spr_q8
+    uint32_t exact_mismatches = 0;
+    uint32_t open_revolutions = 0;
+    int32_t max_drift = 0; // of rounding each compartment on its own and adding them up
+    for (uint32_t spr_q8 = 1; spr_q8 <= SLOTS_MAX_SPR << SPR_Q8_SHIFT; spr_q8++) {
+        wheels[0].step_per_revolution_q8 = spr_q8;
+        float spr = (float)spr_q8 / (1u << SPR_Q8_SHIFT);
+        int32_t per_round = float_slot_position(spr, 1);
+        for (int32_t slot = 0; slot <= COMPARTMENTS_PER_WHEEL; slot++) {
+            int32_t fixed = slot_position(0, slot);
+            // round(slot * spr / compartments), half up, from the exact fraction
+            uint64_t numerator = (uint64_t)slot * spr_q8;
+            uint64_t denominator = (uint64_t)COMPARTMENTS_PER_WHEEL << SPR_Q8_SHIFT;
+            int32_t exact = (int32_t)((2 * numerator + denominator) / (2 * denominator));
+            if (fixed != exact) exact_mismatches++;
+            if (fixed != float_slot_position(spr, slot)) {
+                if (!float_mismatches++) first_float_mismatch = spr_q8;
+            }
+            int32_t drift = abs(slot * per_round - fixed);
+            if (drift > max_drift) max_drift = drift;
+            positions++;
+        }
+        // a whole revolution of compartments is a whole revolution of the wheel
+        if (slot_position(0, COMPARTMENTS_PER_WHEEL) != (int32_t)spr_whole_steps(0)) open_revolutions++;
+    }
+
+    // the same positions again, timed
+    volatile int32_t sink = 0;
+    double start_ns = now_host_ns();
+    for (uint32_t spr_q8 = 1; spr_q8 <= SLOTS_MAX_SPR << SPR_Q8_SHIFT; spr_q8++) {
+        wheels[0].step_per_revolution_q8 = spr_q8;
+        for (int32_t slot = 0; slot <= COMPARTMENTS_PER_WHEEL; slot++) sink = slot_position(0, slot);
+    }
+    double fixed_ns = now_host_ns() - start_ns;
+    start_ns = now_host_ns();
+    for (uint32_t spr_q8 = 1; spr_q8 <= SLOTS_MAX_SPR << SPR_Q8_SHIFT; spr_q8++) {
+        float spr = (float)spr_q8 / (1u << SPR_Q8_SHIFT);
+        for (int32_t slot = 0; slot <= COMPARTMENTS_PER_WHEEL; slot++) sink = float_slot_position(spr, slot);
+    }
+    double float_ns = now_host_ns() - start_ns;
+    (void)sink;
+    uint32_t overflow_spr = UINT32_MAX / COMPARTMENTS_PER_WHEEL >> SPR_Q8_SHIFT;
+    fprintf(stderr, "%llu slot positions, %u compartments, steps/rev 1/256 to %u in 1/256 steps\n",
+            (unsigned long long)positions, COMPARTMENTS_PER_WHEEL, SLOTS_MAX_SPR);
+    fprintf(stderr, "fixed point against exact rounding: %u differ\n", exact_mismatches);
+    fprintf(stderr, "fixed point against the float planner: %llu differ", (unsigned long long)float_mismatches);
+    if (float_mismatches) {
+        fprintf(stderr, ", the first at %u.%02u steps/rev where float runs out of mantissa",
+                first_float_mismatch >> SPR_Q8_SHIFT, ((first_float_mismatch & 0xFFu) * 100) >> SPR_Q8_SHIFT);
+    }
+    fprintf(stderr, "\nrevolutions that do not close: %u\n", open_revolutions);
+    fprintf(stderr, "rounding each compartment instead: up to %ld half-steps off by the end of a revolution\n",
+            (long)max_drift);
+    fprintf(stderr, "soft-float calls per slot: %d before, 0 now; %u steps/rev before slot * spr overflows\n",
+            FLOAT_SLOT_CALLS, overflow_spr);
+    fprintf(stderr, "host, which has an FPU: %.1f ns a slot fixed point, %.1f ns float\n",
+            fixed_ns / positions, float_ns / positions);
+    bool is_ok = !exact_mismatches && !open_revolutions;
+    fprintf(stderr, "%s\n", is_ok ? "all slots ok" : "FAILED");
+    return is_ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    bool is_verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+    if (is_verbose) {
+        argc--;
+        argv++;
+    }
+    bool is_slots = argc == 2 && strcmp(argv[1], "slots") == 0;
+    long runs = argc == 2 ? strtol(argv[1], NULL, 10) : 0;
+    if (runs <= 0 && !is_slots) {
+        fprintf(stderr, "usage: calib_sim [-v] runs|slots\n");
+        return 2;
+    }
+    if (!is_verbose) freopen("/dev/null", "w", stdout);
+    if (is_slots) return slots();
+    srand(1);
+    sim_wheel_attach(0, &wheel_config);
+    set_motor_pins();
+    sensor_init();
+    gpio_set_irq_callback(gpio_callback);
+
+    MethodStats methods[2] = { { .name = "fast" }, { .name = "rounds" } };
+    for (long i = 0; i < runs; i++) {
+        // both from the same angle
+        turn_randomly();
+        int32_t start = motor_get_position(0);
+        double rotor = sim_wheel_position(0);
+        run(&methods[0], true);
+        motor_move_async(0, (uint32_t)abs(motor_get_position(0) - start),
+                         motor_get_position(0) > start ? DISPENSER_BACK_DIRECTION : DEFAULT_DISPENSER_ROTATED_DIRECTION);
+        while (motor_is_busy(0)) tight_loop_contents();
+        motor_stop(0);
+        if (sim_wheel_position(0) != rotor) {
+            fprintf(stderr, "FAIL run %ld: the rotor did not follow the motor\n", i);
+            return 1;
+        }
+        run(&methods[1], false);
+    }
+
+    fprintf(stderr, "%ld runs, %.4f half-steps a revolution, gap %.0f, edges +-%.1f\n", runs,
+            wheel_config.half_steps_per_revolution, wheel_config.gap_width, SIM_EDGE_JITTER);
+    fprintf(stderr, "%-7s %8s %8s %10s %12s %12s %11s %11s %10s %9s\n", "method", "avg s", "max s", "fallbacks",
+            "avg spr err", "max spr err", "avg centre", "max centre", "gap err", "max rev");
+    for (int i = 0; i < 2; i++) {
+        const MethodStats *m = &methods[i];
+        fprintf(stderr, "%-7s %8.2f %8.2f %10u %12.2f %12.2f %11.2f %11.2f %10.2f %9.2f\n", m->name, m->ms / 1e3 / m->runs,
+                m->max_ms / 1e3, m->fallbacks, m->spr_error / m->runs, m->max_spr_error, m->centre / m->runs,
+                m->max_centre, m->gap_error / m->runs, m->max_turn);
+    }
+    fprintf(stderr, "fast is %.1fx quicker, %llu stalls\n", methods[1].ms / methods[0].ms,
+            (unsigned long long)sim_wheel_get_stats(0)->stalls);
+    return 0;
+}
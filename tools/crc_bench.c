@@ -0,0 +1,117 @@
+// Checks the table-driven crc16() of src/drivers/crc16.c against the shift and xor version it
+// replaced and a bit at a time reference, over random buffers of random length, then times all
+// three and crc16_verify_many() on the PC. The PC only gives the ratio, the RP2040 runs the
+// table from RAM.
+//
+// build: cc -std=gnu11 -O2 -Isrc/drivers -o crc_bench tools/crc_bench.c src/drivers/crc16.c
+// run:   ./crc_bench [buffers]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "crc16.h"
+#include "eeprom.h"
+
+#define MAX_BUFFER 1024
+#define BENCH_BYTES (64u * 1024 * 1024)
+
+// the firmware's crc16() before the table, four shifts per byte
+static uint16_t crc16_shift(const uint8_t *data_p, size_t length) {
+    uint8_t x;
+    uint16_t crc = 0xFFFF;
+    while (length--) {
+        x = crc >> 8 ^ *data_p++;
+        x ^= x >> 4;
+        crc = (crc << 8) ^ (uint16_t)(x << 12) ^ (uint16_t)(x << 5) ^ (uint16_t)x;
+    }
+    return crc;
+}
+
+// CRC-16/CCITT as the polynomial division is written down, one bit at a time
+static uint16_t crc16_bitwise(const uint8_t *data_p, size_t length) {
+    uint16_t crc = 0xFFFF;
+    while (length--) {
+        crc ^= (uint16_t)(*data_p++ << 8);
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static double wall_s() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static volatile uint16_t sink; // keeps the timed loops from being optimised away
+
+static double bench(const char *name, uint16_t (*crc)(const uint8_t *, size_t), const uint8_t *data,
+                    size_t length) {
+    double start_s = wall_s();
+    for (size_t done = 0; done < BENCH_BYTES; done += length) sink ^= crc(data, length);
+    double mb_s = BENCH_BYTES / (wall_s() - start_s) / 1e6;
+    printf("%-10s %5zu byte buffers: %8.1f MB/s\n", name, length, mb_s);
+    return mb_s;
+}
+
+int main(int argc, char **argv) {
+    long buffers = argc > 1 ? strtol(argv[1], NULL, 10) : 100000;
+    static uint8_t data[MAX_BUFFER];
+    srand(1);
+
+    // 1. the same crc for every buffer, the check value of the catalogue first
+    const uint8_t check[] = "123456789";
+    if (crc16(check, 9) != 0x29B1 || crc16_shift(check, 9) != 0x29B1 || crc16_bitwise(check, 9) != 0x29B1) {
+        printf("check value of \"123456789\" is not 0x29B1\n");
+        return 1;
+    }
+    long mismatches = 0;
+    for (long i = 0; i < buffers; i++) {
+        size_t length = (size_t)rand() % (MAX_BUFFER + 1);
+        for (size_t j = 0; j < length; j++) data[j] = (uint8_t)rand();
+        uint16_t reference = crc16_bitwise(data, length);
+        if (crc16(data, length) != reference || crc16_shift(data, length) != reference) {
+            if (mismatches++ < 10) printf("mismatch in buffer %ld, %zu bytes\n", i, length);
+        }
+    }
+
+    // 2. a log page with some records torn, as log_read_cached() checks it
+    uint8_t page[LOG_RECORDS_PER_PAGE * LOG_RECORD_SIZE];
+    uint32_t expected_mask = 0;
+    for (int r = 0; r < LOG_RECORDS_PER_PAGE; r++) {
+        uint8_t *record = &page[r * LOG_RECORD_SIZE];
+        for (int j = 0; j < LOG_RECORD_SIZE - 2; j++) record[j] = (uint8_t)rand();
+        uint16_t crc = crc16_bitwise(record, LOG_RECORD_SIZE - 2);
+        record[LOG_RECORD_SIZE - 2] = (uint8_t)(crc & 0xFF);
+        record[LOG_RECORD_SIZE - 1] = (uint8_t)(crc >> 8);
+        if (r % 3 == 1) record[r % (LOG_RECORD_SIZE - 2)] ^= 0x10;
+        else expected_mask |= 1u << r;
+    }
+    uint32_t mask = 0;
+    crc16_verify_many(page, LOG_RECORD_SIZE, LOG_RECORDS_PER_PAGE, &mask);
+    if (mask != expected_mask) {
+        printf("crc16_verify_many: mask 0x%02X, 0x%02X expected\n", mask, expected_mask);
+        mismatches++;
+    }
+    printf("%ld random buffers up to %d bytes: %ld mismatches\n", buffers, MAX_BUFFER, mismatches);
+
+    // 3. throughput on a record, a state slot and the largest buffer
+    const size_t lengths[] = { LOG_RECORD_SIZE - 2, STATE_SLOT_SIZE, MAX_BUFFER };
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        double bitwise = bench("bitwise", crc16_bitwise, data, lengths[i]);
+        double shift = bench("shift", crc16_shift, data, lengths[i]);
+        double table = bench("table", crc16, data, lengths[i]);
+        printf("%-10s %5zu byte buffers: table %.1fx shift, %.1fx bitwise\n", "", lengths[i],
+               table / shift, table / bitwise);
+    }
+    double start_s = wall_s();
+    uint32_t pages = BENCH_BYTES / sizeof(page);
+    for (uint32_t i = 0; i < pages; i++) {
+        sink ^= (uint16_t)crc16_verify_many(page, LOG_RECORD_SIZE, LOG_RECORDS_PER_PAGE, &mask);
+    }
+    printf("verify_many: %.0f log pages/s\n", pages / (wall_s() - start_s));
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,555 @@
+// Runs the firmware's eeprom.c on a PC against the AT24C256 model in tools/sim, through
+// i2c_hal_linux.c, to benchmark the log and state storage, count what it costs on the bus and
+// cut the power under it. The writes go through the blocking eeprom_writer_sync.c there, not
+// the DMA writer.
+//
+// build: cc -std=gnu11 -Isrc -Isrc/drivers -Itools/sim -o eeprom_sim tools/eeprom_sim.c tools/sim/*.c
+//            src/drivers/eeprom.c src/drivers/log_record.c src/drivers/crc16.c
+// run:   ./eeprom_sim image.bin bench 20000
+//        ./eeprom_sim image.bin powercut 1000
+//        ./eeprom_sim image.bin headfind 6
+//        ./eeprom_sim image.bin trace 1
+//        ./eeprom_sim image.bin wear 1000
+//        ./eeprom_sim image.bin torn 100
+//        ./eeprom_sim image.bin replay 100
+//        ./eeprom_sim image.bin export 640 > stream.bin
+//
+// image.bin is the 32 KB part, a new file starts erased. It can be read with log_decode.
+// bench times that many dispenses on the PC and counts their bus cost. powercut boots that many
+// times in a fork each, checks the count against the last finished dispense and cuts the power
+// at a random simulated time. headfind erases it first and fills the log in that many steps. trace prints every bus transfer
+// of that many dispenses, page writes and their ACK polls. wear counts the page writes of the
+// state slots, the log and the wheel journal over that many dispenses. torn tears the newest
+// state slot after a random number of dispenses, that many times, and checks the next boot.
+// replay boots that many times on one part, with dispenses, log erases and cut intents between,
+// and checks the state each boot rebuilds from the checkpoint and the log. export makes that
+// many dispenses and streams the part as eeprom_export() does on the uart, to stdout, for
+// log_decode --export stream.bin.
+// the firmware's own prints go to /dev/null, -v keeps them.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "crc16.h"
+#include "eeprom.h"
+#include "eeprom_writer.h"
+#include "i2c_hal.h"
+#include "log_record.h"
+#include "sim.h"
+
+#define SIM_PERIOD 200 // pills per treatment in the simulated dispenses
+
+static DispenserState state;
+static int32_t wheel_slot; // compartment the simulated wheel is at
+
+static void first_state() {
+    memset(&state, 0, sizeof(state));
+    state.wheels[0].step_per_revolution_q8 = 4096u << SPR_Q8_SHIFT;
+    state.wheels[0].pill_treatment_period = SIM_PERIOD;
+    state.wheels[0].flags = WHEEL_STATE_CALIBRATED;
+    save_dispenser_state_to_eeprom(&state);
+}
+
+static void boot() {
+    eeprom_init();
+    if (!load_dispenser_state_from_eeprom(&state)) first_state();
+    WheelJournal journal;
+    wheel_slot = load_wheel_journal(0, &journal) ? journal.wheel_slot : 0;
+}
+
+// the wheel field as dispenser.c fills it
+static uint8_t log_wheel(uint wheel) {
+    return WHEEL_COUNT > 1 ? (uint8_t)wheel : LOG_NO_WHEEL;
+}
+
+// the wheel as journal_wheel() writes it at rest in its compartment
+static void journal_wheel() {
+    WheelJournal journal;
+    memset(&journal, 0, sizeof(journal));
+    journal.coil_phase = (uint8_t)(wheel_slot & 7);
+    journal.flags = WHEEL_JOURNAL_TRACKED;
+    journal.offset_from_home = wheel_slot * 512;
+    journal.target_from_home = wheel_slot * 512;
+    journal.wheel_slot = (int16_t)wheel_slot;
+    journal.gap_width = 80;
+    save_wheel_journal(0, &journal);
+}
+
+// the intent dispense_batch() writes before the move, the state save that writes nothing
+static void dispense_start() {
+    WheelState *wheel = &state.wheels[0];
+    wheel->flags |= WHEEL_STATE_MOTOR_RUNNING;
+    wheel->intent_slot = (uint8_t)(wheel_slot + 1);
+    log_write_event(LOG_EVENT_DISPENSE_INTENT, log_wheel(0), wheel->pill_dispensed_count, (uint16_t)(wheel_slot + 1));
+    save_dispenser_state_to_eeprom(&state);
+}
+
+// the writes dispense_batch() makes for one pill: the intent, the journal at rest, the result
+// record. the state saves around them find nothing new.
+static void dispense() {
+    WheelState *wheel = &state.wheels[0];
+    dispense_start();
+    wheel_slot = (wheel_slot + 1) % 7;
+    journal_wheel();
+    wheel->flags &= ~WHEEL_STATE_MOTOR_RUNNING;
+    wheel->intent_slot = 0;
+    wheel->pill_dispensed_count = (uint8_t)((wheel->pill_dispensed_count + 1) % SIM_PERIOD);
+    log_write_event(LOG_EVENT_PILL_OK, log_wheel(0), wheel->pill_dispensed_count, wheel->pill_treatment_period);
+    save_dispenser_state_to_eeprom(&state);
+    eeprom_writer_flush();
+}
+
+static double wall_s() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int bench(long count) {
+    boot();
+    eeprom_writer_flush();
+    sim_i2c_reset_stats();
+    uint64_t start_us = sim_time_us();
+    uint64_t start_pages = at24c256_get_stats()->page_writes;
+    double start_s = wall_s();
+    for (long i = 0; i < count; i++) dispense();
+    double elapsed_s = wall_s() - start_s;
+
+    const SimI2cStats *bus = sim_i2c_get_stats(EEPROM_I2C_BUS);
+    const At24c256Stats *part = at24c256_get_stats();
+    fprintf(stderr, "%ld dispenses in %.2f s, %.0f per second\n", count, elapsed_s, count / elapsed_s);
+    fprintf(stderr, "per dispense: %.2f ms simulated, %.1f ms on the bus, %.0f bus bytes, %.2f page writes\n",
+            (sim_time_us() - start_us) / 1000.0 / count, bus->bus_time_ns / 1e6 / count,
+            (double)bus->bytes / count, (double)(part->page_writes - start_pages) / count);
+    fprintf(stderr, "%llu transactions, %llu NACKs (%llu in a write cycle), %llu wrapped page writes\n",
+            (unsigned long long)bus->transactions, (unsigned long long)bus->nacks,
+            (unsigned long long)part->busy_nacks, (unsigned long long)part->wrapped_writes);
+    return 0;
+}
+
+// what the boot after a power cut has to find, shared by the forks
+typedef struct {
+    uint32_t committed_count; // after the last dispense that returned
+    bool is_dispensing; // the cut may have come after its result was logged
+    uint32_t dispenses;
+} Progress;
+
+// every cycle boots in a fresh process, checks the state against the last finished dispense
+// and dispenses until the power goes at a random time
+static int powercut(long cycles) {
+    Progress *progress = mmap(NULL, sizeof(Progress), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (progress == MAP_FAILED) return 1;
+    memset(progress, 0, sizeof(*progress));
+    long failures = 0;
+    for (long cycle = 0; cycle < cycles; cycle++) {
+        uint32_t cut_us = 1 + (uint32_t)rand() % 500000;
+        pid_t pid = fork();
+        if (pid == 0) {
+            srand((unsigned)cycle);
+            boot();
+            WheelState *wheel = &state.wheels[0];
+            uint32_t count = wheel->pill_dispensed_count;
+            bool is_expected = count == progress->committed_count
+                               || (progress->is_dispensing && count == (progress->committed_count + 1) % SIM_PERIOD);
+            if (!is_expected) {
+                fprintf(stderr, "cycle %ld: booted with %u pills, %u expected%s\n", cycle, count,
+                        progress->committed_count, progress->is_dispensing ? " or one more" : "");
+                fflush(stdout);
+                _exit(1);
+            }
+            // the recovery of a cut move is dispenser.c's, here the pill just counts as not given
+            wheel->flags &= ~WHEEL_STATE_MOTOR_RUNNING;
+            progress->committed_count = count;
+            progress->is_dispensing = false;
+            sim_power_cut_at_us(sim_time_us() + cut_us);
+            for (;;) {
+                progress->is_dispensing = true;
+                dispense();
+                progress->committed_count = wheel->pill_dispensed_count;
+                progress->is_dispensing = false;
+                progress->dispenses++;
+            }
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != SIM_POWER_CUT_EXIT) failures++;
+    }
+    fprintf(stderr, "%ld power cuts, %u dispenses, %ld bad boots\n", cycles, progress->dispenses, failures);
+    return failures ? 1 : 0;
+}
+
+static uint64_t bus_transactions() {
+    return sim_i2c_get_stats(EEPROM_I2C_BUS)->transactions;
+}
+
+// how the head was found before it was kept in RAM: every append read the records from 0 on
+// up to the first one that does not decode
+static uint16_t linear_find_head() {
+    for (uint16_t i = 0; i < LOG_MAX_ENTRIES; i++) {
+        uint16_t addr = LOG_BASE_ADDRESS + (i / LOG_RECORDS_PER_PAGE) * EEPROM_PAGE_SIZE
+                        + (i % LOG_RECORDS_PER_PAGE) * LOG_RECORD_SIZE;
+        uint8_t addr_buf[2] = { (uint8_t)(addr >> 8), (uint8_t)(addr & 0xFF) };
+        uint8_t buffer[LOG_RECORD_SIZE];
+        LogRecord record;
+        i2c_hal_write(EEPROM_I2C_BUS, EEPROM_ADDR, addr_buf, 2, true);
+        i2c_hal_read(EEPROM_I2C_BUS, EEPROM_ADDR, buffer, LOG_RECORD_SIZE, false);
+        if (!log_record_decode(buffer, &record)) return i;
+    }
+    return LOG_MAX_ENTRIES;
+}
+
+// bus transactions of a boot and of a dispense at a fill level of the log, with the head found
+// by binary search at boot and with the scan before every append.
+// a boot is a fresh process, so every level runs in its own.
+static int headfind(long steps) {
+    at24c256_erase();
+    fprintf(stderr, "%8s %23s %28s\n", "", "------ per boot -------", "-------- per dispense --------");
+    fprintf(stderr, "%8s %11s %11s %14s %13s\n", "records", "binary", "scan", "cached head", "scan each");
+    for (long step = 0; step <= steps; step++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            uint64_t start = bus_transactions();
+            eeprom_init();
+            uint64_t find = bus_transactions() - start;
+            start = bus_transactions();
+            if (!load_dispenser_state_from_eeprom(&state)) first_state();
+            uint64_t load = bus_transactions() - start;
+            start = bus_transactions();
+            uint16_t head = linear_find_head();
+            uint64_t scan = bus_transactions() - start;
+            start = bus_transactions();
+            dispense();
+            uint64_t cached = bus_transactions() - start;
+            fprintf(stderr, "%8u %11llu %11llu %14llu %13llu\n", head, (unsigned long long)(find + load),
+                    (unsigned long long)(scan + load), (unsigned long long)cached,
+                    (unsigned long long)(cached + scan));
+            uint16_t next = step < steps ? (uint16_t)((LOG_MAX_ENTRIES - 2) * (step + 1) / steps) : 0;
+            while (head + 2 < next) {
+                dispense();
+                head += 2; // the intent and the result
+            }
+            _exit(0);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) return 1;
+    }
+    return 0;
+}
+
+// the page writes of a dispense on the bus: each page, then a one byte read every
+// EEPROM_ACK_POLL_INTERVAL_US that the part NACKs until its write cycle is over
+static int trace(long count) {
+    boot();
+    eeprom_writer_flush();
+    sim_i2c_reset_stats();
+    uint64_t start_pages = at24c256_get_stats()->page_writes;
+    uint64_t start_busy = at24c256_get_stats()->busy_nacks;
+    sim_i2c_trace(stderr);
+    for (long i = 0; i < count; i++) dispense();
+    sim_i2c_trace(NULL);
+
+    const SimI2cStats *bus = sim_i2c_get_stats(EEPROM_I2C_BUS);
+    uint64_t pages = at24c256_get_stats()->page_writes - start_pages;
+    uint64_t polls = at24c256_get_stats()->busy_nacks - start_busy;
+    fprintf(stderr, "%llu page writes, %llu transfers, %.1f NACKed polls per page, %.2f ms on the bus\n",
+            (unsigned long long)pages, (unsigned long long)bus->transactions, pages ? (double)polls / pages : 0.0,
+            bus->bus_time_ns / 1e6);
+    fprintf(stderr, "page start to ACK at most %.2f ms, tWR of the model %.2f ms, the fixed sleep was 10 ms\n",
+            eeprom_writer_get_stats()->max_page_us / 1000.0, AT24C256_WRITE_CYCLE_US / 1000.0);
+    return 0;
+}
+
+static void read_bytes(uint16_t addr, uint8_t *buffer, size_t length) {
+    uint8_t addr_buf[2] = { (uint8_t)(addr >> 8), (uint8_t)(addr & 0xFF) };
+    i2c_hal_write(EEPROM_I2C_BUS, EEPROM_ADDR, addr_buf, 2, true);
+    i2c_hal_read(EEPROM_I2C_BUS, EEPROM_ADDR, buffer, length, false);
+}
+
+// a slot as eeprom.c checks it: this version and a good crc
+static bool read_slot(int slot, DispenserState *record) {
+    read_bytes(STATE_SLOTS_ADDR + slot * STATE_SLOT_SIZE, (uint8_t *)record, sizeof(*record));
+    return record->version == DISPENSER_STATE_VERSION
+           && crc16((const uint8_t *)record, offsetof(DispenserState, crc16)) == record->crc16;
+}
+
+// the valid slot with the highest sequence, -1 for none. the sequence wraps at 65536,
+// far beyond what these runs write.
+static int newest_slot(DispenserState *record) {
+    int newest = -1;
+    for (int i = 0; i < STATE_SLOT_COUNT; i++) {
+        DispenserState candidate;
+        if (!read_slot(i, &candidate) || (newest >= 0 && candidate.sequence <= record->sequence)) continue;
+        *record = candidate;
+        newest = i;
+    }
+    return newest;
+}
+
+// every dispense saves twice and then once more unchanged, which writes nothing
+// most writes a page of the region took since start
+static uint32_t most_page_writes(const At24c256Stats *start, uint32_t addr, uint32_t size) {
+    const At24c256Stats *part = at24c256_get_stats();
+    uint32_t most = 0;
+    for (uint32_t page = addr / AT24C256_PAGE_SIZE; page < (addr + size) / AT24C256_PAGE_SIZE; page++) {
+        uint32_t writes = part->page_wear[page] - start->page_wear[page];
+        if (writes > most) most = writes;
+    }
+    return most;
+}
+
+static int wear(long count) {
+    at24c256_erase();
+    boot();
+    eeprom_writer_flush();
+    At24c256Stats start = *at24c256_get_stats();
+    for (long i = 0; i < count; i++) {
+        dispense();
+        save_dispenser_state_to_eeprom(&state);
+        eeprom_writer_flush();
+    }
+    const At24c256Stats *part = at24c256_get_stats();
+    uint32_t first_page = STATE_SLOTS_ADDR / AT24C256_PAGE_SIZE;
+    uint32_t slot_writes = 0;
+    uint32_t least = UINT32_MAX;
+    uint32_t most = 0;
+    for (uint32_t i = 0; i < STATE_SLOT_COUNT; i++) {
+        uint32_t writes = part->page_wear[first_page + i] - start.page_wear[first_page + i];
+        slot_writes += writes;
+        if (writes < least) least = writes;
+        if (writes > most) most = writes;
+    }
+    uint32_t log_most = most_page_writes(&start, LOG_BASE_ADDRESS, LOG_SIZE);
+    uint32_t journal_most = most_page_writes(&start, WHEEL_JOURNAL_ADDR(0), WHEEL_JOURNAL_SLOTS * WHEEL_JOURNAL_SLOT_SIZE);
+    uint32_t old_page = STORE_DISPENSER_ADDR / AT24C256_PAGE_SIZE;
+    fprintf(stderr, "%ld dispenses, %ld state saves, %u slot page writes, %u to %u per slot\n",
+            count, 3 * count, slot_writes, least, most);
+    fprintf(stderr, "most writes of a page: log %u, wheel journal %u, old state page %u\n",
+            log_most, journal_most, part->page_wear[old_page] - start.page_wear[old_page]);
+    uint32_t hottest = journal_most > log_most ? journal_most : log_most;
+    if (most > hottest) hottest = most;
+    fprintf(stderr, "at 1M write cycles a page the part lasts %.0f dispenses, the single state page %.0f\n",
+            hottest ? 1e6 * count / hottest : 0.0, 1e6 / 2);
+    // a checkpoint every STATE_CHECKPOINT_INTERVAL records, two records a dispense
+    long checkpoints = 2 * count / STATE_CHECKPOINT_INTERVAL;
+    return slot_writes >= checkpoints && slot_writes <= checkpoints + 1 && most - least <= 1 ? 0 : 1;
+}
+
+// what a torn write leaves: some bytes of the page flipped, the crc fails
+static void tear_slot(int slot) {
+    uint8_t page[2 + STATE_SLOT_SIZE];
+    uint16_t addr = STATE_SLOTS_ADDR + slot * STATE_SLOT_SIZE;
+    page[0] = (uint8_t)(addr >> 8);
+    page[1] = (uint8_t)(addr & 0xFF);
+    read_bytes(addr, &page[2], STATE_SLOT_SIZE);
+    for (int i = 2; i < (int)sizeof(page); i += 3) page[i] ^= 0x5A;
+    i2c_hal_write(EEPROM_I2C_BUS, EEPROM_ADDR, page, sizeof(page), false);
+    sim_advance_ns(AT24C256_WRITE_CYCLE_US * 1000ull);
+}
+
+// what the first boot leaves for the second
+typedef struct {
+    int torn_slot;
+    DispenserState before; // the checkpoint before the torn one
+    DispenserState newest; // the torn one as it was written
+} TornSlot;
+
+// a period set from the console, the state change that is not in the log and writes a checkpoint
+static void set_period(uint8_t period) {
+    state.wheels[0].pill_treatment_period = period;
+    save_dispenser_state_to_eeprom(&state);
+    eeprom_writer_flush();
+}
+
+// each cycle: a fresh part, a random number of dispenses each followed by a checkpoint, that may
+// wrap the slots, the newest slot torn. the next boot has to load the checkpoint before it, replay
+// the pill after it from the log and write its next checkpoint into the torn slot.
+static int torn(long cycles) {
+    TornSlot *shared = mmap(NULL, sizeof(TornSlot), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) return 1;
+    long failures = 0;
+    long wraps = 0;
+    for (long cycle = 0; cycle < cycles; cycle++) {
+        long dispenses = 1 + rand() % (2 * STATE_SLOT_COUNT);
+        if (dispenses + 1 > STATE_SLOT_COUNT) wraps++;
+        pid_t pid = fork();
+        if (pid == 0) {
+            at24c256_erase();
+            boot();
+            for (long i = 0; i < dispenses; i++) {
+                dispense();
+                set_period((uint8_t)(SIM_PERIOD - 1 - i % 2));
+            }
+            shared->torn_slot = newest_slot(&shared->newest);
+            int before = (shared->torn_slot + STATE_SLOT_COUNT - 1) % STATE_SLOT_COUNT;
+            if (shared->torn_slot < 0 || !read_slot(before, &shared->before)) _exit(1);
+            tear_slot(shared->torn_slot);
+            _exit(0);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) return 1;
+
+        pid = fork();
+        if (pid == 0) {
+            boot();
+            // the count comes back from the log, the period set last was only in the torn slot
+            WheelState expected = shared->newest.wheels[0];
+            expected.pill_treatment_period = shared->before.wheels[0].pill_treatment_period;
+            if (memcmp(&state.wheels[0], &expected, sizeof(expected)) != 0) {
+                fprintf(stderr, "cycle %ld: booted with %u/%u pills, flags 0x%02X, %u/%u and 0x%02X expected\n",
+                        cycle, state.wheels[0].pill_dispensed_count, state.wheels[0].pill_treatment_period,
+                        state.wheels[0].flags, expected.pill_dispensed_count, expected.pill_treatment_period,
+                        expected.flags);
+                _exit(1);
+            }
+            set_period(shared->newest.wheels[0].pill_treatment_period);
+            DispenserState newest;
+            int slot = newest_slot(&newest);
+            if (slot != shared->torn_slot) {
+                fprintf(stderr, "cycle %ld: slot %d torn, the next checkpoint went to slot %d\n", cycle,
+                        shared->torn_slot, slot);
+                _exit(1);
+            }
+            _exit(0);
+        }
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) failures++;
+    }
+    fprintf(stderr, "%ld torn slots, %ld after the slots wrapped, %ld bad boots\n", cycles, wraps, failures);
+    return failures ? 1 : 0;
+}
+
+// what a boot has to come back with
+typedef struct {
+    WheelState wheel;
+    long pills;
+    long cut_intents;
+    long erases;
+    long checkpoints;
+} ReplayRun;
+
+// each cycle boots on the part the last one left: a random number of dispenses, in one cycle
+// of four the log erased at a random point or last before the reboot, in every other one the
+// power cut after the intent of the next pill. the next boot has to rebuild the count from the
+// checkpoint and the log, with the running flag set after a cut intent, and the checkpoints
+// have to keep to STATE_CHECKPOINT_INTERVAL.
+static int replay(long cycles) {
+    ReplayRun *shared = mmap(NULL, sizeof(ReplayRun), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) return 1;
+    memset(shared, 0, sizeof(*shared));
+    at24c256_erase();
+    uint32_t first_page = STATE_SLOTS_ADDR / AT24C256_PAGE_SIZE;
+    long failures = 0;
+    bool is_first = true;
+    for (long cycle = 0; cycle < cycles; cycle++) {
+        // drawn here, a child's draws do not carry over to the next cycle
+        long dispenses = rand() % (3 * STATE_CHECKPOINT_INTERVAL);
+        long erase_at = -1;
+        if (rand() % 4 == 0) erase_at = rand() % 2 ? dispenses : rand() % (dispenses + 1);
+        bool is_cut = rand() % 2;
+        pid_t pid = fork();
+        if (pid == 0) {
+            boot();
+            eeprom_writer_flush();
+            // the flag of a cut move stays until the dispenser finished or gave up that pill
+            if (!is_first && memcmp(&state.wheels[0], &shared->wheel, sizeof(WheelState)) != 0) {
+                fprintf(stderr, "cycle %ld: booted with %u pills, flags 0x%02X, %u and 0x%02X expected\n", cycle,
+                        state.wheels[0].pill_dispensed_count, state.wheels[0].flags,
+                        shared->wheel.pill_dispensed_count, shared->wheel.flags);
+                _exit(1);
+            }
+            // the cut move runs from the journal at rest to the slot of the intent
+            bool is_running = state.wheels[0].flags & WHEEL_STATE_MOTOR_RUNNING;
+            if (is_running && state.wheels[0].intent_slot != wheel_slot + 1) {
+                fprintf(stderr, "cycle %ld: intent to slot %u, journal at slot %d\n", cycle,
+                        state.wheels[0].intent_slot, wheel_slot);
+                _exit(1);
+            }
+            state.wheels[0].flags &= ~WHEEL_STATE_MOTOR_RUNNING;
+            state.wheels[0].intent_slot = 0;
+            At24c256Stats start = *at24c256_get_stats();
+            // an erase may also be the last thing before the reboot
+            for (long i = 0; i <= dispenses; i++) {
+                if (i == erase_at) {
+                    log_erase_all();
+                    shared->erases++;
+                }
+                if (i < dispenses) dispense();
+            }
+            shared->pills += dispenses;
+            if (is_cut) {
+                dispense_start();
+                shared->cut_intents++;
+            }
+            eeprom_writer_flush();
+            for (uint32_t i = 0; i < STATE_SLOT_COUNT; i++) {
+                shared->checkpoints += at24c256_get_stats()->page_wear[first_page + i] - start.page_wear[first_page + i];
+            }
+            shared->wheel = state.wheels[0];
+            _exit(0);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) > 1) return 1;
+        if (WEXITSTATUS(status) == 1) failures++;
+        is_first = false;
+    }
+    // the one cut intent a cycle is in the log as a record too
+    long records = 2 * shared->pills + shared->cut_intents;
+    long most = records / STATE_CHECKPOINT_INTERVAL + shared->erases + cycles;
+    fprintf(stderr, "%ld boots, %ld pills, %ld cut intents, %ld log erases, %ld checkpoints (%ld records), %ld bad boots\n",
+            cycles, shared->pills, shared->cut_intents, shared->erases, shared->checkpoints, records, failures);
+    return failures || shared->checkpoints > most ? 1 : 0;
+}
+
+// the stream goes to stdout with the firmware's prints before it, as on the uart
+static int export(long count) {
+    boot();
+    for (long i = 0; i < count; i++) dispense();
+    eeprom_writer_flush();
+    sim_i2c_reset_stats();
+    eeprom_export();
+    const SimI2cStats *bus = sim_i2c_get_stats(EEPROM_I2C_BUS);
+    fprintf(stderr, "%d bytes exported, %llu transfers, %.2f s on the bus, %.2f s on the uart at 115200\n",
+            MAX_EEPROM_ADDR, (unsigned long long)bus->transactions, bus->bus_time_ns / 1e9,
+            MAX_EEPROM_ADDR * (EEPROM_EXPORT_FRAME_SIZE + 8.0) / EEPROM_EXPORT_FRAME_SIZE * 10 / 115200);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    bool is_verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+    if (is_verbose) {
+        argc--;
+        argv++;
+    }
+    if (argc != 4 || (strcmp(argv[2], "bench") != 0 && strcmp(argv[2], "powercut") != 0
+                      && strcmp(argv[2], "headfind") != 0 && strcmp(argv[2], "trace") != 0
+                      && strcmp(argv[2], "wear") != 0 && strcmp(argv[2], "torn") != 0
+                      && strcmp(argv[2], "replay") != 0 && strcmp(argv[2], "export") != 0)) {
+        fprintf(stderr, "usage: eeprom_sim [-v] image.bin bench|powercut|headfind|trace|wear|torn|replay|export count\n");
+        return 2;
+    }
+    if (!at24c256_open(argv[1])) {
+        perror(argv[1]);
+        return 1;
+    }
+    if (!is_verbose && strcmp(argv[2], "export") != 0) freopen("/dev/null", "w", stdout);
+    sim_i2c_attach(&at24c256_device);
+    long count = strtol(argv[3], NULL, 10);
+    int result;
+    if (strcmp(argv[2], "bench") == 0) result = bench(count);
+    else if (strcmp(argv[2], "powercut") == 0) result = powercut(count);
+    else if (strcmp(argv[2], "headfind") == 0) result = headfind(count);
+    else if (strcmp(argv[2], "trace") == 0) result = trace(count);
+    else if (strcmp(argv[2], "wear") == 0) result = wear(count);
+    else if (strcmp(argv[2], "torn") == 0) result = torn(count);
+    else if (strcmp(argv[2], "replay") == 0) result = replay(count);
+    else result = export(count);
+    at24c256_close();
+    return result;
+}
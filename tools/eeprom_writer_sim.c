@@ -0,0 +1,180 @@
+// Runs the firmware's eeprom_writer.c, the DMA and I2C irq page queue, on a PC against the I2C
+// controller and DMA models in tools/sim/rp2040.c and the AT24C256 model behind them.
+//
+// build: cc -std=gnu11 -Isrc -Isrc/drivers -Itools/sim -o eeprom_writer_sim tools/eeprom_writer_sim.c
+//            tools/sim/clock.c tools/sim/rp2040.c tools/sim/i2c_hal_linux.c tools/sim/at24c256.c
+//            src/drivers/eeprom_writer.c
+// run:   ./eeprom_writer_sim image.bin nack
+//        ./eeprom_writer_sim image.bin queue
+//        ./eeprom_writer_sim image.bin stall
+//
+// image.bin is the 32 KB part, erased at the start of each run.
+// nack queues a page while the part is still in the write cycle of another: once with the cycle
+// ending within the retries, the page has to get there, and once right after the cycle started,
+// the page has to be given up and the flush has to say so.
+// queue writes 3 * EEPROM_WRITER_QUEUE_DEPTH pages' worth from an unaligned address in one call:
+// the write has to wait for room in the queue, split at the page ends and keep the order.
+// stall holds SCL low under the first of a few queued pages: the flush has to give up after
+// EEPROM_WRITER_PAGE_TIMEOUT_US and drop the queue, and the writer has to work again once the
+// bus is let go.
+// every check reads the part back over the bus. the firmware's own prints go to /dev/null, -v
+// keeps them.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "config.h"
+#include "eeprom.h"
+#include "eeprom_writer.h"
+#include "i2c_hal.h"
+#include "sim.h"
+
+#define QUEUE_TEST_START 32 // half a page in, so the first and last chunks are half pages
+#define QUEUE_TEST_LENGTH (3 * EEPROM_WRITER_QUEUE_DEPTH * EEPROM_PAGE_SIZE)
+#define STALL_PAGES 4
+
+static int failures = 0;
+
+static void check(bool is_ok, const char *what) {
+    fprintf(stderr, "%-58s %s\n", what, is_ok ? "ok" : "FAILED");
+    if (!is_ok) failures++;
+}
+
+// false while the part is still in a write cycle
+static bool read_back(uint16_t addr, uint8_t *dst, size_t length) {
+    uint8_t address[2] = { (uint8_t)(addr >> 8), (uint8_t)(addr & 0xFF) };
+    if (i2c_hal_write(EEPROM_I2C_BUS, EEPROM_ADDR, address, sizeof(address), true) < 0) return false;
+    return i2c_hal_read(EEPROM_I2C_BUS, EEPROM_ADDR, dst, length, false) >= 0;
+}
+
+static bool holds(uint16_t addr, uint8_t value, size_t length) {
+    uint8_t bytes[QUEUE_TEST_LENGTH];
+    if (!read_back(addr, bytes, length)) return false;
+    for (size_t i = 0; i < length; i++) {
+        if (bytes[i] != value) return false;
+    }
+    return true;
+}
+
+// a page written past the writer, its write cycle starts at the STOP
+static void blocking_page_write(uint16_t addr, uint8_t value) {
+    uint8_t page[2 + EEPROM_PAGE_SIZE];
+    page[0] = (uint8_t)(addr >> 8);
+    page[1] = (uint8_t)(addr & 0xFF);
+    memset(&page[2], value, EEPROM_PAGE_SIZE);
+    i2c_hal_write(EEPROM_I2C_BUS, EEPROM_ADDR, page, sizeof(page), false);
+}
+
+static int nack() {
+    uint8_t page[EEPROM_PAGE_SIZE];
+
+    // the page is NACKed until the write cycle ends, a retry after EEPROM_ACK_POLL_INTERVAL_US gets through
+    blocking_page_write(0, 0xA5);
+    sleep_us(AT24C256_WRITE_CYCLE_US - EEPROM_ACK_POLL_INTERVAL_US / 2);
+    uint64_t nacks = sim_i2c_get_stats(EEPROM_I2C_BUS)->nacks;
+    memset(page, 0x5A, sizeof(page));
+    eeprom_writer_write(EEPROM_PAGE_SIZE, page, sizeof(page));
+    bool is_flushed = eeprom_writer_flush();
+    const EepromWriterStats *stats = eeprom_writer_get_stats();
+    fprintf(stderr, "busy part: %llu NACKs with the ACK polls, page written after %lu us\n",
+            (unsigned long long)(sim_i2c_get_stats(EEPROM_I2C_BUS)->nacks - nacks), (unsigned long)stats->max_page_us);
+    check(sim_i2c_get_stats(EEPROM_I2C_BUS)->nacks > nacks, "the page transfer was NACKed");
+    check(is_flushed && stats->pages_written == 1 && stats->pages_failed == 0, "a retry wrote it, flush true");
+    check(holds(EEPROM_PAGE_SIZE, 0x5A, EEPROM_PAGE_SIZE), "the part holds the page");
+
+    // EEPROM_WRITER_RETRIES NACKs in a row are not enough for a whole write cycle
+    blocking_page_write(0, 0xC3);
+    nacks = sim_i2c_get_stats(EEPROM_I2C_BUS)->nacks;
+    memset(page, 0x3C, sizeof(page));
+    eeprom_writer_write(2 * EEPROM_PAGE_SIZE, page, sizeof(page));
+    is_flushed = eeprom_writer_flush();
+    fprintf(stderr, "part busy for the whole cycle: %llu NACKs\n",
+            (unsigned long long)(sim_i2c_get_stats(EEPROM_I2C_BUS)->nacks - nacks));
+    check(sim_i2c_get_stats(EEPROM_I2C_BUS)->nacks - nacks == EEPROM_WRITER_RETRIES, "NACKed EEPROM_WRITER_RETRIES times");
+    check(!is_flushed && stats->pages_failed == 1, "the page was given up, flush false");
+    sleep_us(AT24C256_WRITE_CYCLE_US);
+    check(holds(2 * EEPROM_PAGE_SIZE, 0xFF, EEPROM_PAGE_SIZE), "the part still holds the erased page");
+    check(holds(0, 0xC3, EEPROM_PAGE_SIZE), "the blocking write got there");
+    return failures ? 1 : 0;
+}
+
+static int queue() {
+    static uint8_t data[QUEUE_TEST_LENGTH];
+    for (size_t i = 0; i < sizeof(data); i++) data[i] = (uint8_t)(i * 7 + i / EEPROM_PAGE_SIZE);
+
+    uint64_t start_us = sim_time_us();
+    eeprom_writer_write(QUEUE_TEST_START, data, sizeof(data));
+    uint64_t write_us = sim_time_us() - start_us;
+    bool is_flushed = eeprom_writer_flush();
+    uint64_t flush_us = sim_time_us() - start_us - write_us;
+
+    const EepromWriterStats *stats = eeprom_writer_get_stats();
+    uint32_t pages = sizeof(data) / EEPROM_PAGE_SIZE + (QUEUE_TEST_START % EEPROM_PAGE_SIZE ? 1 : 0);
+    fprintf(stderr, "%u bytes in %lu pages: the write returned after %.1f ms, the flush after %.1f ms more\n",
+            (unsigned)sizeof(data), (unsigned long)stats->pages_written, write_us / 1000.0, flush_us / 1000.0);
+    fprintf(stderr, "queue max %lu/%d, %lu full waits, page max %lu us\n", (unsigned long)stats->max_depth,
+            EEPROM_WRITER_QUEUE_DEPTH, (unsigned long)stats->queue_full_waits, (unsigned long)stats->max_page_us);
+    check(stats->queue_full_waits > 0 && stats->max_depth == EEPROM_WRITER_QUEUE_DEPTH, "the write waited on a full queue");
+    check(is_flushed && stats->pages_written == pages && stats->pages_failed == 0, "every page written, flush true");
+    check(at24c256_get_stats()->page_writes == pages && at24c256_get_stats()->wrapped_writes == 0,
+          "split at the page ends, none wrapped");
+    uint8_t bytes[QUEUE_TEST_LENGTH];
+    bool is_read = read_back(QUEUE_TEST_START, bytes, sizeof(bytes));
+    check(is_read && memcmp(bytes, data, sizeof(data)) == 0, "the part holds the data in order");
+    check(holds(0, 0xFF, QUEUE_TEST_START), "nothing before it");
+    return failures ? 1 : 0;
+}
+
+static int stall() {
+    uint8_t page[EEPROM_PAGE_SIZE];
+    memset(page, 0x69, sizeof(page));
+    for (int i = 0; i < STALL_PAGES; i++) eeprom_writer_write((uint16_t)(i * EEPROM_PAGE_SIZE), page, sizeof(page));
+    sim_i2c_hold_scl(EEPROM_I2C_BUS, true);
+
+    uint64_t start_us = sim_time_us();
+    bool is_flushed = eeprom_writer_flush();
+    uint64_t flush_us = sim_time_us() - start_us;
+    const EepromWriterStats *stats = eeprom_writer_get_stats();
+    fprintf(stderr, "SCL held: the flush gave up after %.1f ms, %lu pages dropped\n", flush_us / 1000.0,
+            (unsigned long)stats->pages_failed);
+    check(!is_flushed && stats->stalls == 1 && stats->pages_failed == STALL_PAGES, "flush false, the queue dropped");
+    check(flush_us > EEPROM_WRITER_PAGE_TIMEOUT_US && flush_us < EEPROM_WRITER_PAGE_TIMEOUT_US + 1000,
+          "after EEPROM_WRITER_PAGE_TIMEOUT_US");
+    check(holds(0, 0xFF, STALL_PAGES * EEPROM_PAGE_SIZE), "no page got to the part");
+
+    sim_i2c_hold_scl(EEPROM_I2C_BUS, false);
+    memset(page, 0x96, sizeof(page));
+    eeprom_writer_write(0, page, sizeof(page));
+    is_flushed = eeprom_writer_flush();
+    check(is_flushed && stats->pages_written == 1, "the next write goes through");
+    check(holds(0, 0x96, EEPROM_PAGE_SIZE), "the part holds it");
+    return failures ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    bool is_verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+    if (is_verbose) {
+        argc--;
+        argv++;
+    }
+    if (argc != 3 || (strcmp(argv[2], "nack") != 0 && strcmp(argv[2], "queue") != 0 && strcmp(argv[2], "stall") != 0)) {
+        fprintf(stderr, "usage: eeprom_writer_sim [-v] image.bin nack|queue|stall\n");
+        return 2;
+    }
+    if (!at24c256_open(argv[1])) {
+        perror(argv[1]);
+        return 1;
+    }
+    if (!is_verbose) freopen("/dev/null", "w", stdout);
+    at24c256_erase();
+    sim_i2c_attach(&at24c256_device);
+    i2c_hal_init(EEPROM_I2C_BUS, EEPROM_I2C_BAUDRATE, EEPROM_SDA_GPIO, EEPROM_SCL_GPIO);
+    eeprom_writer_init();
+    int result;
+    if (strcmp(argv[2], "nack") == 0) result = nack();
+    else if (strcmp(argv[2], "queue") == 0) result = queue();
+    else result = stall();
+    at24c256_close();
+    return result;
+}
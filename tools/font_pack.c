@@ -0,0 +1,69 @@
+// Writes src/drivers/font_packed.c, the fonts of font.c with only their non-zero bytes kept,
+// for a build with OLED_FONT_PACKED. Run it again after a change to a font in font.c.
+//
+// build: cc -std=c11 -DOLED_FONT_PACKED=0 -Isrc -Isrc/drivers -Itools/sim -o font_pack tools/font_pack.c
+//            src/drivers/font.c
+// run:   ./font_pack > src/drivers/font_packed.c
+
+#include <stdio.h>
+#include "font.h"
+
+typedef struct {
+    const Font *font;
+    const char *name;
+} NamedFont;
+
+static const NamedFont fonts[] = {
+        { &font_8x16, "font_8x16" },
+        { &font_16x32_digits, "font_16x32_digit" },
+};
+
+static void print_bytes(const uint8_t *bytes, int count) {
+    for (int i = 0; i < count; i++) {
+        printf("%s0x%02X,", i % 16 == 0 ? "    " : " ", bytes[i]);
+        if (i % 16 == 15 || i == count - 1) printf("\n");
+    }
+}
+
+static void pack(const NamedFont *named) {
+    const Font *font = named->font;
+    int size = font->width * font->pages;
+    static uint8_t packed[256 * FONT_MAX_GLYPH_BYTES];
+    static uint8_t masks[256 * FONT_MAX_GLYPH_BYTES / 8];
+    uint16_t offsets[256 / FONT_BLOCK_GLYPHS];
+    int length = 0;
+    for (int index = 0; index < font->count; index++) {
+        if (index % FONT_BLOCK_GLYPHS == 0) offsets[index / FONT_BLOCK_GLYPHS] = (uint16_t)length;
+        uint8_t buffer[FONT_MAX_GLYPH_BYTES];
+        const uint8_t *glyph = font_glyph(font, (char)(font->first + index), buffer);
+        for (int i = 0; i < size; i++) {
+            uint8_t *mask = &masks[(index * size + i) / 8];
+            if (i % 8 == 0) *mask = 0;
+            if (glyph[i] == 0) continue;
+            *mask |= (uint8_t)(1u << (i % 8));
+            packed[length++] = glyph[i];
+        }
+    }
+    int blocks = (font->count + FONT_BLOCK_GLYPHS - 1) / FONT_BLOCK_GLYPHS;
+    int mask_length = font->count * size / 8;
+
+    printf("\n// %u glyphs of %ux%u, %d bytes plain\n", font->count, font->width, font->pages * 8,
+           font->count * size);
+    printf("const uint8_t __in_flash(\"font\") %s_packed[] = {\n", named->name);
+    print_bytes(packed, length);
+    printf("};\n\nconst uint8_t __in_flash(\"font\") %s_masks[] = {\n", named->name);
+    print_bytes(masks, mask_length);
+    printf("};\n\nconst uint16_t __in_flash(\"font\") %s_offsets[] = {\n   ", named->name);
+    for (int i = 0; i < blocks; i++) printf(" %u,", offsets[i]);
+    printf("\n};\n");
+    fprintf(stderr, "%s: %d bytes plain, %d packed\n", named->name, font->count * size,
+            length + mask_length + blocks * 2);
+}
+
+int main() {
+    printf("//\n// Written by tools/font_pack.c from the fonts in font.c, do not edit.\n//\n\n");
+    printf("#include <stdint.h>\n#include \"config.h\"\n#include \"pico/platform.h\"\n\n#if OLED_FONT_PACKED\n");
+    for (size_t i = 0; i < sizeof(fonts) / sizeof(fonts[0]); i++) pack(&fonts[i]);
+    printf("\n#endif\n");
+    return 0;
+}
@@ -0,0 +1,260 @@
+// Decodes the binary event log from an EEPROM dump on a PC, with the same
+// log_record.c the firmware uses.
+//
+// build: cc -std=c11 -Isrc/drivers -o log_decode tools/log_decode.c src/drivers/log_record.c src/drivers/crc16.c
+// run:   ./log_decode [--csv | --json] eeprom.bin
+//        ./log_decode [--csv | --json] --export /dev/ttyUSB0 [-o eeprom.bin]
+//
+// eeprom.bin is the whole AT24C256 (32 KB) or just the log region (16 KB), the log starts at offset 0.
+// --export sends 'e' to the dispenser's stdio uart and reads back the framed dump eeprom_export() streams,
+// -o keeps the image. A file instead of a tty is read as a captured stream.
+
+#define _DEFAULT_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include "crc16.h"
+#include "log_record.h"
+
+#define EEPROM_SIZE (32 * 1024)
+#define LOG_SIZE (4096*4)
+#define EEPROM_PAGE_SIZE 64
+#define LOG_RECORDS_PER_PAGE (EEPROM_PAGE_SIZE / LOG_RECORD_SIZE)
+#define LOG_MAX_ENTRIES (LOG_SIZE / EEPROM_PAGE_SIZE * LOG_RECORDS_PER_PAGE)
+
+// same framing as eeprom_export() in eeprom.c
+#define EXPORT_SYNC0 0xA5
+#define EXPORT_SYNC1 0x5A
+#define EXPORT_DATA 1
+#define EXPORT_END 2
+#define EXPORT_FRAME_SIZE 128
+#define EXPORT_FRAMES (EEPROM_SIZE / EXPORT_FRAME_SIZE)
+
+typedef enum { OUTPUT_TEXT, OUTPUT_CSV, OUTPUT_JSON } OutputFormat;
+
+static uint8_t image[EEPROM_SIZE];
+static LogRecord records[LOG_MAX_ENTRIES];
+
+// the newest record is the one the next record's sequence does not follow
+static int find_oldest(int count) {
+    for (int i = 0; i < count; i++) {
+        uint16_t next = records[(i + 1) % count].sequence;
+        if (next != (uint16_t)(records[i].sequence + 1)) return (i + 1) % count;
+    }
+    return 0;
+}
+
+// raw 8N1 at the firmware's 115200, reads give up after 2 s of silence
+static int open_serial(const char *path) {
+    int fd = open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0) return -1;
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0) return fd; // not a tty, a captured stream
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, B115200);
+    cfsetospeed(&tio, B115200);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 20;
+    tcsetattr(fd, TCSANOW, &tio);
+    tcflush(fd, TCIOFLUSH);
+    if (write(fd, "e", 1) != 1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int read_byte(int fd) {
+    uint8_t byte;
+    return read(fd, &byte, 1) == 1 ? byte : -1;
+}
+
+static int read_exact(int fd, uint8_t *buffer, int length) {
+    for (int i = 0; i < length; i++) {
+        int byte = read_byte(fd);
+        if (byte < 0) return -1;
+        buffer[i] = (uint8_t)byte;
+    }
+    return 0;
+}
+
+// fills image from the frames, the text log around them is skipped; returns the size the end frame announced
+static long receive_export(int fd) {
+    static uint8_t received[EXPORT_FRAMES];
+    int bad = 0;
+    int previous = -1;
+    for (;;) {
+        int byte = read_byte(fd);
+        if (byte < 0) {
+            fprintf(stderr, "export: stream ended before the end frame\n");
+            return -1;
+        }
+        if (previous != EXPORT_SYNC0 || byte != EXPORT_SYNC1) {
+            previous = byte;
+            continue;
+        }
+        previous = -1;
+
+        // type, offset (2), length, payload, crc16 over type..payload
+        uint8_t frame[4 + EXPORT_FRAME_SIZE + 2];
+        if (read_exact(fd, frame, 4) != 0) continue;
+        uint8_t length = frame[3];
+        if (length > EXPORT_FRAME_SIZE || read_exact(fd, &frame[4], length + 2) != 0) {
+            bad++;
+            continue;
+        }
+        uint16_t crc = (uint16_t)(frame[4 + length] | (frame[5 + length] << 8));
+        if (crc16(frame, 4 + length) != crc) {
+            bad++;
+            continue;
+        }
+        uint16_t offset = (uint16_t)(frame[1] | (frame[2] << 8));
+        if (frame[0] == EXPORT_END) {
+            long size = length >= 2 ? (long)(frame[4] | (frame[5] << 8)) : EEPROM_SIZE;
+            if (size == 0 || size > EEPROM_SIZE) size = EEPROM_SIZE;
+            int missing = 0;
+            for (long i = 0; i < size / EXPORT_FRAME_SIZE; i++) {
+                if (!received[i]) missing++;
+            }
+            if (bad || missing) {
+                fprintf(stderr, "export: %d bad frames, %d of %ld frames missing\n", bad, missing,
+                        size / EXPORT_FRAME_SIZE);
+            }
+            return missing ? -1 : size;
+        }
+        if (frame[0] != EXPORT_DATA || (long)offset + length > EEPROM_SIZE) {
+            bad++;
+            continue;
+        }
+        memcpy(&image[offset], &frame[4], length);
+        received[offset / EXPORT_FRAME_SIZE] = 1;
+    }
+}
+
+static void print_csv_text(const char *text) {
+    putchar('"');
+    for (const char *c = text; *c; c++) {
+        if (*c == '"') putchar('"');
+        putchar(*c);
+    }
+    putchar('"');
+}
+
+static void print_json_text(const char *text) {
+    putchar('"');
+    for (const char *c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') putchar('\\');
+        putchar(*c);
+    }
+    putchar('"');
+}
+
+static void print_record(OutputFormat format, const LogRecord *record, unsigned long total_s, int first) {
+    char text[64];
+    log_record_format(record, text, sizeof(text));
+    switch (format) {
+        case OUTPUT_TEXT:
+            printf("#%u\t+%lus\t%lus\t%s\n", record->sequence, (unsigned long)record->time_delta_s, total_s, text);
+            break;
+        case OUTPUT_CSV:
+            printf("%u,%lu,%lu,%s,", record->sequence, (unsigned long)record->time_delta_s, total_s,
+                   log_event_name(record->event));
+            if (record->wheel == LOG_NO_WHEEL) printf(",");
+            else printf("%u,", record->wheel);
+            printf("%u,%u,", record->arg0, record->arg1);
+            print_csv_text(text);
+            printf("\n");
+            break;
+        case OUTPUT_JSON:
+            printf("%s\n  {\"sequence\": %u, \"delta_s\": %lu, \"total_s\": %lu, \"event\": \"%s\", \"wheel\": ",
+                   first ? "" : ",", record->sequence, (unsigned long)record->time_delta_s, total_s,
+                   log_event_name(record->event));
+            if (record->wheel == LOG_NO_WHEEL) printf("null");
+            else printf("%u", record->wheel);
+            printf(", \"arg0\": %u, \"arg1\": %u, \"text\": ", record->arg0, record->arg1);
+            print_json_text(text);
+            printf("}");
+            break;
+    }
+}
+
+static int usage(const char *name) {
+    fprintf(stderr, "usage: %s [--csv | --json] eeprom.bin\n"
+                    "       %s [--csv | --json] --export /dev/ttyUSB0 [-o eeprom.bin]\n", name, name);
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    OutputFormat format = OUTPUT_TEXT;
+    const char *input = NULL;
+    const char *serial = NULL;
+    const char *output = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--csv") == 0) format = OUTPUT_CSV;
+        else if (strcmp(argv[i], "--json") == 0) format = OUTPUT_JSON;
+        else if (strcmp(argv[i], "--export") == 0 && i + 1 < argc) serial = argv[++i];
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) output = argv[++i];
+        else if (argv[i][0] != '-' && !input) input = argv[i];
+        else return usage(argv[0]);
+    }
+    if (!input == !serial || (output && !serial)) return usage(argv[0]);
+
+    size_t length;
+    if (serial) {
+        int fd = open_serial(serial);
+        if (fd < 0) {
+            perror(serial);
+            return 1;
+        }
+        memset(image, 0xFF, sizeof(image));
+        long size = receive_export(fd);
+        close(fd);
+        if (size < 0) return 1;
+        length = (size_t)size;
+        if (output) {
+            FILE *file = fopen(output, "wb");
+            if (!file || fwrite(image, 1, length, file) != length) {
+                perror(output);
+                return 1;
+            }
+            fclose(file);
+        }
+    } else {
+        FILE *file = fopen(input, "rb");
+        if (!file) {
+            perror(input);
+            return 1;
+        }
+        length = fread(image, 1, sizeof(image), file);
+        fclose(file);
+    }
+
+    // records in ring order, torn or erased ones skipped
+    int count = 0;
+    for (size_t i = 0; i < LOG_MAX_ENTRIES; i++) {
+        size_t offset = i / LOG_RECORDS_PER_PAGE * EEPROM_PAGE_SIZE + i % LOG_RECORDS_PER_PAGE * LOG_RECORD_SIZE;
+        if (offset + LOG_RECORD_SIZE > length) break;
+        if (log_record_decode(&image[offset], &records[count])) count++;
+    }
+    if (format == OUTPUT_CSV) printf("sequence,delta_s,total_s,event,wheel,arg0,arg1,text\n");
+    if (format == OUTPUT_JSON) printf("[");
+    if (count == 0 && format == OUTPUT_TEXT) {
+        printf("No valid log entries found.\n");
+        return 0;
+    }
+
+    // times are deltas, a boot restarts them so the total is only a guide across reboots
+    int oldest = count ? find_oldest(count) : 0;
+    unsigned long total_s = 0;
+    for (int n = 0; n < count; n++) {
+        const LogRecord *record = &records[(oldest + n) % count];
+        total_s += record->time_delta_s;
+        print_record(format, record, total_s, n == 0);
+    }
+    if (format == OUTPUT_JSON) printf("\n]\n");
+    return 0;
+}
@@ -0,0 +1,415 @@
+// Runs the firmware's motor.c on a PC against the RP2040 and stepper models in tools/sim: the
+// stepper PIO program instruction by instruction, the DMA feeding it and a 28BYJ-48 turning the
+// wheel from the coil pins.
+//
+// build: cc -std=gnu11 -Isrc -Isrc/drivers -Itools/sim -o motor_sim tools/motor_sim.c
+//            tools/sim/clock.c tools/sim/rp2040.c tools/sim/i2c_hal_linux.c tools/sim/stepper_wheel.c
+//            src/drivers/motor.c -lm
+// run:   ./motor_sim profile
+//        ./motor_sim pio
+//        ./motor_sim bench
+//
+// profile steps motor_profile_interval_us() of every drive mode over moves of many lengths: the
+// ramp has to slow down as it sped up, stay between the start and cruise intervals and within
+// MOTOR_ACCELERATION, and the move on the sequencer has to take the sum of its intervals.
+// pio prints the stepper program as the model decodes it and takes apart every word motor.c
+// writes into the DMA buffer: coil pattern in the motor's pin window, hold of the profile
+// interval, and the pins a tick after the pull.
+// bench turns the wheel a compartment per round the ways the firmware can: one blocking half-step
+// at a time, each drive mode on its own, and full drive with the last FINE_APPROACH_STEPS in half
+// drive as dispenser.c does, and reports half-steps/s and the round time on the simulated clock.
+// the firmware's own prints go to /dev/null, -v keeps them.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pico/stdlib.h"
+#include "config.h"
+#include "motor.h"
+#include "sim.h"
+#include "stepper.pio.h"
+#include "logic/dispenser.h"
+
+#define MAX_WORDS 8192 // pattern changes recorded per move
+
+static const uint coil_pins[4] = { WHEEL0_MOTOR_PINS };
+static const char *const mode_names[MOTOR_DRIVE_MODE_COUNT] = { "wave", "full", "half" };
+static const uint32_t start_intervals[MOTOR_DRIVE_MODE_COUNT] = {
+    MOTOR_WAVE_START_INTERVAL_US, MOTOR_FULL_START_INTERVAL_US, MOTOR_HALF_START_INTERVAL_US
+};
+static const uint32_t cruise_intervals[MOTOR_DRIVE_MODE_COUNT] = {
+    MOTOR_WAVE_CRUISE_INTERVAL_US, MOTOR_FULL_CRUISE_INTERVAL_US, MOTOR_HALF_CRUISE_INTERVAL_US
+};
+
+// wheel 0 as it is built: the gearbox is 63.68:1, so a revolution is no whole number of half-steps
+static const SimWheelConfig wheel_config = {
+    .motor_pins = { WHEEL0_MOTOR_PINS },
+    .opto_pin = OPTO_SENSOR_PIN,
+    .half_steps_per_revolution = 4075.7728,
+    .gap_start = 1000,
+    .gap_width = 80,
+};
+
+// times the coil pattern of motor 0 changed to one with a coil on, motor_stop() is left out
+static uint64_t word_ns[MAX_WORDS];
+static uint8_t word_coils[MAX_WORDS]; // IN1-IN4 as bits 0-3
+static uint32_t word_count = 0;
+
+static void record_pattern(uint32_t levels, uint32_t changed) {
+    uint32_t pins = 0;
+    uint8_t coils = 0;
+    for (int i = 0; i < 4; i++) {
+        pins |= 1u << coil_pins[i];
+        if (levels & (1u << coil_pins[i])) coils |= (uint8_t)(1u << i);
+    }
+    if (!(changed & pins) || !coils) return;
+    if (word_count < MAX_WORDS) {
+        word_ns[word_count] = sim_time_ns();
+        word_coils[word_count] = coils;
+    }
+    word_count++;
+}
+
+// the FIFO words the state machine of motor 0 pulled, and when
+static uint32_t pulled_words[MAX_WORDS];
+static uint64_t pulled_ns[MAX_WORDS];
+static uint32_t pulled_count = 0;
+
+static void record_pull(unsigned pio, unsigned sm, uint32_t word) {
+    (void)pio;
+    (void)sm;
+    if (pulled_count < MAX_WORDS) {
+        pulled_words[pulled_count] = word;
+        pulled_ns[pulled_count] = sim_time_ns();
+    }
+    pulled_count++;
+}
+
+static int failures = 0;
+
+static void check(bool is_ok, const char *mode, uint32_t total, uint32_t step, const char *what) {
+    if (is_ok) return;
+    if (failures++ < 20) fprintf(stderr, "FAIL %s, %u steps, step %u: %s\n", mode, total, step, what);
+}
+
+// 1. the profile as a function of the step, no hardware involved
+static uint64_t check_profile(MotorDriveMode mode, uint32_t total) {
+    const char *name = mode_names[mode];
+    double v0 = 1e6 / start_intervals[mode];
+    uint64_t sum_us = 0;
+    bool is_cruising = false;
+    for (uint32_t n = 0; n + 1 < total; n++) {
+        uint32_t interval = motor_profile_interval_us(mode, n, total);
+        uint32_t mirror = motor_profile_interval_us(mode, total - 2 - n, total);
+        // the ramp table starts at 1/isqrt(v0^2), a few us over the start interval
+        check(interval >= cruise_intervals[mode] && interval <= start_intervals[mode] * 101 / 100, name, total, n,
+              "interval outside start..cruise");
+        check(interval == mirror, name, total, n, "ramp down is not the ramp up backwards");
+        if (2 * (n + 1) <= total - 2) {
+            check(motor_profile_interval_us(mode, n + 1, total) <= interval, name, total, n, "slower while ramping up");
+        }
+        // no faster than v(n)^2 = v0^2 + 2an, one us for the rounding
+        uint32_t from_end = total - 2 - n < n ? total - 2 - n : n;
+        double fastest = 1e6 / sqrt(v0 * v0 + 2.0 * MOTOR_ACCELERATION * from_end);
+        check(interval + 1 >= fastest, name, total, n, "faster than MOTOR_ACCELERATION allows");
+        if (interval == cruise_intervals[mode]) is_cruising = true;
+        sum_us += interval;
+    }
+    check(motor_profile_interval_us(mode, total ? total - 1 : 0, total) == 0, name, total, total, "interval after the last step");
+    // a move longer than both ramps reaches cruise speed
+    if (total > 2 * MOTOR_RAMP_MAX_STEPS + 2) check(is_cruising, name, total, 0, "never reaches cruise");
+    return sum_us;
+}
+
+// 2. the same move on the sequencer: the pattern changes have to come at exactly those intervals,
+// the last step held for a start interval before the motor reports idle
+static void check_move(MotorDriveMode mode, uint32_t half_steps, uint64_t *move_us) {
+    const char *name = mode_names[mode];
+    int32_t position = motor_get_position(0);
+    double rotor = sim_wheel_position(0);
+    word_count = 0;
+    motor_set_drive_mode(0, mode);
+    uint64_t start_ns = sim_time_ns();
+    motor_move_async(0, half_steps, 1);
+    while (motor_is_busy(0)) tight_loop_contents();
+    uint64_t idle_ns = sim_time_ns();
+    motor_stop(0);
+
+    uint32_t words = word_count;
+    check(words <= MAX_WORDS, name, words, 0, "too many words to record");
+    if (words == 0 || words > MAX_WORDS) return;
+    for (uint32_t n = 0; n + 1 < words; n++) {
+        uint64_t interval_ns = word_ns[n + 1] - word_ns[n];
+        check(interval_ns == motor_profile_interval_us(mode, n, words) * 1000ull, name, words, n,
+              "pin change not at the profile interval");
+    }
+    uint64_t last_ns = word_ns[words - 1];
+    // the sequencer waits at its pull a tick before a next word's out pins would come, and the
+    // pull and out pins of the last one were two ticks, so idle is 2 us early, seen within a us
+    uint64_t hold_ns = start_intervals[mode] * 1000ull;
+    check(idle_ns + 2000 >= last_ns + hold_ns && idle_ns <= last_ns + hold_ns, name, words, words,
+          "idle not one start interval after the last step");
+    check(word_ns[0] - start_ns <= 2000, name, words, 0, "first step late");
+    check(motor_get_position(0) - position == (int32_t)half_steps, name, words, 0, "motor position off");
+    check(sim_wheel_position(0) - rotor == half_steps, name, words, 0, "rotor did not follow");
+    *move_us = (last_ns - word_ns[0]) / 1000;
+}
+
+static int profile() {
+    static const uint32_t totals[] = {
+        0, 1, 2, 3, 4, 5, 10, 2 * MOTOR_RAMP_MAX_STEPS - 1, 2 * MOTOR_RAMP_MAX_STEPS, 2 * MOTOR_RAMP_MAX_STEPS + 1,
+        1000, 4096
+    };
+    fprintf(stderr, "%-5s %6s %12s %12s %12s %14s\n", "mode", "steps", "profile ms", "sequencer ms", "half-steps/s",
+            "ramp steps");
+    for (int mode = 0; mode < MOTOR_DRIVE_MODE_COUNT; mode++) {
+        // the first word of full drive is a half-step onto an odd phase, count words as the sequencer sees them
+        uint32_t stride = mode == MOTOR_DRIVE_HALF ? 1 : 2;
+        for (size_t i = 0; i < sizeof(totals) / sizeof(totals[0]); i++) {
+            uint32_t total = totals[i];
+            uint64_t sum_us = check_profile((MotorDriveMode)mode, total);
+            if (total == 0) continue;
+            uint64_t move_us = 0;
+            check_move((MotorDriveMode)mode, total * stride, &move_us);
+            if (word_count != total && word_count != total + 1) {
+                check(false, mode_names[mode], total, 0, "words of the move");
+                continue;
+            }
+            // an align half-step shifts the profile by a word
+            if (word_count != total) sum_us = check_profile((MotorDriveMode)mode, word_count);
+            check(move_us == sum_us, mode_names[mode], total, 0, "move time not the sum of the profile");
+            uint32_t ramp = 0;
+            while (ramp + 1 < total && motor_profile_interval_us((MotorDriveMode)mode, ramp, total) > cruise_intervals[mode]) {
+                ramp++;
+            }
+            if (total >= 10) {
+                fprintf(stderr, "%-5s %6u %12.1f %12.1f %12.0f %14u\n", mode_names[mode], total, sum_us / 1000.0,
+                        move_us / 1000.0, move_us ? (total - 1) * stride * 1e6 / move_us : 0.0, ramp);
+            }
+        }
+    }
+    fprintf(stderr, "%s, %llu PIO instructions, %llu half-steps of the rotor, %llu stalls\n",
+            failures ? "FAILED" : "all profiles ok", (unsigned long long)sim_pio_get_instructions(),
+            (unsigned long long)sim_wheel_get_stats(0)->half_steps, (unsigned long long)sim_wheel_get_stats(0)->stalls);
+    return failures ? 1 : 0;
+}
+
+// 3. the stepper program as the model decodes it, and the words motor.c packs for it
+static void disassemble(uint16_t instr, char *out, size_t size) {
+    static const char *const destinations[8] = { "pins", "x", "y", "null", "pindirs", "pc", "isr", "exec" };
+    static const char *const conditions[8] = { "", "!x, ", "x--, ", "!y, ", "y--, ", "x!=y, ", "pin, ", "!osre, " };
+    uint arg = (instr >> 5) & 7u;
+    switch (instr >> 13) {
+        case 0: snprintf(out, size, "jmp    %s%u", conditions[arg], instr & 31u); break;
+        case 3: snprintf(out, size, "out    %s, %u", destinations[arg], instr & 31u ? instr & 31u : 32); break;
+        case 4: snprintf(out, size, "%s   %s", instr & 0x80u ? "pull" : "push", instr & 0x20u ? "block" : "noblock"); break;
+        case 5: snprintf(out, size, "mov    %s, %s", destinations[arg], destinations[instr & 7u]); break;
+        default: snprintf(out, size, "? 0x%04x", instr); break;
+    }
+}
+
+// coil bits IN1-IN4 of a half-step phase as motor.c drives them, -1 for no phase
+static int coils_phase(unsigned coils) {
+    for (int p = 0; p < 8; p++) {
+        unsigned expected = (1u << (p / 2)) | ((p & 1) ? 1u << ((p / 2 + 1) % 4) : 0u);
+        if (coils == expected) return p;
+    }
+    return -1;
+}
+
+// one move with every pulled word taken apart: the pattern bits have to be the coils of the next
+// phase in the motor's pin window and nothing else, the hold bits the profile interval less the
+// program's overhead. the pins have to follow a tick after each pull, so the pin/time sequence
+// the program makes is the words' sequence.
+static void check_words(const char *name, MotorDriveMode mode, uint32_t half_steps, int direction,
+                        uint pattern_bits, uint32_t overhead, bool is_single) {
+    uint pin_base = coil_pins[0];
+    for (int i = 1; i < 4; i++) if (coil_pins[i] < pin_base) pin_base = coil_pins[i];
+    int phase = motor_get_phase(0);
+    pulled_count = 0;
+    word_count = 0;
+    if (is_single) {
+        motor_move_one_step(0, direction);
+    } else {
+        motor_set_drive_mode(0, mode);
+        motor_move_async(0, half_steps, direction);
+        while (motor_is_busy(0)) tight_loop_contents();
+    }
+    motor_stop(0);
+
+    uint32_t words = pulled_count;
+    check(words == word_count && words <= MAX_WORDS, name, words, 0, "pulls and pin changes differ");
+    if (words != word_count || words > MAX_WORDS) return;
+    uint32_t stride = mode == MOTOR_DRIVE_HALF ? 1 : 2;
+    int32_t moved = 0;
+    for (uint32_t k = 0; k < words; k++) {
+        uint32_t word = pulled_words[k];
+        uint32_t pattern = word & ((1u << pattern_bits) - 1);
+        uint32_t hold = word >> pattern_bits;
+        unsigned coils = 0;
+        for (int i = 0; i < 4; i++) {
+            uint32_t bit = 1u << (coil_pins[i] - pin_base);
+            if (pattern & bit) coils |= 1u << i;
+            pattern &= ~bit;
+        }
+        check(pattern == 0, name, words, k, "pattern drives a pin that is no coil of this motor");
+        int next = coils_phase(coils);
+        int advance = ((next - phase) * direction + 8) % 8;
+        bool is_mode_step = (uint32_t)advance == stride && (stride == 1 || next % 2 == (mode == MOTOR_DRIVE_FULL));
+        check(next >= 0 && (advance == 1 || is_mode_step), name, words, k, "pattern is not the next phase");
+        check(coils == word_coils[k], name, words, k, "pins are not the pattern");
+        moved += advance;
+        phase = next;
+
+        uint32_t expected = k + 1 < words ? motor_profile_interval_us(mode, k, words) : start_intervals[mode];
+        if (is_single) expected = STEP_DELAY_MS * 1000;
+        check(hold + overhead == expected, name, words, k, "hold is not the profile interval less the overhead");
+        check(word_ns[k] - pulled_ns[k] == 1000, name, words, k, "pins not a tick after the pull");
+        if (k + 1 < words) {
+            check(word_ns[k + 1] - word_ns[k] == (hold + overhead) * 1000ull, name, words, k,
+                  "next pattern not hold + overhead ticks later");
+        }
+    }
+    check(moved == (int32_t)(is_single ? 1 : half_steps), name, words, 0, "half-steps of the words");
+}
+
+static int pio() {
+    // the program as loaded, the overhead is every tick of a word outside the hold loop
+    uint pattern_bits = 0;
+    uint32_t overhead = 0;
+    fprintf(stderr, "stepper program, wrap %u..%u:\n", stepper_wrap_target, stepper_wrap);
+    for (uint i = 0; i < sizeof(stepper_program_instructions) / sizeof(stepper_program_instructions[0]); i++) {
+        uint16_t instr = stepper_program_instructions[i];
+        char text[32];
+        disassemble(instr, text, sizeof(text));
+        fprintf(stderr, "  %2u: %04x  %s\n", i, instr, text);
+        if ((instr >> 13) == 3 && ((instr >> 5) & 7u) == 0) pattern_bits = instr & 31u;
+        overhead++;
+    }
+    check(pattern_bits == 12, "program", 0, 0, "out pins is not 12 bits");
+    check(overhead == stepper_WORD_OVERHEAD, "program", 0, 0, "WORD_OVERHEAD is not the ticks outside the loop");
+
+    // the first few words of a short move as the pins show them
+    sim_pio_trace_pulls(record_pull);
+    check_words("half", MOTOR_DRIVE_HALF, 6, 1, pattern_bits, overhead, false);
+    fprintf(stderr, "\nhalf drive, 6 half-steps:\n%10s %10s %8s %6s  %s\n", "pull us", "word", "pattern", "hold",
+            "IN1-IN4 at us");
+    for (uint32_t k = 0; k < pulled_count && k < MAX_WORDS; k++) {
+        uint32_t word = pulled_words[k];
+        fprintf(stderr, "%10.0f   %08x %8x %6u  %u%u%u%u at %.0f\n", pulled_ns[k] / 1000.0, word,
+                word & ((1u << pattern_bits) - 1), word >> pattern_bits, word_coils[k] & 1, (word_coils[k] >> 1) & 1,
+                (word_coils[k] >> 2) & 1, (word_coils[k] >> 3) & 1, word_ns[k] / 1000.0);
+    }
+
+    // every mode both ways, across a DMA chunk refill, and a single blocking step
+    static const uint32_t lengths[] = { 1, 2, 7, 300, 700 };
+    for (int mode = 0; mode < MOTOR_DRIVE_MODE_COUNT; mode++) {
+        for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+            check_words(mode_names[mode], (MotorDriveMode)mode, lengths[i], 1, pattern_bits, overhead, false);
+            check_words(mode_names[mode], (MotorDriveMode)mode, lengths[i], -1, pattern_bits, overhead, false);
+        }
+    }
+    check_words("single step", MOTOR_DRIVE_HALF, 1, 1, pattern_bits, overhead, true);
+    check_words("single step", MOTOR_DRIVE_HALF, 1, -1, pattern_bits, overhead, true);
+    sim_pio_trace_pulls(NULL);
+    fprintf(stderr, "\n%s, %llu PIO instructions, rotor at %.0f, motor at %ld\n", failures ? "FAILED" : "all words ok",
+            (unsigned long long)sim_pio_get_instructions(), sim_wheel_position(0), (long)motor_get_position(0));
+    return failures ? 1 : 0;
+}
+
+// 4. a compartment per round, on the simulated clock and on this machine
+#define BENCH_ROUNDS COMPARTMENTS_PER_WHEEL
+
+typedef enum {
+    BENCH_SINGLE_STEPS = MOTOR_DRIVE_MODE_COUNT, // motor_move_one_step() in a loop
+    BENCH_COARSE_FINE, // full drive, the last FINE_APPROACH_STEPS in half drive
+    BENCH_WAY_COUNT
+} BenchWay;
+
+static void bench_move(int way, uint32_t half_steps) {
+    if (way == BENCH_SINGLE_STEPS) {
+        for (uint32_t i = 0; i < half_steps; i++) motor_move_one_step(0, 1);
+        return;
+    }
+    uint32_t fine = 0;
+    if (way == BENCH_COARSE_FINE) {
+        fine = half_steps < FINE_APPROACH_STEPS ? half_steps : FINE_APPROACH_STEPS;
+        motor_set_drive_mode(0, MOTOR_DRIVE_FULL);
+    } else {
+        motor_set_drive_mode(0, (MotorDriveMode)way);
+    }
+    motor_move_async(0, half_steps - fine, 1);
+    while (motor_is_busy(0)) tight_loop_contents();
+    if (fine) {
+        motor_set_drive_mode(0, MOTOR_DRIVE_HALF);
+        motor_move_async(0, fine, 1);
+        while (motor_is_busy(0)) tight_loop_contents();
+    }
+}
+
+static int bench() {
+    static const char *const way_names[BENCH_WAY_COUNT] = { "wave", "full", "half", "single steps", "full+half" };
+    double spr = wheel_config.half_steps_per_revolution;
+    fprintf(stderr, "%d rounds of a compartment, %.4f half-steps a revolution\n", BENCH_ROUNDS, spr);
+    fprintf(stderr, "%-13s %8s %12s %12s %12s %10s\n", "way", "half-steps", "round ms", "half-steps/s", "host us/round",
+            "speed-up");
+    // the blocking loop first, the others are against it
+    static const int ways[BENCH_WAY_COUNT] = {
+        BENCH_SINGLE_STEPS, MOTOR_DRIVE_WAVE, MOTOR_DRIVE_FULL, MOTOR_DRIVE_HALF, BENCH_COARSE_FINE
+    };
+    uint64_t single_ns = 0;
+    for (int i = 0; i < BENCH_WAY_COUNT; i++) {
+        int way = ways[i];
+        uint64_t steps = 0;
+        uint64_t sim_ns = 0;
+        double host_s = 0;
+        for (int round = 1; round <= BENCH_ROUNDS; round++) {
+            // slot N at round(N * spr / compartments), as the firmware plans it
+            int32_t from = motor_get_position(0);
+            double rotor = sim_wheel_position(0);
+            uint32_t half_steps = (uint32_t)((round * spr + COMPARTMENTS_PER_WHEEL / 2.0) / COMPARTMENTS_PER_WHEEL) -
+                                  (uint32_t)(((round - 1) * spr + COMPARTMENTS_PER_WHEEL / 2.0) / COMPARTMENTS_PER_WHEEL);
+            struct timespec t0, t1;
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            uint64_t start_ns = sim_time_ns();
+            bench_move(way, half_steps);
+            sim_ns += sim_time_ns() - start_ns;
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            host_s += (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+            motor_stop(0);
+            steps += half_steps;
+            check(motor_get_position(0) - from == (int32_t)half_steps, way_names[way], half_steps, round,
+                  "motor position off");
+            check(sim_wheel_position(0) - rotor == half_steps, way_names[way], half_steps, round, "rotor did not follow");
+        }
+        if (way == BENCH_SINGLE_STEPS) single_ns = sim_ns;
+        fprintf(stderr, "%-13s %8.1f %12.1f %12.0f %12.1f %9.2fx\n", way_names[way], (double)steps / BENCH_ROUNDS,
+                sim_ns / 1e6 / BENCH_ROUNDS, steps * 1e9 / sim_ns, host_s * 1e6 / BENCH_ROUNDS, (double)single_ns / sim_ns);
+    }
+    const SimWheelStats *stats = sim_wheel_get_stats(0);
+    fprintf(stderr, "%s, %llu PIO instructions, %llu half-steps of the rotor, %llu stalls\n",
+            failures ? "FAILED" : "all rounds ok", (unsigned long long)sim_pio_get_instructions(),
+            (unsigned long long)stats->half_steps, (unsigned long long)stats->stalls);
+    return failures ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    bool is_verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+    if (is_verbose) {
+        argc--;
+        argv++;
+    }
+    if (argc != 2 || (strcmp(argv[1], "profile") != 0 && strcmp(argv[1], "pio") != 0 && strcmp(argv[1], "bench") != 0)) {
+        fprintf(stderr, "usage: motor_sim [-v] profile|pio|bench\n");
+        return 2;
+    }
+    if (!is_verbose) freopen("/dev/null", "w", stdout);
+    sim_wheel_attach(0, &wheel_config);
+    sim_gpio_listen(record_pattern);
+    set_motor_pins();
+    if (strcmp(argv[1], "profile") == 0) return profile();
+    if (strcmp(argv[1], "bench") == 0) return bench();
+    return pio();
+}
@@ -0,0 +1,279 @@
+// Runs the firmware's statemachine.c and oled.c on a PC against the SSD1306 model in tools/sim.
+// A script of encoder, button and LoRa inputs walks every UI state; each step prints the frames,
+// I2C traffic and simulated bus time it cost and a hash of the screen it ends on, so a change in
+// any screen or in its cost shows up in a diff of two runs.
+//
+// build: cc -std=gnu11 -Isrc -Isrc/drivers -Isrc/logic -Itools/sim -o oled_sim tools/oled_sim.c
+//            tools/sim/clock.c tools/sim/i2c_hal_linux.c tools/sim/ssd1306.c tools/sim/oled_dma_sync.c
+//            src/drivers/oled.c src/drivers/font.c src/drivers/font_packed.c src/logic/statemachine.c
+// run:   ./oled_sim [-o frames]
+//        ./oled_sim cells
+//
+// -o writes every frame as frames/0001.png and on; a directory that exists. cells checks the
+// text cell cache of oled.c after the script: a step that leaves the screen as it was has to draw
+// no glyph, the same text again costs nothing, a padded number only its changed digits, and
+// text off the grid or big digits have to make the cells under them draw again, back to the
+// same screen. the firmware's own prints go to /dev/null, -v keeps them.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "config.h"
+#include "oled.h"
+#include "led.h"
+#include "lora.h"
+#include "dispenser.h"
+#include "encoder&button.h"
+#include "eeprom_writer.h"
+#include "statemachine.h"
+#include "sim.h"
+#include "hardware/structs/vreg_and_chip_reset.h"
+
+#define SETTLE_MAX_LOOPS 32
+
+// inputs of the next loop, used once
+static int rotation = 0;
+static bool is_pressed = false;
+static bool is_sw0 = false;
+static bool is_sw2 = false;
+// board the firmware sees
+static LoraStatus_t lora_status = LORA_STATUS_JOINING;
+static bool is_calibrated = false;
+static bool was_running_at_boot = false;
+static uint8_t period = DEFAULT_PERIOD;
+static uint8_t dispensed = 0;
+static int failed_rounds_left = 0; // the next dispense rounds that find no pill
+
+// 1. stand-ins for the drivers statemachine.c calls
+void led_set_mode(LedMode mode) { (void)mode; }
+void led_blink_task(void) {}
+void leds_set_brightness(uint16_t brightness) { (void)brightness; }
+void led_blinking_error(int times, int interval) { sleep_ms((uint32_t)(times * interval)); }
+int get_encoder_rotation(void) { int r = rotation; rotation = 0; return r; }
+bool is_encoder_button_pressed(void) { bool p = is_pressed; is_pressed = false; return p; }
+bool is_sw0_pressed(void) { bool p = is_sw0; is_sw0 = false; return p; }
+bool is_sw2_pressed(void) { bool p = is_sw2; is_sw2 = false; return p; }
+void encoder_gpio_handler(uint gpio, uint32_t events_mask) { (void)gpio; (void)events_mask; }
+void piezo_irq_handler(uint gpio, uint32_t events) { (void)gpio; (void)events; }
+void observer_gpio_handler(uint gpio, uint32_t events) { (void)gpio; (void)events; }
+LoraStatus_t lora_get_status() { return lora_status; }
+void lora_get_ready_to_join() {}
+bool lora_send_message(const char *msg) { (void)msg; return lora_status == LORA_STATUS_JOINED; }
+void dispenser_calibration() { sleep_ms(8000); is_calibrated = true; }
+void dispenser_recalibrate_from_poweroff() { sleep_ms(3000); is_calibrated = true; }
+void dispenser_clear_boot_flag() { was_running_at_boot = false; }
+bool is_calibrated_dispenser() { return is_calibrated; }
+bool dispenser_was_motor_running_at_boot() { return was_running_at_boot; }
+void dispenser_set_period(uint8_t p) { period = p; }
+uint8_t dispenser_get_period() { return period; }
+uint8_t dispenser_get_dispensed_count() { return dispensed; }
+void dispenser_report_drop_latency() {}
+void eeprom_writer_report() {}
+void eeprom_export() {}
+void log_read_all() {}
+void log_write_event(uint8_t event, uint8_t wheel, uint16_t arg0, uint16_t arg1) {
+    (void)event; (void)wheel; (void)arg0; (void)arg1;
+}
+
+bool do_dispense_single_round() {
+    sleep_ms(1500);
+    if (failed_rounds_left > 0) {
+        failed_rounds_left--;
+        return false;
+    }
+    dispensed++;
+    return true;
+}
+
+// 2. the script
+typedef enum { STEP_LOOP, STEP_TURN, STEP_PRESS, STEP_SW0, STEP_SW2, STEP_LORA, STEP_EMPTY, STEP_POWER_CUT,
+               STEP_RESET_BUTTON } StepKind;
+
+typedef struct {
+    const char *label;
+    StepKind kind;
+    int value; // turn: steps, lora: status, empty: failed rounds
+} Step;
+
+static const Step script[] = {
+        { "welcome",                      STEP_LOOP,          0 },
+        { "welcome idle",                 STEP_LOOP,          0 },
+        { "welcome turn",                 STEP_TURN,          1 },
+        { "welcome turn back",            STEP_TURN,          -1 },
+        { "choose LoRa",                  STEP_PRESS,         0 },
+        { "LoRa joining",                 STEP_LOOP,          0 },
+        { "LoRa joined",                  STEP_LORA,          LORA_STATUS_JOINED },
+        { "main menu idle",               STEP_LOOP,          0 },
+        { "main menu turn",               STEP_TURN,          1 },
+        { "set period",                   STEP_PRESS,         0 },
+        { "set period -1",                STEP_SW0,           0 },
+        { "set period +1",                STEP_SW2,           0 },
+        { "set period confirm",           STEP_PRESS,         0 },
+        { "main menu turn back",          STEP_TURN,          -1 },
+        { "get pills",                    STEP_PRESS,         0 },
+        { "calibrate",                    STEP_PRESS,         0 },
+        { "wheel empty from here",        STEP_EMPTY,         MAX_DISPENSE_RETRIES },
+        { "run, pills run out",           STEP_PRESS,         0 },
+        { "empty idle",                   STEP_LOOP,          0 },
+        { "refill, recover, dispense",    STEP_PRESS,         0 },
+        { "power cut, recover",           STEP_POWER_CUT,     0 },
+        { "main menu idle",               STEP_LOOP,          0 },
+        { "reset button, LoRa fails",     STEP_RESET_BUTTON,  0 },
+        { "choose LoRa",                  STEP_PRESS,         0 },
+        { "LoRa failed",                  STEP_LORA,          LORA_STATUS_FAILED },
+};
+
+static int failures = 0;
+
+static void check(bool is_ok, const char *what) {
+    fprintf(stderr, "%-58s %s\n", what, is_ok ? "ok" : "FAILED");
+    if (!is_ok) failures++;
+}
+
+static void run_step(const Step *step) {
+    switch (step->kind) {
+        case STEP_TURN: rotation = step->value; break;
+        case STEP_PRESS: is_pressed = true; break;
+        case STEP_SW0: is_sw0 = true; break;
+        case STEP_SW2: is_sw2 = true; break;
+        case STEP_LORA: lora_status = (LoraStatus_t)step->value; break;
+        case STEP_EMPTY:
+            failed_rounds_left = step->value;
+            return; // only arms the next dispense
+        case STEP_POWER_CUT: // half way through the period, the motor turning
+        case STEP_RESET_BUTTON: // the period done
+            if (step->kind == STEP_POWER_CUT) {
+                sim_vreg_and_chip_reset.chip_reset |= VREG_AND_CHIP_RESET_CHIP_RESET_HAD_POR_BITS;
+            }
+            was_running_at_boot = step->kind == STEP_POWER_CUT;
+            dispensed = was_running_at_boot ? period / 2 : period;
+            lora_status = LORA_STATUS_JOINING;
+            // as main() boots, the framebuffer cleared as a fresh one would be
+            statemachine_init();
+            oled_clear();
+            oled_init_minimal();
+            oled_invalidate();
+            break;
+        default:
+            break;
+    }
+    // then loop until the screen settles, an input often runs several states before the next one waits
+    const Ssd1306Stats *panel = ssd1306_get_stats();
+    for (int i = 0; i < SETTLE_MAX_LOOPS; i++) {
+        uint64_t frames = panel->frames;
+        statemachine_loop();
+        oled_commit();
+        if (panel->frames == frames) break;
+    }
+}
+
+// 3. the text cells
+static uint32_t glyphs_of(uint8_t x, uint8_t y, const char *str) {
+    uint32_t before = oled_get_stats()->glyph_draws;
+    oled_show_string(x, y, str);
+    return oled_get_stats()->glyph_draws - before;
+}
+
+static bool commit_sends_nothing() {
+    uint64_t frames = ssd1306_get_stats()->frames;
+    oled_commit();
+    return ssd1306_get_stats()->frames == frames;
+}
+
+static void cells() {
+    oled_clear();
+    oled_commit();
+    check(glyphs_of(8, 0, "Main menu") == 8, "after a clear the space is free");
+    oled_commit();
+    uint32_t screen = ssd1306_hash();
+    check(glyphs_of(8, 0, "Main menu") == 0 && commit_sends_nothing(), "the same text again draws nothing");
+
+    check(glyphs_of(0, 2, "12 ") == 2 && glyphs_of(0, 2, "13 ") == 1, "a padded number draws the changed digit");
+    check(glyphs_of(0, 2, "   ") == 2, "and blanks the digits that were there");
+    oled_commit();
+    check(ssd1306_hash() == screen, "back to the same screen");
+
+    // x 12 covers the cells at x 8, 16 and 24 in part
+    glyphs_of(12, 0, "ab");
+    check(glyphs_of(8, 0, "Main menu") == 3, "text off the grid sideways: its 3 cells draw again");
+    oled_commit();
+    check(ssd1306_hash() == screen, "back to the same screen");
+
+    // page 1 covers rows 0 and 1
+    glyphs_of(8, 1, "ab");
+    uint32_t glyphs = glyphs_of(8, 0, "Main menu") + glyphs_of(8, 2, "  ");
+    check(glyphs == 4, "text off the grid downwards: its 4 cells draw again");
+    oled_commit();
+    check(ssd1306_hash() == screen, "back to the same screen");
+
+    oled_show_big_string(0, 4, "12");
+    glyphs = glyphs_of(0, 4, "    ") + glyphs_of(0, 6, "    ");
+    check(glyphs == 8, "big digits: the 8 cells under them draw again");
+    oled_commit();
+    check(ssd1306_hash() == screen, "back to the same screen");
+}
+
+int main(int argc, char **argv) {
+    bool is_verbose = false;
+    bool is_cells = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) {
+            is_verbose = true;
+        } else if (strcmp(argv[i], "cells") == 0) {
+            is_cells = true;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            static char pattern[240];
+            snprintf(pattern, sizeof(pattern), "%s/%%04u.png", argv[++i]);
+            ssd1306_set_snapshots(pattern);
+        } else {
+            fprintf(stderr, "usage: oled_sim [-v] [-o frames] [cells]\n");
+            return 2;
+        }
+    }
+    if (!is_verbose) freopen("/dev/null", "w", stdout);
+    sim_i2c_attach(&ssd1306_device);
+
+    oled_init();
+    oled_init_minimal();
+    oled_invalidate();
+    statemachine_init();
+
+    const SimI2cStats *bus = sim_i2c_get_stats(OLED_I2C_BUS);
+    const Ssd1306Stats *panel = ssd1306_get_stats();
+    fprintf(stderr, "%-28s %7s %6s %6s %9s %9s  %s\n", "step", "frames", "bytes", "writes", "bus ms", "glyphs",
+            "screen");
+    uint64_t total_bytes = 0;
+    uint32_t glyphs_before = oled_get_stats()->glyph_draws;
+    for (size_t i = 0; i < sizeof(script) / sizeof(script[0]); i++) {
+        SimI2cStats before = *bus;
+        uint64_t first_frame = panel->frames + 1;
+        run_step(&script[i]);
+        char frames[24] = "-";
+        if (panel->frames >= first_frame) {
+            snprintf(frames, sizeof(frames), "%llu-%llu", (unsigned long long)first_frame,
+                     (unsigned long long)panel->frames);
+        }
+        uint32_t glyphs = oled_get_stats()->glyph_draws;
+        fprintf(stderr, "%-28s %7s %6llu %6llu %9.2f %9u  %08x\n", script[i].label, frames,
+                (unsigned long long)(bus->bytes - before.bytes),
+                (unsigned long long)(bus->transactions - before.transactions),
+                (bus->bus_time_ns - before.bus_time_ns) / 1e6, glyphs - glyphs_before, ssd1306_hash());
+        // the cells keep a step that leaves the screen as it was from drawing
+        if (is_cells && panel->frames < first_frame && glyphs != glyphs_before) {
+            fprintf(stderr, "%s: %u glyphs drawn, the screen did not change\n", script[i].label,
+                    glyphs - glyphs_before);
+            failures++;
+        }
+        glyphs_before = glyphs;
+        total_bytes += bus->bytes - before.bytes;
+    }
+    fprintf(stderr, "%llu frames, %llu I2C bytes, %llu SSD1306 commands, %llu unknown\n",
+            (unsigned long long)panel->frames, (unsigned long long)total_bytes,
+            (unsigned long long)panel->commands, (unsigned long long)panel->unknown_commands);
+    if (is_cells) {
+        check(failures == 0, "no glyph drawn by a step that left the screen as it was");
+        cells();
+    }
+    return panel->unknown_commands || failures ? 1 : 0;
+}
@@ -0,0 +1,142 @@
+// Replays the piezo traces a dispenser printed on its uart through the firmware's own
+// pill_classifier.c on a PC, to check and tune the classifier against real drops.
+//
+// build: cc -std=c11 -O2 -Isrc/logic -o piezo_replay tools/piezo_replay.c src/logic/pill_classifier.c
+// run:   ./piezo_replay uart.log
+//        ./piezo_replay < uart.log
+//
+// uart.log is the dispenser's stdio as any terminal captured it. Only the [Trace] dumps of
+// dump_piezo_trace() are read, everything else in between is skipped. Set PIEZO_TRACE_DUMP_ALL
+// to get every drop dumped, not just the ones that were no single pill. For each trace it prints
+// the features, the class now and the class the dispenser gave it, and how long the extract and
+// classify took here; a change of the thresholds in pill_classifier.h shows up as changed classes.
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pill_classifier.h"
+
+#define MAX_SAMPLES 4096
+#define TIMING_LOOPS 1000 // one classification is too short for the clock
+
+typedef struct {
+    unsigned wheel;
+    unsigned hz;
+    char recorded[16];
+    unsigned long count; // samples the header announced
+    uint16_t samples[MAX_SAMPLES];
+    uint32_t read; // samples found so far
+} Trace;
+
+static const char *const class_names[] = { "none", "noise", "single", "double" };
+#define CLASS_COUNT (sizeof(class_names) / sizeof(class_names[0]))
+
+static uint32_t traces = 0;
+static uint32_t changed = 0;
+static uint32_t confusion[CLASS_COUNT][CLASS_COUNT]; // [recorded][now]
+static double total_ns = 0;
+
+static int class_index(const char *name) {
+    for (size_t i = 0; i < CLASS_COUNT; i++) {
+        if (strcmp(name, class_names[i]) == 0) return (int)i;
+    }
+    return -1;
+}
+
+static double now_ns() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static void replay(const Trace *trace) {
+    PillFeatures features;
+    PillClass pill_class = PILL_CLASS_NONE;
+    double start_ns = now_ns();
+    for (int i = 0; i < TIMING_LOOPS; i++) {
+        pill_classifier_extract(trace->samples, trace->read, &features);
+        pill_class = pill_classifier_classify(&features);
+    }
+    double ns = (now_ns() - start_ns) / TIMING_LOOPS;
+    total_ns += ns;
+
+    const char *name = pill_class_name(pill_class);
+    bool is_changed = strcmp(name, trace->recorded) != 0;
+    int recorded = class_index(trace->recorded);
+    if (recorded >= 0 && (size_t)pill_class < CLASS_COUNT) confusion[recorded][pill_class]++;
+    if (is_changed) changed++;
+    printf("%5u %5u %7.1f %8u %5u %10lu %8u %6u %9u-%-5u %-7s %-7s %8.0f%s\n", ++traces, trace->wheel,
+           trace->hz ? trace->read * 1000.0 / trace->hz : 0.0, features.baseline, features.peak,
+           (unsigned long)features.energy, features.duration, features.bursts, features.first_active,
+           features.last_active, trace->recorded, name, ns, is_changed ? "  changed" : "");
+}
+
+// a header starts a trace, sample lines fill it; replayed once it has all of its samples
+static void parse_line(const char *line, Trace *trace, bool *is_open) {
+    const char *tag = strstr(line, "[Trace]");
+    if (!tag) return;
+    const char *p = tag + strlen("[Trace]");
+    if (strncmp(p, " wheel=", 7) == 0) {
+        if (*is_open) fprintf(stderr, "trace %u cut short at %u of %lu samples\n", traces + 1, trace->read, trace->count);
+        *is_open = false;
+        if (sscanf(p, " wheel=%u hz=%u class=%15s n=%lu", &trace->wheel, &trace->hz, trace->recorded,
+                   &trace->count) != 4) {
+            fprintf(stderr, "bad trace header: %s", tag);
+            return;
+        }
+        if (trace->count > MAX_SAMPLES) {
+            fprintf(stderr, "trace of %lu samples, only the first %d are read\n", trace->count, MAX_SAMPLES);
+            trace->count = MAX_SAMPLES;
+        }
+        trace->read = 0;
+        *is_open = true;
+        return;
+    }
+    if (!*is_open) return;
+    char *end;
+    while (trace->read < trace->count) {
+        unsigned long sample = strtoul(p, &end, 16);
+        if (end == p) break;
+        trace->samples[trace->read++] = (uint16_t)sample;
+        p = end;
+    }
+    if (trace->read == trace->count) {
+        replay(trace);
+        *is_open = false;
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc > 2) {
+        fprintf(stderr, "usage: piezo_replay [uart.log]\n");
+        return 2;
+    }
+    FILE *in = argc == 2 ? fopen(argv[1], "r") : stdin;
+    if (!in) {
+        perror(argv[1]);
+        return 1;
+    }
+    static Trace trace;
+    bool is_open = false;
+    char line[512];
+    printf("%5s %5s %7s %8s %5s %10s %8s %6s %15s %-7s %-7s %8s\n", "trace", "wheel", "ms", "baseline", "peak",
+           "energy", "duration", "bursts", "active", "was", "now", "ns");
+    while (fgets(line, sizeof(line), in)) parse_line(line, &trace, &is_open);
+    if (is_open) fprintf(stderr, "trace %u cut short at %u of %lu samples\n", traces + 1, trace.read, trace.count);
+    if (in != stdin) fclose(in);
+
+    printf("\n%u traces, %u classed differently now, %.0f ns a classification\n", traces, changed,
+           traces ? total_ns / traces : 0.0);
+    if (!traces) return 0;
+    printf("%-8s", "was\\now");
+    for (size_t j = 0; j < CLASS_COUNT; j++) printf(" %7s", class_names[j]);
+    printf("\n");
+    for (size_t i = 0; i < CLASS_COUNT; i++) {
+        printf("%-8s", class_names[i]);
+        for (size_t j = 0; j < CLASS_COUNT; j++) printf(" %7u", confusion[i][j]);
+        printf("\n");
+    }
+    return 0;
+}
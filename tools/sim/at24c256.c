@@ -0,0 +1,133 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "i2c_hal.h"
+#include "sim.h"
+
+#define AT24C256_ADDR 0x50
+
+static uint8_t *image = NULL;
+static int image_fd = -1;
+static uint16_t address = 0; // the part's address counter
+static bool is_write_open = false; // a write transfer waits for its STOP
+static uint8_t page_latch[AT24C256_PAGE_SIZE];
+static bool is_latched[AT24C256_PAGE_SIZE]; // bytes of the page the write clocked in
+static uint8_t page_before[AT24C256_PAGE_SIZE]; // for a power cut during the write cycle
+static uint16_t programming_page = 0;
+static uint16_t latch_page = 0;
+static uint16_t latch_start = 0; // offset in the page of the first data byte
+static uint16_t latch_length = 0; // data bytes clocked in, more than a page wraps
+static uint64_t busy_until_us = 0;
+static At24c256Stats stats;
+
+static bool is_busy() {
+    if (sim_time_us() < busy_until_us) {
+        stats.busy_nacks++;
+        return true;
+    }
+    return false;
+}
+
+// two address bytes, then data into the page latch. only a STOP starts the write cycle.
+static int at24c256_write(const uint8_t *src, size_t length) {
+    if (is_busy()) return I2C_HAL_ERROR;
+    if (length < 2) return (int)length;
+    address = (uint16_t)(((src[0] << 8) | src[1]) % AT24C256_SIZE);
+    latch_page = address / AT24C256_PAGE_SIZE * AT24C256_PAGE_SIZE;
+    latch_start = address % AT24C256_PAGE_SIZE;
+    latch_length = 0;
+    memcpy(page_latch, &image[latch_page], AT24C256_PAGE_SIZE);
+    memset(is_latched, 0, sizeof(is_latched));
+    for (size_t i = 2; i < length; i++) {
+        page_latch[address % AT24C256_PAGE_SIZE] = src[i];
+        is_latched[address % AT24C256_PAGE_SIZE] = true;
+        address = (uint16_t)(latch_page + (address + 1) % AT24C256_PAGE_SIZE);
+        latch_length++;
+    }
+    is_write_open = latch_length > 0;
+    return (int)length;
+}
+
+// sequential from the address counter, across pages and from the end round to 0
+static int at24c256_read(uint8_t *dst, size_t length) {
+    if (is_busy()) return I2C_HAL_ERROR;
+    is_write_open = false; // a repeated start after the address bytes: a random read
+    for (size_t i = 0; i < length; i++) {
+        dst[i] = image[address];
+        address = (uint16_t)((address + 1) % AT24C256_SIZE);
+    }
+    return (int)length;
+}
+
+static void at24c256_stop(void) {
+    if (!is_write_open) return;
+    is_write_open = false;
+    memcpy(page_before, &image[latch_page], AT24C256_PAGE_SIZE);
+    memcpy(&image[latch_page], page_latch, AT24C256_PAGE_SIZE);
+    programming_page = latch_page;
+    busy_until_us = sim_time_us() + AT24C256_WRITE_CYCLE_US;
+    stats.page_writes++;
+    stats.page_wear[latch_page / AT24C256_PAGE_SIZE]++;
+    if (latch_start + latch_length > AT24C256_PAGE_SIZE) stats.wrapped_writes++;
+}
+
+// the bytes of a write cut off in its write cycle hold a mix of old and new values
+static void at24c256_power_cut(void) {
+    if (sim_time_us() < busy_until_us) {
+        for (int i = 0; i < AT24C256_PAGE_SIZE; i++) {
+            if (is_latched[i] && (rand() & 1)) image[programming_page + i] = page_before[i];
+        }
+        stats.torn_pages++;
+    }
+    msync(image, AT24C256_SIZE, MS_SYNC);
+}
+
+const SimI2cDevice at24c256_device = {
+        .bus = 0,
+        .addr = AT24C256_ADDR,
+        .write = at24c256_write,
+        .read = at24c256_read,
+        .stop = at24c256_stop,
+        .power_cut = at24c256_power_cut,
+};
+
+bool at24c256_open(const char *path) {
+    image_fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (image_fd < 0) return false;
+    struct stat st;
+    if (fstat(image_fd, &st) != 0) return false;
+    if (st.st_size < AT24C256_SIZE) {
+        uint8_t erased[AT24C256_SIZE];
+        memset(erased, 0xFF, sizeof(erased));
+        if (pwrite(image_fd, erased + st.st_size, AT24C256_SIZE - st.st_size, st.st_size) < 0) return false;
+    }
+    image = mmap(NULL, AT24C256_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, image_fd, 0);
+    if (image == MAP_FAILED) {
+        image = NULL;
+        return false;
+    }
+    return true;
+}
+
+// the whole part back to 0xFF as it leaves the factory, no write cycle
+void at24c256_erase(void) {
+    memset(image, 0xFF, AT24C256_SIZE);
+    busy_until_us = 0;
+}
+
+void at24c256_close(void) {
+    if (image) {
+        msync(image, AT24C256_SIZE, MS_SYNC);
+        munmap(image, AT24C256_SIZE);
+    }
+    if (image_fd >= 0) close(image_fd);
+    image = NULL;
+    image_fd = -1;
+}
+
+const At24c256Stats *at24c256_get_stats(void) {
+    return &stats;
+}
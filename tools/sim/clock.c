@@ -0,0 +1,48 @@
+// The simulated clock of the host builds. Nothing moves it but the firmware waiting: sleeps,
+// busy loops and, with the I2C models, bus transfers. The hook runs the hardware models first.
+#include <stdio.h>
+#include <unistd.h>
+#include "sim.h"
+#include "hardware/structs/vreg_and_chip_reset.h"
+
+static uint64_t now_ns = 0;
+static uint64_t power_cut_ns = 0; // 0: none
+static void (*power_cut_hook)(void) = NULL;
+
+vreg_and_chip_reset_hw_t sim_vreg_and_chip_reset = { .chip_reset = VREG_AND_CHIP_RESET_CHIP_RESET_HAD_POR_BITS };
+static void (*advance_hook)(uint64_t now_ns) = NULL;
+
+uint64_t sim_time_us(void) {
+    return now_ns / 1000;
+}
+
+uint64_t sim_time_ns(void) {
+    return now_ns;
+}
+
+void sim_advance_ns(uint64_t ns) {
+    uint64_t target_ns = now_ns + ns;
+    if (advance_hook) advance_hook(target_ns);
+    now_ns = target_ns;
+    if (power_cut_ns && now_ns >= power_cut_ns) {
+        if (power_cut_hook) power_cut_hook();
+        fflush(stdout);
+        _exit(SIM_POWER_CUT_EXIT);
+    }
+}
+
+void sim_on_advance(void (*run)(uint64_t now_ns)) {
+    advance_hook = run;
+}
+
+void sim_clock_to_ns(uint64_t ns) {
+    if (ns > now_ns) now_ns = ns;
+}
+
+void sim_on_power_cut(void (*cut)(void)) {
+    power_cut_hook = cut;
+}
+
+void sim_power_cut_at_us(uint64_t us) {
+    power_cut_ns = us * 1000;
+}
@@ -0,0 +1,87 @@
+// eeprom_writer.h for host builds: the same page split, retries and ACK polling as
+// src/drivers/eeprom_writer.c, but with blocking transfers instead of DMA and the I2C IRQ.
+// one page at a time, the next transfer waits for the previous write cycle.
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "i2c_hal.h"
+#include "eeprom_writer.h"
+#include "eeprom.h"
+
+static EepromWriterStats stats;
+static bool is_programming = false; // the last page is in its write cycle
+static uint32_t page_start_us = 0;
+static size_t page_length = 0;
+
+// the part does not answer its address while it programs the page
+static void finish_page() {
+    if (!is_programming) return;
+    is_programming = false;
+    uint8_t byte;
+    while (i2c_hal_read(EEPROM_I2C_BUS, EEPROM_ADDR, &byte, 1, false) < 0) {
+        if (time_us_32() - page_start_us > EEPROM_WRITE_TIMEOUT_US) {
+            stats.pages_failed++;
+            return;
+        }
+        sleep_us(EEPROM_ACK_POLL_INTERVAL_US);
+    }
+    stats.pages_written++;
+    stats.bytes_written += page_length;
+    uint32_t page_us = time_us_32() - page_start_us;
+    if (page_us > stats.max_page_us) stats.max_page_us = page_us;
+}
+
+// returns once the page is on the bus, the write cycle overlaps whatever the caller does next
+static void write_page(uint16_t addr, const uint8_t *data_p, size_t length) {
+    uint8_t buffer[2 + EEPROM_PAGE_SIZE];
+    buffer[0] = (uint8_t)(addr >> 8);
+    buffer[1] = (uint8_t)(addr & 0xFF);
+    memcpy(&buffer[2], data_p, length);
+    finish_page();
+    page_start_us = time_us_32();
+    for (int retry = 0; retry < EEPROM_WRITER_RETRIES; retry++) {
+        if (i2c_hal_write(EEPROM_I2C_BUS, EEPROM_ADDR, buffer, 2 + length, false) >= 0) {
+            is_programming = true;
+            page_length = length;
+            return;
+        }
+        sleep_us(EEPROM_ACK_POLL_INTERVAL_US);
+    }
+    stats.pages_failed++;
+}
+
+void eeprom_writer_init() {
+}
+
+void eeprom_writer_write(uint16_t addr, const uint8_t *data_p, size_t length) {
+    while (length > 0) {
+        // a page write wraps inside its 64 byte page, so longer or unaligned writes are split
+        size_t chunk = EEPROM_PAGE_SIZE - (addr % EEPROM_PAGE_SIZE);
+        if (chunk > length) chunk = length;
+        write_page(addr, data_p, chunk);
+        addr += chunk;
+        data_p += chunk;
+        length -= chunk;
+    }
+}
+
+// the ACK poll is bounded already, there is no irq to get stuck on
+bool eeprom_writer_flush() {
+    uint32_t start_us = time_us_32();
+    uint32_t failed = stats.pages_failed;
+    finish_page();
+    uint32_t flush_us = time_us_32() - start_us;
+    if (flush_us > stats.max_flush_us) stats.max_flush_us = flush_us;
+    return stats.pages_failed == failed;
+}
+
+const EepromWriterStats *eeprom_writer_get_stats() {
+    return &stats;
+}
+
+void eeprom_writer_report() {
+    printf("[EEPROM] %lu pages, %lu bytes written, %lu failed\n",
+           (unsigned long)stats.pages_written, (unsigned long)stats.bytes_written, (unsigned long)stats.pages_failed);
+    printf("[EEPROM] page max %lu us, flush max %lu us\n",
+           (unsigned long)stats.max_page_us, (unsigned long)stats.max_flush_us);
+}
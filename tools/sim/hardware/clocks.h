@@ -0,0 +1,15 @@
+//
+// Host stand-in for the Pico SDK header, clk_sys at its default 125 MHz.
+//
+
+#ifndef PILLDISPENSER_SIM_HARDWARE_CLOCKS_H
+#define PILLDISPENSER_SIM_HARDWARE_CLOCKS_H
+#include "pico/types.h"
+
+enum clock_index { clk_sys = 5 };
+
+#define SIM_CLK_SYS_HZ 125000000u
+
+static inline uint32_t clock_get_hz(enum clock_index clk_index) { (void)clk_index; return SIM_CLK_SYS_HZ; }
+
+#endif //PILLDISPENSER_SIM_HARDWARE_CLOCKS_H
@@ -0,0 +1,47 @@
+//
+// Host stand-in for the Pico SDK header: 12 channels in rp2040.c, paced by the DREQ of a PIO or
+// I2C TX FIFO. a channel moves its words as soon as the FIFO has room, the irq runs when it is done.
+//
+
+#ifndef PILLDISPENSER_SIM_HARDWARE_DMA_H
+#define PILLDISPENSER_SIM_HARDWARE_DMA_H
+#include "pico/types.h"
+#include "hardware/irq.h"
+
+#define NUM_DMA_CHANNELS 12
+
+enum dma_channel_transfer_size { DMA_SIZE_8 = 0, DMA_SIZE_16 = 1, DMA_SIZE_32 = 2 };
+
+typedef struct {
+    volatile uint32_t read_addr;
+    volatile uint32_t write_addr;
+    volatile uint32_t transfer_count;
+    volatile uint32_t ctrl_trig;
+} dma_channel_hw_t;
+
+typedef struct {
+    enum dma_channel_transfer_size size;
+    bool read_increment;
+    bool write_increment;
+    uint dreq;
+} dma_channel_config;
+
+int dma_claim_unused_channel(bool required);
+dma_channel_config dma_channel_get_default_config(uint channel);
+static inline void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size) {
+    c->size = size;
+}
+static inline void channel_config_set_read_increment(dma_channel_config *c, bool incr) { c->read_increment = incr; }
+static inline void channel_config_set_write_increment(dma_channel_config *c, bool incr) { c->write_increment = incr; }
+static inline void channel_config_set_dreq(dma_channel_config *c, uint dreq) { c->dreq = dreq; }
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger);
+void dma_channel_transfer_from_buffer_now(uint channel, const volatile void *read_addr, uint32_t transfer_count);
+void dma_channel_set_irq0_enabled(uint channel, bool enabled);
+bool dma_channel_get_irq0_status(uint channel);
+void dma_channel_acknowledge_irq0(uint channel);
+void dma_channel_abort(uint channel);
+bool dma_channel_is_busy(uint channel);
+dma_channel_hw_t *dma_channel_hw_addr(uint channel);
+
+#endif //PILLDISPENSER_SIM_HARDWARE_DMA_H
@@ -0,0 +1,40 @@
+//
+// Host stand-in for the Pico SDK header: inputs are set by the models in tools/sim, outputs
+// go out through rp2040.c to whatever listens to the pads.
+//
+
+#ifndef PILLDISPENSER_SIM_HARDWARE_GPIO_H
+#define PILLDISPENSER_SIM_HARDWARE_GPIO_H
+#include "pico/types.h"
+
+#define GPIO_IN false
+#define GPIO_OUT true
+#define NUM_BANK0_GPIOS 30
+
+enum gpio_function {
+    GPIO_FUNC_I2C = 3,
+    GPIO_FUNC_SIO = 5,
+    GPIO_FUNC_PIO0 = 6,
+    GPIO_FUNC_PIO1 = 7,
+};
+
+enum gpio_irq_level {
+    GPIO_IRQ_LEVEL_LOW = 0x1u,
+    GPIO_IRQ_LEVEL_HIGH = 0x2u,
+    GPIO_IRQ_EDGE_FALL = 0x4u,
+    GPIO_IRQ_EDGE_RISE = 0x8u,
+};
+
+typedef void (*gpio_irq_callback_t)(uint gpio, uint32_t event_mask);
+
+void gpio_init(uint gpio);
+void gpio_set_function(uint gpio, enum gpio_function fn);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_put(uint gpio, bool value);
+void gpio_pull_up(uint gpio);
+void gpio_disable_pulls(uint gpio);
+bool gpio_get(uint gpio);
+void gpio_set_irq_enabled(uint gpio, uint32_t event_mask, bool enabled);
+void gpio_set_irq_callback(gpio_irq_callback_t callback);
+
+#endif //PILLDISPENSER_SIM_HARDWARE_GPIO_H
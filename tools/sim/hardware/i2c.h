@@ -0,0 +1,51 @@
+//
+// Host stand-in for the Pico SDK header: the registers of the two I2C controllers that
+// eeprom_writer.c drives, modelled in rp2040.c. the controller clocks the commands of its TX
+// FIFO out on the bus of tools/sim at the baud rate i2c_hal_init() set for it.
+// the clr_ registers clear on read on the chip, here the bits an irq handler was called for are
+// cleared when it returns. a read's data is not kept, rxflr stays 0.
+//
+
+#ifndef PILLDISPENSER_SIM_HARDWARE_I2C_H
+#define PILLDISPENSER_SIM_HARDWARE_I2C_H
+#include "pico/types.h"
+
+#define I2C_IC_DATA_CMD_CMD_BITS 0x00000100u // read
+#define I2C_IC_DATA_CMD_STOP_BITS 0x00000200u
+#define I2C_IC_DATA_CMD_RESTART_BITS 0x00000400u
+#define I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS 0x00000040u
+#define I2C_IC_RAW_INTR_STAT_STOP_DET_BITS 0x00000200u
+#define I2C_IC_INTR_MASK_M_TX_ABRT_BITS 0x00000040u
+#define I2C_IC_INTR_MASK_M_STOP_DET_BITS 0x00000200u
+
+#define DREQ_I2C0_TX 32
+#define DREQ_I2C0_RX 33
+
+typedef struct {
+    volatile uint32_t tar;
+    volatile uint32_t data_cmd;
+    volatile uint32_t intr_mask;
+    volatile uint32_t raw_intr_stat;
+    volatile uint32_t clr_tx_abrt;
+    volatile uint32_t clr_stop_det;
+    volatile uint32_t enable;
+    volatile uint32_t txflr;
+    volatile uint32_t rxflr;
+} i2c_hw_t;
+
+typedef struct i2c_inst {
+    i2c_hw_t *hw;
+} i2c_inst_t;
+
+extern i2c_hw_t sim_i2c_hw[2];
+extern i2c_inst_t sim_i2c_inst[2];
+#define i2c0 (&sim_i2c_inst[0])
+#define i2c1 (&sim_i2c_inst[1])
+
+static inline i2c_hw_t *i2c_get_hw(i2c_inst_t *i2c) { return i2c->hw; }
+static inline uint i2c_hw_index(i2c_inst_t *i2c) { return i2c == i2c1 ? 1 : 0; }
+static inline uint i2c_get_dreq(i2c_inst_t *i2c, bool is_tx) {
+    return DREQ_I2C0_TX + 2 * i2c_hw_index(i2c) + (is_tx ? 0 : 1);
+}
+
+#endif //PILLDISPENSER_SIM_HARDWARE_I2C_H
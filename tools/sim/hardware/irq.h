@@ -0,0 +1,22 @@
+//
+// Host stand-in for the Pico SDK header: shared DMA handlers and the exclusive I2C ones, run by
+// the DMA and I2C models in rp2040.c.
+//
+
+#ifndef PILLDISPENSER_SIM_HARDWARE_IRQ_H
+#define PILLDISPENSER_SIM_HARDWARE_IRQ_H
+#include "pico/types.h"
+
+#define DMA_IRQ_0 11
+#define DMA_IRQ_1 12
+#define I2C0_IRQ 23
+#define I2C1_IRQ 24
+#define PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY 0x80
+
+typedef void (*irq_handler_t)(void);
+
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_priority);
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+void irq_set_enabled(uint num, bool enabled);
+
+#endif //PILLDISPENSER_SIM_HARDWARE_IRQ_H
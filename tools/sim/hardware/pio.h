@@ -0,0 +1,90 @@
+//
+// Host stand-in for the Pico SDK header: pio0 and pio1 with 4 state machines each, run in
+// rp2040.c one instruction per clock divider period of the simulated clock. JMP, OUT, PULL and
+// MOV are modelled, which is all stepper.pio uses.
+//
+
+#ifndef PILLDISPENSER_SIM_HARDWARE_PIO_H
+#define PILLDISPENSER_SIM_HARDWARE_PIO_H
+#include "pico/types.h"
+#include "hardware/gpio.h"
+
+#define NUM_PIO_STATE_MACHINES 4
+#define PIO_INSTRUCTION_COUNT 32
+
+typedef struct {
+    volatile uint32_t txf[NUM_PIO_STATE_MACHINES]; // only the address is used, DMA goes by DREQ
+} pio_hw_t;
+
+typedef pio_hw_t *PIO;
+extern pio_hw_t sim_pio_hw[2];
+#define pio0 (&sim_pio_hw[0])
+#define pio1 (&sim_pio_hw[1])
+
+typedef struct pio_program {
+    const uint16_t *instructions;
+    uint8_t length;
+    int8_t origin; // -1: anywhere
+} pio_program_t;
+
+typedef struct {
+    uint16_t clkdiv_int;
+    uint8_t clkdiv_frac;
+    uint wrap_target;
+    uint wrap;
+    uint out_base;
+    uint out_count;
+    bool out_shift_right;
+    bool autopull;
+    uint pull_threshold;
+    bool join_tx;
+} pio_sm_config;
+
+enum pio_fifo_join { PIO_FIFO_JOIN_NONE = 0, PIO_FIFO_JOIN_TX = 1, PIO_FIFO_JOIN_RX = 2 };
+enum pio_src_dest { pio_pins = 0, pio_x = 1, pio_y = 2, pio_null = 3, pio_isr = 6, pio_osr = 7 };
+
+static inline pio_sm_config pio_get_default_sm_config(void) {
+    return (pio_sm_config){ .clkdiv_int = 1, .wrap = 31, .out_shift_right = true, .pull_threshold = 32 };
+}
+static inline void sm_config_set_wrap(pio_sm_config *c, uint wrap_target, uint wrap) {
+    c->wrap_target = wrap_target;
+    c->wrap = wrap;
+}
+static inline void sm_config_set_out_pins(pio_sm_config *c, uint out_base, uint out_count) {
+    c->out_base = out_base;
+    c->out_count = out_count;
+}
+static inline void sm_config_set_out_shift(pio_sm_config *c, bool shift_right, bool autopull, uint pull_threshold) {
+    c->out_shift_right = shift_right;
+    c->autopull = autopull;
+    c->pull_threshold = pull_threshold;
+}
+static inline void sm_config_set_fifo_join(pio_sm_config *c, enum pio_fifo_join join) {
+    c->join_tx = join == PIO_FIFO_JOIN_TX;
+}
+static inline void sm_config_set_clkdiv_int_frac(pio_sm_config *c, uint16_t div_int, uint8_t div_frac) {
+    c->clkdiv_int = div_int;
+    c->clkdiv_frac = div_frac;
+}
+static inline uint pio_encode_mov(enum pio_src_dest dest, enum pio_src_dest src) {
+    return 0xA000u | (uint)dest << 5 | (uint)src;
+}
+static inline uint pio_get_index(PIO pio) { return pio == pio1 ? 1u : 0u; }
+static inline uint pio_get_dreq(PIO pio, uint sm, bool is_tx) {
+    return pio_get_index(pio) * 8 + (is_tx ? 0 : 4) + sm;
+}
+
+uint pio_add_program(PIO pio, const pio_program_t *program);
+int pio_claim_unused_sm(PIO pio, bool required);
+void pio_gpio_init(PIO pio, uint pin);
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config);
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled);
+void pio_sm_set_pins_with_mask(PIO pio, uint sm, uint32_t pin_values, uint32_t pin_mask);
+void pio_sm_set_pindirs_with_mask(PIO pio, uint sm, uint32_t pin_dirs, uint32_t pin_mask);
+void pio_sm_put_blocking(PIO pio, uint sm, uint32_t data);
+void pio_sm_exec(PIO pio, uint sm, uint instr);
+bool pio_sm_is_tx_fifo_empty(PIO pio, uint sm);
+uint pio_sm_get_tx_fifo_level(PIO pio, uint sm);
+uint8_t pio_sm_get_pc(PIO pio, uint sm);
+
+#endif //PILLDISPENSER_SIM_HARDWARE_PIO_H
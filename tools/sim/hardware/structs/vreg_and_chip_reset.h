@@ -0,0 +1,25 @@
+//
+// Host stand-in for the Pico SDK header: the reset reason register, in clock.c with the
+// simulated clock. a power-on reset by default, a harness sets the bit again to boot after a power cut.
+//
+
+#ifndef PILLDISPENSER_SIM_VREG_AND_CHIP_RESET_H
+#define PILLDISPENSER_SIM_VREG_AND_CHIP_RESET_H
+#include <stdint.h>
+
+#define VREG_AND_CHIP_RESET_CHIP_RESET_HAD_POR_BITS 0x00000100u
+
+typedef struct {
+    uint32_t vreg;
+    uint32_t bod;
+    uint32_t chip_reset;
+} vreg_and_chip_reset_hw_t;
+
+extern vreg_and_chip_reset_hw_t sim_vreg_and_chip_reset;
+#define vreg_and_chip_reset_hw (&sim_vreg_and_chip_reset)
+
+static inline void hw_clear_bits(volatile uint32_t *address, uint32_t mask) {
+    *address &= ~mask;
+}
+
+#endif //PILLDISPENSER_SIM_VREG_AND_CHIP_RESET_H
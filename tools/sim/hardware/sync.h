@@ -0,0 +1,13 @@
+//
+// Host stand-in for the Pico SDK header. the simulated hardware only runs while the clock is
+// moved on, so there is nothing to keep out while interrupts are "disabled".
+//
+
+#ifndef PILLDISPENSER_SIM_HARDWARE_SYNC_H
+#define PILLDISPENSER_SIM_HARDWARE_SYNC_H
+#include <stdint.h>
+
+static inline uint32_t save_and_disable_interrupts(void) { return 0; }
+static inline void restore_interrupts(uint32_t status) { (void)status; }
+
+#endif //PILLDISPENSER_SIM_HARDWARE_SYNC_H
@@ -0,0 +1,10 @@
+//
+// Host stand-in for the Pico SDK header, the simulated board has no watchdog.
+//
+
+#ifndef PILLDISPENSER_SIM_HARDWARE_WATCHDOG_H
+#define PILLDISPENSER_SIM_HARDWARE_WATCHDOG_H
+
+static inline void watchdog_update(void) {}
+
+#endif //PILLDISPENSER_SIM_HARDWARE_WATCHDOG_H
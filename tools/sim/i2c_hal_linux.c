@@ -0,0 +1,145 @@
+// i2c_hal.h for host builds: the transfers go to the parts attached to the simulated bus and
+// advance the simulated clock by their time on the wire at the bus baud rate. no pins.
+// the I2C controllers in rp2040.c hand their transfers to the same parts.
+#include <stdio.h>
+#include "i2c_hal.h"
+#include "sim.h"
+
+static const SimI2cDevice *devices[SIM_I2C_DEVICES];
+static uint device_count = 0;
+static uint32_t bus_baudrate[SIM_I2C_BUSES] = { 100 * 1000, 100 * 1000 };
+static SimI2cStats stats[SIM_I2C_BUSES];
+static FILE *trace_out = NULL;
+
+static void power_cut(void) {
+    for (uint i = 0; i < device_count; i++) {
+        if (devices[i]->power_cut) devices[i]->power_cut();
+    }
+}
+
+void sim_i2c_attach(const SimI2cDevice *device) {
+    if (device_count < SIM_I2C_DEVICES) devices[device_count++] = device;
+    sim_on_power_cut(power_cut);
+}
+
+const SimI2cStats *sim_i2c_get_stats(uint bus) {
+    return &stats[bus % SIM_I2C_BUSES];
+}
+
+void sim_i2c_reset_stats(void) {
+    for (uint i = 0; i < SIM_I2C_BUSES; i++) stats[i] = (SimI2cStats){ 0 };
+}
+
+void sim_i2c_trace(FILE *out) {
+    trace_out = out;
+}
+
+#define TRACE_BYTES 8
+
+static void trace(uint bus, uint64_t start_ns, uint8_t addr, const uint8_t *data, size_t length, bool is_read,
+                  bool is_ack, bool nostop) {
+    fprintf(trace_out, "%10.3f ms  bus%u %c 0x%02X ", start_ns / 1e6, bus, is_read ? 'R' : 'W', addr);
+    if (!is_ack) {
+        fprintf(trace_out, "NACK\n");
+        return;
+    }
+    fprintf(trace_out, "ACK  %3zu bytes%s ", length, nostop ? ", no STOP" : "         ");
+    for (size_t i = 0; i < length && i < TRACE_BYTES; i++) fprintf(trace_out, " %02X", data[i]);
+    fprintf(trace_out, "%s\n", length > TRACE_BYTES ? " ..." : "");
+}
+
+static const SimI2cDevice *find_device(uint bus, uint8_t addr) {
+    for (uint i = 0; i < device_count; i++) {
+        if (devices[i]->bus == bus && devices[i]->addr == addr) return devices[i];
+    }
+    return NULL;
+}
+
+// 9 clocks a byte with its ACK, one each for START and STOP
+static uint64_t bits_ns(uint bus, uint64_t bits) {
+    return bits * 1000000000ull / bus_baudrate[bus];
+}
+
+static void clock_bits(uint bus, uint64_t bits) {
+    uint64_t ns = bits_ns(bus, bits);
+    stats[bus].bus_time_ns += ns;
+    sim_advance_ns(ns);
+}
+
+void i2c_hal_init(uint bus, uint32_t baudrate, uint sda_gpio, uint scl_gpio) {
+    (void)sda_gpio;
+    (void)scl_gpio;
+    bus_baudrate[bus % SIM_I2C_BUSES] = baudrate;
+}
+
+uint32_t sim_i2c_get_baudrate(uint bus) {
+    return bus_baudrate[bus % SIM_I2C_BUSES];
+}
+
+static void count_nack(uint bus, uint64_t start_ns, uint8_t addr, bool is_read) {
+    stats[bus].transactions++;
+    stats[bus].bytes++;
+    stats[bus].nacks++;
+    if (trace_out) trace(bus, start_ns, addr, NULL, 0, is_read, false, false);
+}
+
+// the data of a transfer to a part that ACKed its address, the caller runs its STOP once it is on the wire
+static int hand_over(uint bus, uint64_t start_ns, const SimI2cDevice *device, const uint8_t *src, uint8_t *dst,
+                     size_t length, bool nostop) {
+    int result = src ? device->write(src, length) : device->read(dst, length);
+    if (result < 0) return I2C_HAL_ERROR;
+    stats[bus].transactions++;
+    stats[bus].bytes += 1 + length;
+    if (trace_out) trace(bus, start_ns, device->addr, src ? src : dst, length, !src, true, nostop);
+    return result;
+}
+
+// the address byte goes out first, the part ACKs or NACKs it at that time
+static int transfer(uint bus, uint8_t addr, const uint8_t *src, uint8_t *dst, size_t length, bool nostop) {
+    uint64_t start_ns = sim_time_ns();
+    const SimI2cDevice *device = find_device(bus, addr);
+    clock_bits(bus, 1 + 9);
+    int result = device ? hand_over(bus, start_ns, device, src, dst, length, nostop) : I2C_HAL_ERROR;
+    if (result < 0) {
+        count_nack(bus, start_ns, addr, !src);
+        clock_bits(bus, 1); // a NACK always ends with STOP
+        return I2C_HAL_ERROR;
+    }
+    clock_bits(bus, 9 * length + (nostop ? 0 : 1));
+    if (!nostop && device->stop) device->stop();
+    return result;
+}
+
+int i2c_hal_write(uint bus, uint8_t addr, const uint8_t *src, size_t length, bool nostop) {
+    return transfer(bus % SIM_I2C_BUSES, addr, src, NULL, length, nostop);
+}
+
+int i2c_hal_read(uint bus, uint8_t addr, uint8_t *dst, size_t length, bool nostop) {
+    return transfer(bus % SIM_I2C_BUSES, addr, NULL, dst, length, nostop);
+}
+
+// the controller in rp2040.c has clocked the address itself, a part ACKs it or nobody does
+bool sim_i2c_address(uint bus, uint8_t addr, bool is_read, uint64_t start_ns) {
+    bus %= SIM_I2C_BUSES;
+    const SimI2cDevice *device = find_device(bus, addr);
+    int result = I2C_HAL_ERROR;
+    if (device) result = is_read ? device->read(NULL, 0) : device->write(NULL, 0);
+    if (result >= 0) return true;
+    count_nack(bus, start_ns, addr, is_read);
+    stats[bus].bus_time_ns += bits_ns(bus, 1 + 9 + 1);
+    return false;
+}
+
+int sim_i2c_deliver(uint bus, uint64_t start_ns, uint8_t addr, const uint8_t *src, uint8_t *dst, size_t length) {
+    bus %= SIM_I2C_BUSES;
+    const SimI2cDevice *device = find_device(bus, addr);
+    int result = device ? hand_over(bus, start_ns, device, src, dst, length, false) : I2C_HAL_ERROR;
+    if (result < 0) {
+        count_nack(bus, start_ns, addr, !src);
+        stats[bus].bus_time_ns += bits_ns(bus, 1 + 9 + 1);
+        return I2C_HAL_ERROR;
+    }
+    stats[bus].bus_time_ns += bits_ns(bus, 1 + 9 + 9 * length + 1);
+    if (device->stop) device->stop();
+    return result;
+}
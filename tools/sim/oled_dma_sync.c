@@ -0,0 +1,30 @@
+// oled_dma.h for host builds: every write goes straight out through i2c_hal.h,
+// so a frame is on the simulated panel when oled_dma_start_frame() is called.
+#include "oled_dma.h"
+#include "config.h"
+#include "i2c_hal.h"
+#include "sim.h"
+
+static uint32_t aborts = 0;
+
+void oled_dma_init(void) {
+}
+
+void oled_dma_begin_frame(void) {
+}
+
+void oled_dma_add_write(const uint8_t *bytes, size_t length) {
+    if (i2c_hal_write(OLED_I2C_BUS, OLED_ADDR, bytes, length, false) < 0) aborts++;
+}
+
+void oled_dma_start_frame(void) {
+    ssd1306_frame_done();
+}
+
+bool oled_dma_is_busy(void) {
+    return false;
+}
+
+uint32_t oled_dma_abort_count(void) {
+    return aborts;
+}
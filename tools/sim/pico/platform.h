@@ -0,0 +1,10 @@
+//
+// Host stand-in for the Pico SDK header: no flash sections on a PC.
+//
+
+#ifndef PILLDISPENSER_SIM_PICO_PLATFORM_H
+#define PILLDISPENSER_SIM_PICO_PLATFORM_H
+
+#define __in_flash(group)
+
+#endif //PILLDISPENSER_SIM_PICO_PLATFORM_H
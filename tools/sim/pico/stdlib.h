@@ -0,0 +1,20 @@
+//
+// Host stand-in for the Pico SDK header: the time functions are in pico/time.h,
+// stdio is the terminal.
+//
+
+#ifndef PILLDISPENSER_SIM_PICO_STDLIB_H
+#define PILLDISPENSER_SIM_PICO_STDLIB_H
+#include <stdio.h>
+#include "pico/types.h"
+#include "pico/time.h"
+#include "hardware/gpio.h"
+#include "hardware/sync.h"
+#include "sim.h"
+
+static inline void tight_loop_contents(void) { sim_advance_ns(1000); }
+static inline int putchar_raw(int c) { return putchar(c); }
+static inline void stdio_flush(void) { fflush(stdout); }
+static inline int getchar_timeout_us(uint32_t timeout_us) { (void)timeout_us; return -1; } // PICO_ERROR_TIMEOUT
+
+#endif //PILLDISPENSER_SIM_PICO_STDLIB_H
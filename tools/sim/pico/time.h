@@ -0,0 +1,34 @@
+//
+// Host stand-in for the Pico SDK header: time is the simulated clock from sim.h, alarms of the
+// default pool are fired by the timer in rp2040.c as the clock passes them.
+//
+
+#ifndef PILLDISPENSER_SIM_PICO_TIME_H
+#define PILLDISPENSER_SIM_PICO_TIME_H
+#include "pico/types.h"
+#include "sim.h"
+
+#define PICO_TIME_DEFAULT_ALARM_POOL_MAX_TIMERS 16
+
+typedef int32_t alarm_id_t;
+// >0 fires again that many us after it returned, <0 that many us after it was due, 0 not again
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void *user_data);
+
+static inline absolute_time_t get_absolute_time(void) { return sim_time_us(); }
+static inline uint32_t to_ms_since_boot(absolute_time_t t) { return (uint32_t)(t / 1000); }
+static inline absolute_time_t from_us_since_boot(uint64_t us) { return us; }
+static inline bool time_reached(absolute_time_t t) { return sim_time_us() >= t; }
+static inline absolute_time_t make_timeout_time_us(uint64_t us) { return sim_time_us() + us; }
+static inline uint32_t time_us_32(void) { return (uint32_t)sim_time_us(); }
+static inline uint64_t time_us_64(void) { return sim_time_us(); }
+static inline void sleep_us(uint64_t us) { sim_advance_ns(us * 1000); }
+static inline void sleep_ms(uint32_t ms) { sim_advance_ns((uint64_t)ms * 1000000); }
+// no events to wait for on a PC, a us at a time like tight_loop_contents
+static inline bool best_effort_wfe_or_timeout(absolute_time_t t) {
+    if (!time_reached(t)) sim_advance_ns(1000);
+    return time_reached(t);
+}
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data, bool fire_if_past);
+
+#endif //PILLDISPENSER_SIM_PICO_TIME_H
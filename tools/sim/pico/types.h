@@ -0,0 +1,14 @@
+//
+// Host stand-in for the Pico SDK header, enough for the drivers tools/sim builds.
+//
+
+#ifndef PILLDISPENSER_SIM_PICO_TYPES_H
+#define PILLDISPENSER_SIM_PICO_TYPES_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+
+#endif //PILLDISPENSER_SIM_PICO_TYPES_H
@@ -0,0 +1,848 @@
+// RP2040 peripherals for host builds: GPIO pads, the timer's alarm pool, the irq handlers, DMA
+// channels paced by PIO and I2C DREQs, pio0/pio1 and the two I2C controllers. Alarms fire at their
+// time on the simulated clock and the state machines run their programs one instruction per clock
+// divider period of it, so a pin changes at the time the firmware or the program puts it there.
+// The I2C controllers clock their TX FIFO out a byte at a time to the parts of i2c_hal_linux.c.
+// Instructions and commands the firmware does not use stop the process with a message.
+#include <stdio.h>
+#include <stdlib.h>
+#include "pico/time.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/i2c.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "sim.h"
+
+#define PIO_COUNT 2
+#define FIFO_DEPTH 4 // per direction, twice that when joined
+#define DREQ_FORCE 0x3F
+#define DMA_IRQ_HANDLERS 4
+#define I2C_COUNT 2
+#define I2C_FIFO_DEPTH 16
+#define I2C_NO_COMMAND 0xFFFFFFFFu // data_cmd until the firmware writes a command to it
+#define I2C_MAX_TRANSFER 256
+
+typedef struct {
+    bool is_claimed;
+    bool is_enabled;
+    bool is_stalled; // on a blocking pull with the FIFO empty
+    pio_sm_config config;
+    uint pc;
+    uint32_t x;
+    uint32_t y;
+    uint32_t osr;
+    uint osr_shifted; // bits already shifted out of the OSR
+    uint32_t fifo[2 * FIFO_DEPTH];
+    uint fifo_head;
+    uint fifo_level;
+    uint64_t period_ns; // one instruction
+    uint64_t next_ns; // time of the next instruction
+} StateMachine;
+
+typedef struct {
+    uint16_t instructions[PIO_INSTRUCTION_COUNT];
+    uint32_t used_instructions;
+    StateMachine sm[NUM_PIO_STATE_MACHINES];
+    uint32_t out_latch; // one output latch for all state machines of the block
+    uint32_t out_enable;
+} PioBlock;
+
+typedef struct {
+    bool is_claimed;
+    bool is_busy;
+    bool irq0_enabled;
+    bool irq0_raw;
+    dma_channel_config config;
+    const volatile uint8_t *read;
+} DmaChannel;
+
+typedef enum {
+    I2C_IDLE,
+    I2C_ADDRESS, // START and the address byte on the wire until next_ns
+    I2C_BYTE, // a data byte
+    I2C_STOP,
+} I2cPhase;
+
+typedef struct {
+    uint16_t fifo[I2C_FIFO_DEPTH]; // commands, data byte with the CMD and STOP bits
+    uint fifo_head;
+    uint fifo_level;
+    I2cPhase phase;
+    uint64_t next_ns; // end of what is on the wire
+    bool is_waiting; // bus held for the next command, the TX FIFO ran empty without STOP
+    bool is_scl_held;
+    bool is_read;
+    bool is_last; // the byte on the wire has STOP after it
+    bool is_acked; // the transfer reaches the part at its STOP
+    uint8_t addr;
+    uint8_t bytes[I2C_MAX_TRANSFER];
+    size_t length;
+    uint64_t start_ns;
+    bool is_irq_enabled;
+    irq_handler_t handler;
+} I2cController;
+
+typedef struct {
+    alarm_id_t id; // 0: free
+    uint64_t due_ns;
+    alarm_callback_t callback;
+    void *user_data;
+} Alarm;
+
+pio_hw_t sim_pio_hw[PIO_COUNT];
+static PioBlock pios[PIO_COUNT];
+static DmaChannel channels[NUM_DMA_CHANNELS];
+static dma_channel_hw_t channel_hw[NUM_DMA_CHANNELS];
+i2c_hw_t sim_i2c_hw[I2C_COUNT] = { { .data_cmd = I2C_NO_COMMAND }, { .data_cmd = I2C_NO_COMMAND } };
+i2c_inst_t sim_i2c_inst[I2C_COUNT] = { { &sim_i2c_hw[0] }, { &sim_i2c_hw[1] } };
+static I2cController controllers[I2C_COUNT];
+
+static uint8_t gpio_function[NUM_BANK0_GPIOS]; // 0 SIO, 1 pio0, 2 pio1, 3 a peripheral without pads here
+static uint32_t sio_out = 0;
+static uint32_t sio_oe = 0;
+static uint32_t input_levels = 0;
+static uint32_t driven_inputs = 0; // set by a model, a pull-up no longer decides them
+static uint32_t pad_levels = 0; // outputs as the listeners last saw them
+static uint32_t irq_rise = 0;
+static uint32_t irq_fall = 0;
+static gpio_irq_callback_t gpio_callback = NULL;
+static SimGpioListener listeners[SIM_GPIO_LISTENERS];
+static uint listener_count = 0;
+
+static Alarm alarms[PICO_TIME_DEFAULT_ALARM_POOL_MAX_TIMERS];
+static alarm_id_t next_alarm_id = 1;
+
+static irq_handler_t dma_irq0_handlers[DMA_IRQ_HANDLERS];
+static uint dma_irq0_handler_count = 0;
+static bool is_dma_irq0_enabled = false;
+
+static void (*pull_trace)(unsigned pio, unsigned sm, uint32_t word) = NULL;
+static uint64_t instructions_run = 0;
+static bool is_started = false;
+static bool is_running = false;
+
+static void run(uint64_t now_ns);
+
+static void start() {
+    if (is_started) return;
+    is_started = true;
+    sim_on_advance(run);
+}
+
+static void fail(const char *what, uint a, uint b) {
+    fprintf(stderr, "[Sim] %s (%u, %u)\n", what, a, b);
+    exit(1);
+}
+
+// 1. GPIO
+void sim_gpio_listen(SimGpioListener listener) {
+    if (listener_count < SIM_GPIO_LISTENERS) listeners[listener_count++] = listener;
+}
+
+static uint32_t output_levels() {
+    uint32_t levels = 0;
+    for (uint gpio = 0; gpio < NUM_BANK0_GPIOS; gpio++) {
+        if (gpio_function[gpio] == 0) {
+            levels |= sio_out & sio_oe & (1u << gpio);
+            continue;
+        }
+        if (gpio_function[gpio] > PIO_COUNT) continue;
+        const PioBlock *p = &pios[gpio_function[gpio] - 1];
+        if ((p->out_enable & p->out_latch) & (1u << gpio)) levels |= 1u << gpio;
+    }
+    return levels;
+}
+
+// SIO writes reach the listeners when the clock next moves or an alarm is done, so the
+// gpio_put of each coil in one step is one change, as it is on the pins
+static void update_pads() {
+    uint32_t levels = output_levels();
+    uint32_t changed = levels ^ pad_levels;
+    pad_levels = levels;
+    if (!changed) return;
+    for (uint i = 0; i < listener_count; i++) listeners[i](levels, changed);
+}
+
+void gpio_init(uint gpio) {
+    start();
+    uint32_t bit = 1u << (gpio % NUM_BANK0_GPIOS);
+    gpio_function[gpio % NUM_BANK0_GPIOS] = 0;
+    sio_out &= ~bit;
+    sio_oe &= ~bit;
+}
+
+// the I2C pins are not modelled, the bus transfers of i2c.c go straight to the parts
+void gpio_set_function(uint gpio, enum gpio_function fn) {
+    start();
+    uint8_t function = PIO_COUNT + 1;
+    if (fn == GPIO_FUNC_SIO) function = 0;
+    else if (fn == GPIO_FUNC_PIO0) function = 1;
+    else if (fn == GPIO_FUNC_PIO1) function = 2;
+    gpio_function[gpio % NUM_BANK0_GPIOS] = function;
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+    uint32_t bit = 1u << (gpio % NUM_BANK0_GPIOS);
+    sio_oe = out ? sio_oe | bit : sio_oe & ~bit;
+}
+
+void gpio_put(uint gpio, bool value) {
+    uint32_t bit = 1u << (gpio % NUM_BANK0_GPIOS);
+    sio_out = value ? sio_out | bit : sio_out & ~bit;
+}
+
+void gpio_pull_up(uint gpio) {
+    if (!(driven_inputs & (1u << gpio))) input_levels |= 1u << gpio;
+}
+
+// a floating input keeps the level it had
+void gpio_disable_pulls(uint gpio) {
+    (void)gpio;
+}
+
+bool gpio_get(uint gpio) {
+    gpio %= NUM_BANK0_GPIOS;
+    if (gpio_function[gpio] != 0) return (pad_levels >> gpio) & 1u;
+    if (sio_oe & (1u << gpio)) return (sio_out >> gpio) & 1u;
+    return (input_levels >> gpio) & 1u;
+}
+
+void gpio_set_irq_enabled(uint gpio, uint32_t event_mask, bool enabled) {
+    uint32_t bit = 1u << gpio;
+    if (event_mask & GPIO_IRQ_EDGE_RISE) irq_rise = enabled ? irq_rise | bit : irq_rise & ~bit;
+    if (event_mask & GPIO_IRQ_EDGE_FALL) irq_fall = enabled ? irq_fall | bit : irq_fall & ~bit;
+}
+
+void gpio_set_irq_callback(gpio_irq_callback_t callback) {
+    gpio_callback = callback;
+}
+
+void sim_gpio_set_input(unsigned gpio, bool level) {
+    uint32_t bit = 1u << gpio;
+    bool was = (input_levels & bit) != 0;
+    driven_inputs |= bit;
+    input_levels = level ? input_levels | bit : input_levels & ~bit;
+    if (was == level || !gpio_callback) return;
+    uint32_t event = level ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL;
+    if ((level ? irq_rise : irq_fall) & bit) gpio_callback(gpio, event);
+}
+
+// 2. timer
+// fire_if_past makes no difference here, an alarm due now fires when the clock next moves
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data, bool fire_if_past) {
+    (void)fire_if_past;
+    start();
+    for (uint i = 0; i < PICO_TIME_DEFAULT_ALARM_POOL_MAX_TIMERS; i++) {
+        Alarm *a = &alarms[i];
+        if (a->id) continue;
+        *a = (Alarm){ next_alarm_id++, sim_time_ns() + us * 1000, callback, user_data };
+        if (next_alarm_id <= 0) next_alarm_id = 1;
+        return a->id;
+    }
+    return -1; // pool full, as the SDK reports it
+}
+
+static Alarm *next_alarm(uint64_t now_ns) {
+    Alarm *next = NULL;
+    for (uint i = 0; i < PICO_TIME_DEFAULT_ALARM_POOL_MAX_TIMERS; i++) {
+        Alarm *a = &alarms[i];
+        if (!a->id || a->due_ns > now_ns) continue;
+        if (!next || a->due_ns < next->due_ns) next = a;
+    }
+    return next;
+}
+
+static void fire(Alarm *a) {
+    sim_clock_to_ns(a->due_ns);
+    int64_t again_us = a->callback(a->id, a->user_data);
+    if (again_us < 0) a->due_ns += (uint64_t)(-again_us) * 1000;
+    else if (again_us > 0) a->due_ns = sim_time_ns() + (uint64_t)again_us * 1000;
+    else a->id = 0;
+    update_pads();
+}
+
+// 3. IRQ
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_priority) {
+    (void)order_priority;
+    if (num != DMA_IRQ_0 || dma_irq0_handler_count >= DMA_IRQ_HANDLERS) fail("irq not modelled", num, 0);
+    dma_irq0_handlers[dma_irq0_handler_count++] = handler;
+}
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler) {
+    start();
+    if (num != I2C0_IRQ && num != I2C1_IRQ) fail("irq not modelled", num, 0);
+    controllers[num - I2C0_IRQ].handler = handler;
+}
+
+void irq_set_enabled(uint num, bool enabled) {
+    if (num == DMA_IRQ_0) is_dma_irq0_enabled = enabled;
+    if (num == I2C0_IRQ || num == I2C1_IRQ) controllers[num - I2C0_IRQ].is_irq_enabled = enabled;
+}
+
+// 4. PIO
+static PioBlock *block(PIO pio) {
+    return &pios[pio_get_index(pio)];
+}
+
+static uint fifo_capacity(const StateMachine *s) {
+    return s->config.join_tx ? 2 * FIFO_DEPTH : FIFO_DEPTH;
+}
+
+static void push(StateMachine *s, uint32_t word) {
+    s->fifo[(s->fifo_head + s->fifo_level) % (2 * FIFO_DEPTH)] = word;
+    s->fifo_level++;
+    if (s->is_stalled) {
+        // the pull goes through on the next clock of the state machine
+        uint64_t t = sim_time_ns();
+        if (s->next_ns <= t) s->next_ns += ((t - s->next_ns) / s->period_ns + 1) * s->period_ns;
+        s->is_stalled = false;
+    }
+}
+
+static uint32_t pop(StateMachine *s) {
+    uint32_t word = s->fifo[s->fifo_head];
+    s->fifo_head = (s->fifo_head + 1) % (2 * FIFO_DEPTH);
+    s->fifo_level--;
+    return word;
+}
+
+// out pins and mov pins write the whole OUT_COUNT window, bits past the data are 0
+static void write_pins(PioBlock *p, const StateMachine *s, uint32_t data, uint bits) {
+    for (uint i = 0; i < s->config.out_count; i++) {
+        uint32_t pin = 1u << ((s->config.out_base + i) % 32);
+        bool level = i < bits && ((data >> i) & 1u);
+        p->out_latch = level ? p->out_latch | pin : p->out_latch & ~pin;
+    }
+    update_pads();
+}
+
+static uint32_t shift_out(StateMachine *s, uint bits) {
+    uint32_t mask = bits >= 32 ? 0xFFFFFFFFu : (1u << bits) - 1;
+    uint32_t data;
+    if (s->config.out_shift_right) {
+        data = s->osr & mask;
+        s->osr = bits >= 32 ? 0 : s->osr >> bits;
+    } else {
+        data = bits >= 32 ? s->osr : s->osr >> (32 - bits);
+        s->osr = bits >= 32 ? 0 : s->osr << bits;
+    }
+    s->osr_shifted = s->osr_shifted + bits > 32 ? 32 : s->osr_shifted + bits;
+    return data;
+}
+
+static uint32_t mov_source(const StateMachine *s, uint src, uint pio, uint sm) {
+    switch (src) {
+        case pio_x: return s->x;
+        case pio_y: return s->y;
+        case pio_null: return 0;
+        case pio_osr: return s->osr;
+        default: fail("mov source not modelled", pio, sm);
+    }
+    return 0;
+}
+
+// one instruction, returns whether it moved the pc itself (a jump or a stall).
+// until_ns lets a jmp x-- onto itself run all the loops that fit before it in one go.
+static bool execute(uint index, uint sm, uint16_t instr, uint64_t until_ns) {
+    PioBlock *p = &pios[index];
+    StateMachine *s = &p->sm[sm];
+    uint arg = (instr >> 5) & 7u;
+    switch (instr >> 13) {
+        case 0: { // jmp
+            uint addr = instr & 31u;
+            bool taken;
+            switch (arg) {
+                case 0: taken = true; break;
+                case 1: taken = s->x == 0; break;
+                case 2:
+                    if (addr == s->pc && s->x > 1 && until_ns > s->next_ns) {
+                        uint64_t loops = (until_ns - s->next_ns) / s->period_ns;
+                        if (loops > s->x - 1) loops = s->x - 1;
+                        s->x -= (uint32_t)loops;
+                        s->next_ns += loops * s->period_ns;
+                        instructions_run += loops;
+                    }
+                    taken = s->x-- != 0;
+                    break;
+                case 3: taken = s->y == 0; break;
+                case 4: taken = s->y-- != 0; break;
+                case 5: taken = s->x != s->y; break;
+                case 7: taken = s->osr_shifted < s->config.pull_threshold; break;
+                default: fail("jmp condition not modelled", index, sm); return false;
+            }
+            if (taken) s->pc = addr;
+            return taken;
+        }
+        case 3: { // out
+            uint bits = instr & 31u ? instr & 31u : 32;
+            uint32_t data = shift_out(s, bits);
+            switch (arg) {
+                case 0: write_pins(p, s, data, bits); break;
+                case 1: s->x = data; break;
+                case 2: s->y = data; break;
+                case 3: break;
+                default: fail("out destination not modelled", index, sm);
+            }
+            return false;
+        }
+        case 4: { // pull, push is not modelled
+            if (!(instr & 0x80u)) fail("push not modelled", index, sm);
+            bool is_blocking = instr & 0x20u;
+            if (s->fifo_level == 0) {
+                if (!is_blocking) {
+                    s->osr = s->x;
+                    s->osr_shifted = 0;
+                    return false;
+                }
+                s->is_stalled = true;
+                return true;
+            }
+            s->osr = pop(s);
+            s->osr_shifted = 0;
+            if (pull_trace) pull_trace(index, sm, s->osr);
+            return false;
+        }
+        case 5: { // mov
+            uint op = (instr >> 3) & 3u;
+            uint32_t data = mov_source(s, instr & 7u, index, sm);
+            if (op == 1) data = ~data;
+            else if (op == 2) {
+                uint32_t reversed = 0;
+                for (int i = 0; i < 32; i++) reversed |= ((data >> i) & 1u) << (31 - i);
+                data = reversed;
+            }
+            switch (arg) {
+                case pio_pins: write_pins(p, s, data, 32); break;
+                case pio_x: s->x = data; break;
+                case pio_y: s->y = data; break;
+                case pio_osr: s->osr = data; s->osr_shifted = 0; break;
+                default: fail("mov destination not modelled", index, sm);
+            }
+            return false;
+        }
+        default:
+            fail("instruction not modelled", index, instr);
+            return false;
+    }
+}
+
+static void step(uint index, uint sm, uint64_t until_ns) {
+    PioBlock *p = &pios[index];
+    StateMachine *s = &p->sm[sm];
+    uint16_t instr = p->instructions[s->pc];
+    uint delay = (instr >> 8) & 31u;
+    sim_clock_to_ns(s->next_ns);
+    instructions_run++;
+    bool is_moved = execute(index, sm, instr, until_ns);
+    if (s->is_stalled) return;
+    if (!is_moved) s->pc = s->pc == s->config.wrap ? s->config.wrap_target : (s->pc + 1) % PIO_INSTRUCTION_COUNT;
+    s->next_ns += (1 + delay) * s->period_ns;
+}
+
+uint pio_add_program(PIO pio, const pio_program_t *program) {
+    start();
+    PioBlock *p = block(pio);
+    uint32_t mask = (1u << program->length) - 1;
+    // like the SDK, the highest offset that is free
+    for (int offset = PIO_INSTRUCTION_COUNT - program->length; offset >= 0; offset--) {
+        if (program->origin >= 0 && offset != program->origin) continue;
+        if (p->used_instructions & (mask << offset)) continue;
+        for (uint i = 0; i < program->length; i++) {
+            uint16_t instr = program->instructions[i];
+            // jump targets are relative to the program
+            if ((instr >> 13) == 0) instr = (uint16_t)(instr + offset);
+            p->instructions[offset + i] = instr;
+        }
+        p->used_instructions |= mask << offset;
+        return (uint)offset;
+    }
+    fail("no room for the program", pio_get_index(pio), program->length);
+    return 0;
+}
+
+int pio_claim_unused_sm(PIO pio, bool required) {
+    PioBlock *p = block(pio);
+    for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+        if (p->sm[sm].is_claimed) continue;
+        p->sm[sm].is_claimed = true;
+        return (int)sm;
+    }
+    if (required) fail("no free state machine", pio_get_index(pio), 0);
+    return -1;
+}
+
+void pio_gpio_init(PIO pio, uint pin) {
+    start();
+    gpio_function[pin % NUM_BANK0_GPIOS] = (uint8_t)(pio_get_index(pio) + 1);
+    update_pads();
+}
+
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config) {
+    StateMachine *s = &block(pio)->sm[sm];
+    s->is_enabled = false;
+    s->is_stalled = false;
+    s->config = *config;
+    s->pc = initial_pc;
+    s->osr = 0;
+    s->osr_shifted = 32;
+    s->fifo_head = 0;
+    s->fifo_level = 0;
+    double div = config->clkdiv_int + config->clkdiv_frac / 256.0;
+    s->period_ns = (uint64_t)(div * 1e9 / clock_get_hz(clk_sys) + 0.5);
+    if (s->period_ns == 0) s->period_ns = 1;
+}
+
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled) {
+    StateMachine *s = &block(pio)->sm[sm];
+    if (enabled && !s->is_enabled) s->next_ns = sim_time_ns();
+    s->is_enabled = enabled;
+}
+
+void pio_sm_set_pins_with_mask(PIO pio, uint sm, uint32_t pin_values, uint32_t pin_mask) {
+    (void)sm;
+    PioBlock *p = block(pio);
+    p->out_latch = (p->out_latch & ~pin_mask) | (pin_values & pin_mask);
+    update_pads();
+}
+
+void pio_sm_set_pindirs_with_mask(PIO pio, uint sm, uint32_t pin_dirs, uint32_t pin_mask) {
+    (void)sm;
+    PioBlock *p = block(pio);
+    p->out_enable = (p->out_enable & ~pin_mask) | (pin_dirs & pin_mask);
+    update_pads();
+}
+
+void pio_sm_put_blocking(PIO pio, uint sm, uint32_t data) {
+    StateMachine *s = &block(pio)->sm[sm];
+    while (s->fifo_level >= fifo_capacity(s)) sim_advance_ns(s->period_ns);
+    push(s, data);
+}
+
+void pio_sm_exec(PIO pio, uint sm, uint instr) {
+    uint index = pio_get_index(pio);
+    StateMachine *s = &pios[index].sm[sm];
+    uint64_t next_ns = s->next_ns;
+    s->next_ns = sim_time_ns();
+    execute(index, sm, (uint16_t)instr, 0);
+    s->next_ns = next_ns;
+}
+
+bool pio_sm_is_tx_fifo_empty(PIO pio, uint sm) {
+    return block(pio)->sm[sm].fifo_level == 0;
+}
+
+uint pio_sm_get_tx_fifo_level(PIO pio, uint sm) {
+    return block(pio)->sm[sm].fifo_level;
+}
+
+uint8_t pio_sm_get_pc(PIO pio, uint sm) {
+    return (uint8_t)block(pio)->sm[sm].pc;
+}
+
+void sim_pio_trace_pulls(void (*trace)(unsigned pio, unsigned sm, uint32_t word)) {
+    pull_trace = trace;
+}
+
+uint64_t sim_pio_get_instructions(void) {
+    return instructions_run;
+}
+
+// 5. DMA
+int dma_claim_unused_channel(bool required) {
+    start();
+    for (uint i = 0; i < NUM_DMA_CHANNELS; i++) {
+        if (channels[i].is_claimed) continue;
+        channels[i].is_claimed = true;
+        return (int)i;
+    }
+    if (required) fail("no free dma channel", 0, 0);
+    return -1;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel) {
+    (void)channel;
+    return (dma_channel_config){ DMA_SIZE_32, true, false, DREQ_FORCE };
+}
+
+static bool i2c_has_room(uint index);
+static void i2c_push(uint index, uint32_t command);
+
+static uint32_t read_word(DmaChannel *c) {
+    uint32_t word;
+    if (c->config.size == DMA_SIZE_8) word = *c->read;
+    else if (c->config.size == DMA_SIZE_16) word = *(const volatile uint16_t *)c->read;
+    else word = *(const volatile uint32_t *)c->read;
+    if (c->config.read_increment) c->read += 1u << c->config.size;
+    return word;
+}
+
+// a channel paced by a PIO or I2C TX FIFO fills it as far as it goes
+static void service_dma() {
+    for (uint i = 0; i < NUM_DMA_CHANNELS; i++) {
+        DmaChannel *c = &channels[i];
+        if (!c->is_busy) continue;
+        uint dreq = c->config.dreq;
+        if (dreq == DREQ_I2C0_TX || dreq == DREQ_I2C0_TX + 2) {
+            uint index = (dreq - DREQ_I2C0_TX) / 2;
+            while (channel_hw[i].transfer_count > 0 && i2c_has_room(index)) {
+                i2c_push(index, read_word(c));
+                channel_hw[i].transfer_count--;
+            }
+        } else {
+            if (dreq >= 2 * 8 || dreq % 8 >= NUM_PIO_STATE_MACHINES || c->config.size != DMA_SIZE_32) {
+                fail("dma pacing not modelled", i, dreq);
+            }
+            StateMachine *s = &pios[dreq / 8].sm[dreq % 8];
+            while (channel_hw[i].transfer_count > 0 && s->fifo_level < fifo_capacity(s)) {
+                push(s, read_word(c));
+                channel_hw[i].transfer_count--;
+            }
+        }
+        if (channel_hw[i].transfer_count == 0) {
+            c->is_busy = false;
+            c->irq0_raw = true;
+        }
+    }
+}
+
+static void start_channel(uint channel, const volatile void *read_addr, uint32_t transfer_count) {
+    DmaChannel *c = &channels[channel];
+    c->read = read_addr;
+    channel_hw[channel].transfer_count = transfer_count;
+    c->is_busy = true;
+    service_dma();
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger) {
+    (void)write_addr; // the DREQ says which FIFO
+    channels[channel].config = *config;
+    channels[channel].read = read_addr;
+    channel_hw[channel].transfer_count = transfer_count;
+    if (trigger) start_channel(channel, read_addr, transfer_count);
+}
+
+void dma_channel_transfer_from_buffer_now(uint channel, const volatile void *read_addr, uint32_t transfer_count) {
+    start_channel(channel, read_addr, transfer_count);
+}
+
+void dma_channel_set_irq0_enabled(uint channel, bool enabled) {
+    channels[channel].irq0_enabled = enabled;
+}
+
+bool dma_channel_get_irq0_status(uint channel) {
+    return channels[channel].irq0_raw && channels[channel].irq0_enabled;
+}
+
+void dma_channel_acknowledge_irq0(uint channel) {
+    channels[channel].irq0_raw = false;
+}
+
+// stops where it is, no irq
+void dma_channel_abort(uint channel) {
+    channels[channel].is_busy = false;
+    channel_hw[channel].transfer_count = 0;
+}
+
+bool dma_channel_is_busy(uint channel) {
+    return channels[channel].is_busy;
+}
+
+dma_channel_hw_t *dma_channel_hw_addr(uint channel) {
+    return &channel_hw[channel];
+}
+
+static void dispatch_dma_irq() {
+    if (!is_dma_irq0_enabled) return;
+    for (int round = 0; round < NUM_DMA_CHANNELS; round++) {
+        bool is_pending = false;
+        for (uint i = 0; i < NUM_DMA_CHANNELS; i++) is_pending |= dma_channel_get_irq0_status(i);
+        if (!is_pending) return;
+        for (uint i = 0; i < dma_irq0_handler_count; i++) dma_irq0_handlers[i]();
+    }
+}
+
+// 6. I2C
+void sim_i2c_hold_scl(unsigned bus, bool is_held) {
+    I2cController *c = &controllers[bus % I2C_COUNT];
+    c->is_scl_held = is_held;
+    if (!is_held && c->next_ns < sim_time_ns()) c->next_ns = sim_time_ns();
+}
+
+static uint64_t i2c_bits_ns(uint index, uint64_t bits) {
+    return bits * 1000000000ull / sim_i2c_get_baudrate(index);
+}
+
+// after a TX_ABRT the FIFO is flushed and takes nothing until the handler cleared it
+static bool is_i2c_flushing(uint index) {
+    return sim_i2c_hw[index].raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS;
+}
+
+static bool i2c_has_room(uint index) {
+    return is_i2c_flushing(index) || controllers[index].fifo_level < I2C_FIFO_DEPTH;
+}
+
+static void i2c_push(uint index, uint32_t command) {
+    I2cController *c = &controllers[index];
+    if (!sim_i2c_hw[index].enable || is_i2c_flushing(index)) return;
+    if (c->fifo_level >= I2C_FIFO_DEPTH) fail("i2c tx fifo overflow", index, 0);
+    c->fifo[(c->fifo_head + c->fifo_level) % I2C_FIFO_DEPTH] = (uint16_t)command;
+    c->fifo_level++;
+}
+
+// the next byte of the transfer, or the bus held until there is one
+static void i2c_next_byte(uint index) {
+    I2cController *c = &controllers[index];
+    if (c->fifo_level == 0) {
+        c->is_waiting = true;
+        return;
+    }
+    uint16_t command = c->fifo[c->fifo_head];
+    c->fifo_head = (c->fifo_head + 1) % I2C_FIFO_DEPTH;
+    c->fifo_level--;
+    if (command & I2C_IC_DATA_CMD_RESTART_BITS) fail("i2c restart not modelled", index, command);
+    if (((command & I2C_IC_DATA_CMD_CMD_BITS) != 0) != c->is_read) fail("i2c direction change not modelled", index, command);
+    if (c->length >= I2C_MAX_TRANSFER) fail("i2c transfer too long", index, (uint)c->length);
+    c->bytes[c->length++] = (uint8_t)command;
+    c->is_last = command & I2C_IC_DATA_CMD_STOP_BITS;
+    c->phase = I2C_BYTE;
+    c->next_ns += i2c_bits_ns(index, 9);
+}
+
+// what was on the wire until next_ns is done
+static void i2c_event(uint index) {
+    I2cController *c = &controllers[index];
+    i2c_hw_t *hw = &sim_i2c_hw[index];
+    sim_clock_to_ns(c->next_ns);
+    switch (c->phase) {
+        case I2C_ADDRESS:
+            if (sim_i2c_address(index, c->addr, c->is_read, c->start_ns)) {
+                i2c_next_byte(index);
+                return;
+            }
+            hw->raw_intr_stat |= I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS;
+            c->is_acked = false;
+            c->fifo_level = 0;
+            c->phase = I2C_STOP;
+            c->next_ns += i2c_bits_ns(index, 1);
+            return;
+        case I2C_BYTE:
+            if (!c->is_last) {
+                i2c_next_byte(index);
+                return;
+            }
+            c->phase = I2C_STOP;
+            c->is_acked = true;
+            c->next_ns += i2c_bits_ns(index, 1);
+            return;
+        case I2C_STOP:
+            // the model parts only NACK their address, the data of an ACKed one goes through
+            if (c->is_acked) {
+                sim_i2c_deliver(index, c->start_ns, c->addr, c->is_read ? NULL : c->bytes,
+                                c->is_read ? c->bytes : NULL, c->length);
+            }
+            hw->raw_intr_stat |= I2C_IC_RAW_INTR_STAT_STOP_DET_BITS;
+            c->phase = I2C_IDLE;
+            return;
+        default:
+            return;
+    }
+}
+
+// takes what the firmware wrote to data_cmd, starts a transfer on an idle bus and wakes a held one.
+// a controller the firmware disabled drops its transfer and FIFO without an interrupt.
+static void service_i2c() {
+    for (uint index = 0; index < I2C_COUNT; index++) {
+        I2cController *c = &controllers[index];
+        i2c_hw_t *hw = &sim_i2c_hw[index];
+        if (hw->data_cmd != I2C_NO_COMMAND) {
+            i2c_push(index, hw->data_cmd);
+            hw->data_cmd = I2C_NO_COMMAND;
+        }
+        if (!hw->enable) {
+            c->phase = I2C_IDLE;
+            c->is_waiting = false;
+            c->fifo_level = 0;
+        }
+        if (c->phase == I2C_IDLE && c->fifo_level > 0) {
+            c->phase = I2C_ADDRESS;
+            c->addr = (uint8_t)hw->tar;
+            c->is_read = c->fifo[c->fifo_head] & I2C_IC_DATA_CMD_CMD_BITS;
+            c->length = 0;
+            c->start_ns = sim_time_ns();
+            c->next_ns = c->start_ns + i2c_bits_ns(index, 1 + 9);
+        } else if (c->is_waiting && c->fifo_level > 0) {
+            c->is_waiting = false;
+            c->next_ns = sim_time_ns();
+            i2c_next_byte(index);
+        }
+        hw->txflr = c->fifo_level;
+    }
+}
+
+static int next_i2c_event(uint64_t now_ns) {
+    int next = -1;
+    for (uint index = 0; index < I2C_COUNT; index++) {
+        const I2cController *c = &controllers[index];
+        if (c->phase == I2C_IDLE || c->is_waiting || c->is_scl_held || c->next_ns > now_ns) continue;
+        if (next >= 0 && controllers[next].next_ns <= c->next_ns) continue;
+        next = (int)index;
+    }
+    return next;
+}
+
+static void dispatch_i2c_irq() {
+    for (uint index = 0; index < I2C_COUNT; index++) {
+        I2cController *c = &controllers[index];
+        i2c_hw_t *hw = &sim_i2c_hw[index];
+        uint32_t pending = hw->raw_intr_stat & hw->intr_mask;
+        if (!pending || !c->is_irq_enabled || !c->handler) continue;
+        c->handler();
+        hw->raw_intr_stat &= ~pending; // its clr_ reads
+        service_dma();
+        service_i2c();
+    }
+}
+
+static void service_and_dispatch() {
+    service_dma();
+    service_i2c();
+    dispatch_dma_irq();
+    dispatch_i2c_irq();
+}
+
+// every alarm, state machine instruction and I2C bus event due by now_ns, oldest first, with DMA,
+// the I2C FIFOs and their irqs after each
+static void run(uint64_t now_ns) {
+    if (is_running) return;
+    is_running = true;
+    update_pads();
+    service_and_dispatch();
+    for (;;) {
+        StateMachine *next = NULL;
+        uint next_index = 0;
+        uint next_sm = 0;
+        for (uint index = 0; index < PIO_COUNT; index++) {
+            for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+                StateMachine *s = &pios[index].sm[sm];
+                if (!s->is_enabled || s->is_stalled || s->next_ns > now_ns) continue;
+                if (next && next->next_ns <= s->next_ns) continue;
+                next = s;
+                next_index = index;
+                next_sm = sm;
+            }
+        }
+        Alarm *alarm = next_alarm(now_ns);
+        int i2c = next_i2c_event(now_ns);
+        if (!next && !alarm && i2c < 0) break;
+        uint64_t pio_ns = next ? next->next_ns : UINT64_MAX;
+        uint64_t i2c_ns = i2c >= 0 ? controllers[i2c].next_ns : UINT64_MAX;
+        if (alarm && alarm->due_ns <= pio_ns && alarm->due_ns <= i2c_ns) fire(alarm);
+        else if (i2c >= 0 && i2c_ns <= pio_ns) i2c_event((uint)i2c);
+        else step(next_index, next_sm, now_ns);
+        service_and_dispatch();
+    }
+    is_running = false;
+}
@@ -0,0 +1,140 @@
+//
+// Host stand-ins for the Pico: a simulated clock, the RP2040 GPIO, timer, DMA and PIO, a stepper
+// turning a pill wheel and simulated I2C parts with the AT24C256 model. Only built on a PC, see
+// tools/motor_sim.c and tools/eeprom_sim.c.
+//
+
+#ifndef PILLDISPENSER_SIM_H
+#define PILLDISPENSER_SIM_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// simulated time since boot, moved on by bus transfers, sleeps and busy loops
+uint64_t sim_time_us(void);
+uint64_t sim_time_ns(void);
+void sim_advance_ns(uint64_t ns);
+
+// run is called with the new time whenever the clock moves on, rp2040.c runs the timer, PIO and DMA from it.
+// it moves the clock to each of its events on the way, so what they call sees their time.
+void sim_on_advance(void (*run)(uint64_t now_ns));
+void sim_clock_to_ns(uint64_t ns);
+
+// the process ends with SIM_POWER_CUT_EXIT once the clock reaches the cut, run it in a fork.
+// cut runs first, the I2C parts keep what they hold at that moment.
+#define SIM_POWER_CUT_EXIT 42
+void sim_power_cut_at_us(uint64_t us);
+void sim_on_power_cut(void (*cut)(void));
+
+// one part on a simulated bus. write and read see the transfer after its address byte,
+// return the byte count or I2C_HAL_ERROR for a NACK; stop runs at the STOP condition,
+// power_cut when the simulated power goes.
+typedef struct {
+    unsigned bus;
+    uint8_t addr;
+    int (*write)(const uint8_t *src, size_t length);
+    int (*read)(uint8_t *dst, size_t length);
+    void (*stop)(void);
+    void (*power_cut)(void);
+} SimI2cDevice;
+
+typedef struct {
+    uint64_t transactions;
+    uint64_t bytes; // on the wire, address bytes included
+    uint64_t nacks;
+    uint64_t bus_time_ns;
+} SimI2cStats;
+
+#define SIM_I2C_BUSES 2
+#define SIM_I2C_DEVICES 4
+
+// bus 0 and 1 of i2c_hal.h in i2c_hal_linux.c
+void sim_i2c_attach(const SimI2cDevice *device);
+const SimI2cStats *sim_i2c_get_stats(unsigned bus);
+void sim_i2c_reset_stats(void);
+// one line per transfer to out from now on: time, bus, direction, address, ACK, the first bytes. NULL stops it.
+void sim_i2c_trace(FILE *out);
+uint32_t sim_i2c_get_baudrate(unsigned bus);
+// the I2C controllers in rp2040.c clock the bytes themselves. a part answers its address when that
+// is on the wire and gets the whole transfer at its STOP. neither moves the clock.
+bool sim_i2c_address(unsigned bus, uint8_t addr, bool is_read, uint64_t start_ns);
+int sim_i2c_deliver(unsigned bus, uint64_t start_ns, uint8_t addr, const uint8_t *src, uint8_t *dst, size_t length);
+
+// RP2040 in rp2040.c: GPIO pads, the timer's alarm pool, shared irqs, DMA, pio0/pio1 running their programs
+// and the I2C controllers.
+// a listener sees the level of every pad after the outputs changed, changed masks those.
+typedef void (*SimGpioListener)(uint32_t levels, uint32_t changed);
+#define SIM_GPIO_LISTENERS 4
+void sim_gpio_listen(SimGpioListener listener);
+void sim_gpio_set_input(unsigned gpio, bool level); // runs the gpio irq callback on an enabled edge
+// every word a state machine pulls from its TX FIFO, NULL stops it
+void sim_pio_trace_pulls(void (*trace)(unsigned pio, unsigned sm, uint32_t word));
+uint64_t sim_pio_get_instructions(void); // executed by all state machines so far
+// a part holding SCL low: the controller of that bus stops where it is until it is let go
+void sim_i2c_hold_scl(unsigned bus, bool is_held);
+
+// 28BYJ-48 behind a ULN2003 turning a wheel with one gap past an opto fork, in stepper_wheel.c.
+// the rotor follows the coil pattern on the motor pins by the nearest way round, a jump of
+// half a phase cycle leaves it where it is. the fork reads 0 inside the gap.
+#define SIM_WHEELS 4
+
+typedef struct {
+    unsigned motor_pins[4]; // IN1-IN4
+    unsigned opto_pin;
+    double half_steps_per_revolution; // of the wheel, the gearbox makes it no whole number
+    double gap_start; // lower end of the gap, half-steps forward of where the rotor starts
+    double gap_width;
+    double edge_jitter; // each edge comes up to this many half-steps early or late
+} SimWheelConfig;
+
+typedef struct {
+    uint64_t half_steps;
+    uint64_t stalls; // patterns the rotor could not follow
+    uint64_t edges;
+} SimWheelStats;
+
+void sim_wheel_attach(unsigned wheel, const SimWheelConfig *config);
+double sim_wheel_position(unsigned wheel); // half-steps turned since attach, forward positive
+double sim_wheel_from_gap_centre(unsigned wheel); // signed half-steps to the nearest gap centre
+const SimWheelStats *sim_wheel_get_stats(unsigned wheel);
+
+// AT24C256: 32 KB in 64 byte pages, the image is a file mapped into memory so it outlives the process
+#define AT24C256_SIZE (32 * 1024)
+#define AT24C256_PAGE_SIZE 64
+#define AT24C256_WRITE_CYCLE_US 5000 // tWR, the datasheet maximum
+
+typedef struct {
+    uint64_t page_writes;
+    uint64_t wrapped_writes; // ran past the page end and wrapped to its start
+    uint64_t busy_nacks; // addressed during the write cycle
+    uint64_t torn_pages; // power cut during the write cycle
+    uint32_t page_wear[AT24C256_SIZE / AT24C256_PAGE_SIZE]; // write cycles of each page
+} At24c256Stats;
+
+extern const SimI2cDevice at24c256_device;
+bool at24c256_open(const char *path); // a new file starts erased, all 0xFF
+void at24c256_erase(void);
+void at24c256_close(void);
+const At24c256Stats *at24c256_get_stats(void);
+
+// SSD1306 on bus 1 address 0x3C: the commands oled.c sends, the three addressing modes and
+// the 128x64 GDDRAM, rendered as the panel shows it
+typedef struct {
+    uint64_t frames;
+    uint64_t commands;
+    uint64_t data_bytes;
+    uint64_t unknown_commands;
+    SimI2cStats last_frame; // bus traffic of the last frame
+} Ssd1306Stats;
+
+extern const SimI2cDevice ssd1306_device;
+bool ssd1306_snapshot(const char *path, int scale); // .png, else .pgm
+uint32_t ssd1306_hash(void);
+// a printf pattern with the frame number, e.g. "frames/%04u.png", NULL for none
+void ssd1306_set_snapshots(const char *pattern);
+// oled_dma_sync.c calls this at the end of every frame
+void ssd1306_frame_done(void);
+const Ssd1306Stats *ssd1306_get_stats(void);
+
+#endif //PILLDISPENSER_SIM_H
@@ -0,0 +1,301 @@
+#include <stdio.h>
+#include <string.h>
+#include "i2c_hal.h"
+#include "sim.h"
+
+#define SSD1306_ADDR 0x3C
+#define SSD1306_WIDTH 128
+#define SSD1306_PAGES 8
+#define SSD1306_HEIGHT (SSD1306_PAGES * 8)
+
+typedef enum {
+    ADDRESSING_HORIZONTAL = 0,
+    ADDRESSING_VERTICAL = 1,
+    ADDRESSING_PAGE = 2, // after reset
+} Addressing;
+
+static uint8_t gddram[SSD1306_PAGES][SSD1306_WIDTH];
+static Addressing addressing = ADDRESSING_PAGE;
+static uint8_t column_start = 0, column_end = SSD1306_WIDTH - 1, column = 0;
+static uint8_t page_start = 0, page_end = SSD1306_PAGES - 1, page = 0;
+static uint8_t start_line = 0;
+static bool is_display_on = false;
+static bool is_inverted = false;
+static bool is_segment_remapped = false; // 0xA1
+static bool is_com_reversed = false; // 0xC8
+
+// a command waiting for its argument bytes
+static uint8_t command = 0;
+static uint8_t arguments[6];
+static uint8_t argument_count = 0;
+static uint8_t arguments_needed = 0;
+
+static Ssd1306Stats stats;
+static const char *snapshot_pattern = NULL;
+static const SimI2cStats *bus_at_frame = NULL;
+static SimI2cStats bus_before_frame;
+
+static uint8_t argument_length(uint8_t cmd) {
+    switch (cmd) {
+        case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3: case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+            return 1;
+        case 0x21: case 0x22: case 0xA3:
+            return 2;
+        case 0x29: case 0x2A:
+            return 5;
+        case 0x26: case 0x27:
+            return 6;
+        default:
+            return 0;
+    }
+}
+
+static void run_command(uint8_t cmd, const uint8_t *args) {
+    stats.commands++;
+    if (cmd <= 0x0F) {
+        column = (column & 0xF0) | cmd; // page addressing only
+    } else if (cmd <= 0x1F) {
+        column = (uint8_t)(((cmd & 0x07) << 4) | (column & 0x0F));
+    } else if (cmd >= 0x40 && cmd <= 0x7F) {
+        start_line = cmd & 0x3F;
+    } else if (cmd >= 0xB0 && cmd <= 0xB7) {
+        page = cmd & 0x07;
+    } else {
+        switch (cmd) {
+            case 0x20: addressing = args[0] & 0x03; break;
+            case 0x21:
+                column_start = args[0] & 0x7F;
+                column_end = args[1] & 0x7F;
+                column = column_start;
+                break;
+            case 0x22:
+                page_start = args[0] & 0x07;
+                page_end = args[1] & 0x07;
+                page = page_start;
+                break;
+            case 0xA0: is_segment_remapped = false; break;
+            case 0xA1: is_segment_remapped = true; break;
+            case 0xA6: is_inverted = false; break;
+            case 0xA7: is_inverted = true; break;
+            case 0xAE: is_display_on = false; break;
+            case 0xAF: is_display_on = true; break;
+            case 0xC0: is_com_reversed = false; break;
+            case 0xC8: is_com_reversed = true; break;
+            case 0x81: case 0x8D: case 0xA4: case 0xA5: case 0xA8: case 0xD3: case 0xD5: case 0xD9: case 0xDA:
+            case 0xDB: case 0xE3: case 0x2E: case 0x2F: case 0x26: case 0x27: case 0x29: case 0x2A: case 0xA3:
+                break; // no effect on the picture the model draws
+            default:
+                stats.unknown_commands++;
+                break;
+        }
+    }
+}
+
+static void command_byte(uint8_t byte) {
+    if (arguments_needed == 0) {
+        command = byte;
+        argument_count = 0;
+        arguments_needed = argument_length(byte);
+        if (arguments_needed == 0) run_command(command, arguments);
+        return;
+    }
+    arguments[argument_count++] = byte;
+    if (argument_count == arguments_needed) {
+        arguments_needed = 0;
+        run_command(command, arguments);
+    }
+}
+
+// the pointers move as the addressing mode says, inside the column and page window
+static void data_byte(uint8_t byte) {
+    stats.data_bytes++;
+    gddram[page][column] = byte;
+    if (addressing == ADDRESSING_PAGE) {
+        column = column == SSD1306_WIDTH - 1 ? column_start : column + 1;
+    } else if (addressing == ADDRESSING_HORIZONTAL) {
+        if (column++ == column_end) {
+            column = column_start;
+            page = page == page_end ? page_start : page + 1;
+        }
+    } else {
+        if (page++ == page_end) {
+            page = page_start;
+            column = column == column_end ? column_start : column + 1;
+        }
+    }
+}
+
+// control byte: Co (0x80) says one byte follows and then another control byte,
+// D/C (0x40) data or commands. without Co the rest of the write is of that kind.
+static int ssd1306_write(const uint8_t *src, size_t length) {
+    size_t i = 0;
+    while (i < length) {
+        uint8_t control = src[i++];
+        bool is_data = control & 0x40;
+        size_t end = (control & 0x80) ? i + 1 : length;
+        if (end > length) end = length;
+        for (; i < end; i++) {
+            if (is_data) data_byte(src[i]);
+            else command_byte(src[i]);
+        }
+    }
+    return (int)length;
+}
+
+static int ssd1306_read(uint8_t *dst, size_t length) {
+    memset(dst, 0, length); // the status byte, never busy
+    return (int)length;
+}
+
+const SimI2cDevice ssd1306_device = {
+        .bus = 1,
+        .addr = SSD1306_ADDR,
+        .write = ssd1306_write,
+        .read = ssd1306_read,
+};
+
+// as seen on the usual 128x64 module, where 0xA1 and 0xC8 give upright text
+static bool pixel(uint8_t x, uint8_t y) {
+    if (!is_display_on) return false;
+    uint8_t ram_column = is_segment_remapped ? x : SSD1306_WIDTH - 1 - x;
+    uint8_t row = is_com_reversed ? y : SSD1306_HEIGHT - 1 - y;
+    row = (row + start_line) % SSD1306_HEIGHT;
+    bool is_lit = gddram[row / 8][ram_column] & (1 << (row % 8));
+    return is_lit != is_inverted;
+}
+
+static uint8_t image[SSD1306_HEIGHT][SSD1306_WIDTH];
+
+static void render() {
+    for (uint8_t y = 0; y < SSD1306_HEIGHT; y++) {
+        for (uint8_t x = 0; x < SSD1306_WIDTH; x++) {
+            image[y][x] = pixel(x, y) ? 0xFF : 0x00;
+        }
+    }
+}
+
+static uint32_t crc32_table[256];
+
+static uint32_t crc32(uint32_t crc, const uint8_t *data, size_t length) {
+    if (!crc32_table[1]) {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            crc32_table[n] = c;
+        }
+    }
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) crc = crc32_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void put_u32_be(uint8_t *out, uint32_t value) {
+    out[0] = (uint8_t)(value >> 24);
+    out[1] = (uint8_t)(value >> 16);
+    out[2] = (uint8_t)(value >> 8);
+    out[3] = (uint8_t)value;
+}
+
+static void png_chunk(FILE *file, const char *type, const uint8_t *data, uint32_t length) {
+    uint8_t header[8];
+    put_u32_be(header, length);
+    memcpy(&header[4], type, 4);
+    fwrite(header, 1, 8, file);
+    fwrite(data, 1, length, file);
+    uint32_t crc = crc32(crc32(0, &header[4], 4), data, length);
+    uint8_t trailer[4];
+    put_u32_be(trailer, crc);
+    fwrite(trailer, 1, 4, file);
+}
+
+// 8 bit grey, the zlib stream in stored blocks so no compressor is needed. a row each.
+static void write_png(FILE *file, int scale) {
+    const uint32_t width = SSD1306_WIDTH * scale;
+    const uint32_t height = SSD1306_HEIGHT * scale;
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    fwrite(signature, 1, 8, file);
+    uint8_t ihdr[13] = { 0 };
+    put_u32_be(&ihdr[0], width);
+    put_u32_be(&ihdr[4], height);
+    ihdr[8] = 8; // bit depth, colour type 0 grey
+    png_chunk(file, "IHDR", ihdr, sizeof(ihdr));
+
+    static uint8_t idat[2 + (SSD1306_HEIGHT * 8) * (5 + 1 + SSD1306_WIDTH * 8) + 4];
+    size_t n = 0;
+    idat[n++] = 0x78;
+    idat[n++] = 0x01;
+    uint32_t a = 1, b = 0; // adler32 of the raw rows
+    for (uint32_t y = 0; y < height; y++) {
+        uint16_t row_length = (uint16_t)(1 + width);
+        idat[n++] = y == height - 1 ? 1 : 0;
+        idat[n++] = (uint8_t)row_length;
+        idat[n++] = (uint8_t)(row_length >> 8);
+        idat[n++] = (uint8_t)~row_length;
+        idat[n++] = (uint8_t)(~row_length >> 8);
+        for (uint32_t x = 0; x < row_length; x++) {
+            uint8_t value = x == 0 ? 0 : image[y / scale][(x - 1) / scale];
+            idat[n++] = value;
+            a = (a + value) % 65521;
+            b = (b + a) % 65521;
+        }
+    }
+    put_u32_be(&idat[n], (b << 16) | a);
+    n += 4;
+    png_chunk(file, "IDAT", idat, (uint32_t)n);
+    png_chunk(file, "IEND", NULL, 0);
+}
+
+static void write_pgm(FILE *file, int scale) {
+    fprintf(file, "P5\n%d %d\n255\n", SSD1306_WIDTH * scale, SSD1306_HEIGHT * scale);
+    for (int y = 0; y < SSD1306_HEIGHT * scale; y++) {
+        for (int x = 0; x < SSD1306_WIDTH * scale; x++) fputc(image[y / scale][x / scale], file);
+    }
+}
+
+// .png or anything else as .pgm, each panel pixel scale x scale image pixels
+bool ssd1306_snapshot(const char *path, int scale) {
+    if (scale < 1 || scale > 8) scale = 1;
+    FILE *file = fopen(path, "wb");
+    if (!file) return false;
+    render();
+    size_t length = strlen(path);
+    if (length > 4 && strcmp(&path[length - 4], ".png") == 0) write_png(file, scale);
+    else write_pgm(file, scale);
+    return fclose(file) == 0;
+}
+
+// FNV-1a of the visible picture, equal screens give equal hashes
+uint32_t ssd1306_hash(void) {
+    render();
+    uint32_t hash = 2166136261u;
+    for (int y = 0; y < SSD1306_HEIGHT; y++) {
+        for (int x = 0; x < SSD1306_WIDTH; x++) {
+            hash = (hash ^ image[y][x]) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+void ssd1306_set_snapshots(const char *pattern) {
+    snapshot_pattern = pattern;
+}
+
+// the bus traffic since the last frame belongs to this one
+void ssd1306_frame_done(void) {
+    if (!bus_at_frame) bus_at_frame = sim_i2c_get_stats(ssd1306_device.bus);
+    stats.frames++;
+    stats.last_frame.transactions = bus_at_frame->transactions - bus_before_frame.transactions;
+    stats.last_frame.bytes = bus_at_frame->bytes - bus_before_frame.bytes;
+    stats.last_frame.nacks = bus_at_frame->nacks - bus_before_frame.nacks;
+    stats.last_frame.bus_time_ns = bus_at_frame->bus_time_ns - bus_before_frame.bus_time_ns;
+    bus_before_frame = *bus_at_frame;
+    if (snapshot_pattern) {
+        char path[256];
+        snprintf(path, sizeof(path), snapshot_pattern, (unsigned)stats.frames);
+        ssd1306_snapshot(path, 4);
+    }
+}
+
+const Ssd1306Stats *ssd1306_get_stats(void) {
+    return &stats;
+}
@@ -0,0 +1,42 @@
+//
+// Host copy of what pioasm generates from src/drivers/stepper.pio, the firmware build makes its
+// own. Keep the two in step when the program changes.
+//
+
+#pragma once
+
+#if !PICO_NO_HARDWARE
+#include "hardware/pio.h"
+#endif
+
+// ------- //
+// stepper //
+// ------- //
+
+#define stepper_wrap_target 0
+#define stepper_wrap 3
+
+#define stepper_WORD_OVERHEAD 4
+
+static const uint16_t stepper_program_instructions[] = {
+            //     .wrap_target
+    0x80a0, //  0: pull   block
+    0x600c, //  1: out    pins, 12
+    0x6034, //  2: out    x, 20
+    0x0043, //  3: jmp    x--, 3
+            //     .wrap
+};
+
+#if !PICO_NO_HARDWARE
+static const struct pio_program stepper_program = {
+    .instructions = stepper_program_instructions,
+    .length = 4,
+    .origin = -1,
+};
+
+static inline pio_sm_config stepper_program_get_default_config(uint offset) {
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_wrap(&c, offset + stepper_wrap_target, offset + stepper_wrap);
+    return c;
+}
+#endif
@@ -0,0 +1,108 @@
+// 28BYJ-48 and ULN2003 turning a pill wheel past its opto fork, for host builds with rp2040.c.
+// The rotor takes the coil pattern on the four motor pins by the nearest way round, in the
+// phase order motor.c drives. The fork pin is set from the wheel angle, 0 inside the gap.
+#include <stdlib.h>
+#include "sim.h"
+
+typedef struct {
+    bool is_attached;
+    SimWheelConfig config;
+    int64_t position; // half-steps
+    int rotor_phase; // 0-7, the coil phase the rotor sits in
+    bool level;
+    double enter_jitter; // where the next edge comes, against the gap ends
+    double leave_jitter;
+    SimWheelStats stats;
+} Wheel;
+
+static Wheel wheels[SIM_WHEELS];
+static bool is_listening = false;
+
+// coil bits IN1-IN4 to the half-step phase, -1 for none of them
+static int pattern_phase(unsigned pattern) {
+    static const signed char phases[16] = {
+        -1, 0, 2, 1, 4, -1, 3, -1, 6, 7, -1, -1, 5, -1, -1, -1
+    };
+    return phases[pattern & 15u];
+}
+
+static double jitter(const Wheel *w) {
+    return w->config.edge_jitter * (2.0 * rand() / RAND_MAX - 1.0);
+}
+
+// half-steps from the lower end of the nearest copy of the gap
+static double from_gap_start(const Wheel *w) {
+    double spr = w->config.half_steps_per_revolution;
+    double d = (double)w->position - w->config.gap_start;
+    d -= spr * (double)(int64_t)(d / spr);
+    if (d < -spr / 2) d += spr;
+    else if (d >= spr / 2) d -= spr;
+    return d;
+}
+
+static void update_fork(Wheel *w) {
+    double d = from_gap_start(w);
+    bool level = !(d >= w->enter_jitter && d < w->config.gap_width + w->leave_jitter);
+    if (level == w->level) return;
+    w->level = level;
+    w->stats.edges++;
+    w->enter_jitter = jitter(w);
+    w->leave_jitter = jitter(w);
+    sim_gpio_set_input(w->config.opto_pin, level);
+}
+
+static void on_outputs(uint32_t levels, uint32_t changed) {
+    for (unsigned i = 0; i < SIM_WHEELS; i++) {
+        Wheel *w = &wheels[i];
+        if (!w->is_attached) continue;
+        unsigned pattern = 0;
+        uint32_t pins = 0;
+        for (int coil = 0; coil < 4; coil++) {
+            pins |= 1u << w->config.motor_pins[coil];
+            if (levels & (1u << w->config.motor_pins[coil])) pattern |= 1u << coil;
+        }
+        if (!(changed & pins)) continue;
+        int phase = pattern_phase(pattern);
+        if (phase < 0) continue; // coils off, the detent holds the rotor
+        int delta = (phase - w->rotor_phase + 8) % 8;
+        if (delta > 4) delta -= 8;
+        if (delta == 4) {
+            w->stats.stalls++;
+            continue;
+        }
+        w->rotor_phase = phase;
+        w->position += delta;
+        w->stats.half_steps += (uint64_t)abs(delta);
+        update_fork(w);
+    }
+}
+
+void sim_wheel_attach(unsigned wheel, const SimWheelConfig *config) {
+    Wheel *w = &wheels[wheel % SIM_WHEELS];
+    if (!is_listening) {
+        is_listening = true;
+        sim_gpio_listen(on_outputs);
+    }
+    *w = (Wheel){ .is_attached = true, .config = *config, .level = true };
+    w->enter_jitter = jitter(w);
+    w->leave_jitter = jitter(w);
+    double d = from_gap_start(w);
+    w->level = !(d >= 0 && d < config->gap_width);
+    sim_gpio_set_input(config->opto_pin, w->level);
+}
+
+double sim_wheel_position(unsigned wheel) {
+    return (double)wheels[wheel % SIM_WHEELS].position;
+}
+
+double sim_wheel_from_gap_centre(unsigned wheel) {
+    const Wheel *w = &wheels[wheel % SIM_WHEELS];
+    double spr = w->config.half_steps_per_revolution;
+    double d = from_gap_start(w) - w->config.gap_width / 2;
+    if (d < -spr / 2) d += spr;
+    return d;
+}
+
+const SimWheelStats *sim_wheel_get_stats(unsigned wheel) {
+    return &wheels[wheel % SIM_WHEELS].stats;
+}